@@ -0,0 +1,607 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Diagnostics.h"
+#include "Generators.h"
+#include "Gravity.h"
+#include "GravityKernels.h"
+#include "Integrators.h"
+#include "Simulation.h"
+
+// Times updateParticles on generated scenes across particle counts and modes.
+//
+//   Benchmark [options]
+//     --counts A,B,...   particle counts (default 100,1000,10000,100000,1000000)
+//     --sources K        gravity sources, 1-4, one of each type (default 2)
+//     --max-direct N     largest count run with direct-sum mutual gravity (default 20000)
+//     --min-time S       seconds to time each case for (default 0.5)
+//     --threads N        force-pass threads, 0 = all (default 0)
+//     --seed N           scene generator seed (default 42)
+//     --json FILE        also write results as JSON
+//     --energy           instead: energy drift against wall time for each integrator
+//                        and step size, on eccentric orbits around one source
+//     --orbit-time T     simulated time per energy run (default 20000)
+//     --generate         instead: time the bulk scene generators against
+//                        adding the same count one particle at a time
+//     --check-kernels    instead: compare each vector force kernel this CPU
+//                        supports with the scalar one, pair by pair; exits
+//                        non-zero past KERNEL_TOLERANCE
+//     --check-tree       instead: compare Barnes-Hut with direct sum on mixed
+//                        bodies; exits non-zero past TREE_TOLERANCE at the
+//                        default theta
+
+// Steps per time-warp jump in the sources-kepler case; single steps never
+// use the closed form
+constexpr int KEPLER_JUMP = 64;
+
+struct BenchCase {
+    const char* mode;
+    bool mutualGravity;
+    GravitySolver solver;
+    bool sourceField;
+    float passiveMass;  // 0.1: planetoids and satellites are passive, two thirds of the scene
+    bool keplerOrbits;  // timed as time-warp jumps of KEPLER_JUMP steps
+};
+
+struct BenchResult {
+    std::string mode;
+    size_t particles;
+    long steps;
+    double seconds;
+    double nsPerParticleStep;
+    double stepsPerSecond;
+    size_t memoryBytes;
+};
+
+// N particles on near-circular orbits, split evenly between the sources.
+// The same seed always gives the same scene.
+static void buildScene(size_t count, int sourceCount, unsigned seed,
+    std::vector<GravitySource>& sources, ParticleSystem& particles) {
+    sources.clear();
+
+    // Sources far enough apart that each one's disk stays mostly its own
+    for (int s = 0; s < sourceCount; ++s) {
+        sources.emplace_back(s * 60000.0f, 0.0f, static_cast<GravitySourceType>(s % 4));
+    }
+
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    particles.reserve(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        const GravitySource& source = sources[i % sources.size()];
+        float innerRadius = source.get_radius() + 200.0f;
+        float r = innerRadius + unit(rng) * 8000.0f;
+        float angle = unit(rng) * 6.2831853f;
+        float v = std::sqrt(G * source.get_strength() / r);
+
+        Scalar x = source.get_pos().x + r * std::cos(angle);
+        Scalar y = source.get_pos().y + r * std::sin(angle);
+        ParticleType type = static_cast<ParticleType>(rng() % 3);
+        particles.add(x, y, -v * std::sin(angle), v * std::cos(angle), type);
+    }
+}
+
+struct EnergyResult {
+    std::string integrator;
+    float dt;
+    long steps;
+    double seconds;
+    double maxDrift;    // largest |E - E0| / |E0| seen
+    double finalDrift;  // signed, at the end of the run
+};
+
+// Small bodies on eccentric orbits around a white dwarf. Both radii are
+// subtracted from the distance, so large bodies around a large source
+// follow non-Keplerian orbits that can plunge into it.
+static void buildOrbitScene(size_t count, unsigned seed, std::vector<GravitySource>& sources, ParticleSystem& particles) {
+    sources.clear();
+    sources.emplace_back(0.0f, 0.0f, GravitySourceType::WhiteDwarf);
+    const GravitySource& source = sources[0];
+
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    for (size_t i = 0; i < count; ++i) {
+        ParticleType type = static_cast<ParticleType>(rng() % 3);
+        double r = 300.0 + unit(rng) * 900.0;
+        double angle = unit(rng) * 6.283185307179586;
+        double effectiveDist = r - source.get_radius() - getParticleTypeInfo(type).radius;
+        double circular = std::sqrt(G * source.get_strength() * r) / effectiveDist;
+        double v = circular * (0.7 + 0.4 * unit(rng));
+        particles.add(static_cast<Scalar>(r * std::cos(angle)), static_cast<Scalar>(r * std::sin(angle)),
+            static_cast<Scalar>(-v * std::sin(angle)), static_cast<Scalar>(v * std::cos(angle)), type);
+    }
+}
+
+static void runEnergyBenchmark(double orbitTime, unsigned seed, PhysicsSettings physics, const std::string& jsonPath) {
+    struct EnergyCase { Integrator integrator; bool blockTimesteps; const char* name; };
+    const EnergyCase cases[] = {
+        { Integrator::Leapfrog, false, "leapfrog" },
+        { Integrator::Leapfrog, true, "leapfrog-block" },
+        { Integrator::Yoshida4, false, "yoshida4" },
+        { Integrator::RK45, false, "rk45" }
+    };
+    const float steps[] = { 0.5f, 1.0f, 2.0f, 4.0f, 8.0f };
+    const size_t particleCount = 1000;
+    const int samples = 200;  // energy checks per run, outside the timed region
+
+    std::vector<EnergyResult> results;
+    std::cout << "integrator        dt      steps    wall (ms)    max |dE/E|      final dE/E\n";
+
+    for (const EnergyCase& c : cases) {
+        for (float dt : steps) {
+            std::vector<GravitySource> sources;
+            ParticleSystem particles;
+            buildOrbitScene(particleCount, seed, sources, particles);
+            physics.integrator = c.integrator;
+            physics.blockTimesteps = c.blockTimesteps;
+            physics.dt = dt;
+
+            double initial = measureDiagnostics(particles, sources, false, physics).total;
+            long total = std::max(1L, static_cast<long>(orbitTime / dt));
+            long sampleEvery = std::max(1L, total / samples);
+
+            EnergyResult r = { c.name, dt, total, 0.0, 0.0, 0.0 };
+            for (long step = 1; step <= total; ++step) {
+                auto start = std::chrono::steady_clock::now();
+                updateParticles(particles, sources, false, physics);
+                r.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                if (step % sampleEvery == 0 || step == total) {
+                    double drift = (measureDiagnostics(particles, sources, false, physics).total - initial) / std::abs(initial);
+                    r.maxDrift = std::max(r.maxDrift, std::abs(drift));
+                    r.finalDrift = drift;
+                }
+            }
+            results.push_back(r);
+
+            std::printf("%-15s %5.2f %10ld %12.1f %13.3e %15.3e\n", r.integrator.c_str(), r.dt, r.steps,
+                r.seconds * 1e3, r.maxDrift, r.finalDrift);
+        }
+    }
+
+    if (jsonPath.empty()) return;
+    std::ofstream out(jsonPath);
+    if (!out) {
+        std::cerr << "Failed to open " << jsonPath << "\n";
+        return;
+    }
+    out << "{\n";
+    out << "  \"particles\": " << particleCount << ",\n";
+    out << "  \"orbit_time\": " << orbitTime << ",\n";
+    out << "  \"seed\": " << seed << ",\n";
+    out << "  \"precision\": \"" << (sizeof(Scalar) == sizeof(double) ? "double" : "float") << "\",\n";
+    out << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const EnergyResult& r = results[i];
+        out << "    { \"integrator\": \"" << r.integrator << "\", \"dt\": " << r.dt
+            << ", \"steps\": " << r.steps << ", \"seconds\": " << r.seconds
+            << ", \"max_energy_drift\": " << r.maxDrift << ", \"final_energy_drift\": " << r.finalDrift << " }"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+struct GenerateResult {
+    std::string generator;
+    size_t particles;
+    double seconds;  // best of the repeats
+};
+
+static void runGenerateBenchmark(const std::vector<size_t>& counts, unsigned seed, unsigned threads, const std::string& jsonPath) {
+    const char* names[] = { "add-loop", "disk", "belt", "cluster", "binaries" };
+    const int repeats = 3;
+    GravitySource source(0.0f, 0.0f, GravitySourceType::YellowDwarf);
+
+    std::vector<GenerateResult> results;
+    std::cout << "generator      particles     best (ms)    Mparticles/s\n";
+
+    for (const char* name : names) {
+        for (size_t count : counts) {
+            GenerateResult r = { name, count, 0.0 };
+            for (int repeat = 0; repeat < repeats; ++repeat) {
+                ParticleSystem particles;
+                std::vector<GravitySource> sources;
+                auto start = std::chrono::steady_clock::now();
+
+                if (r.generator == "add-loop") {
+                    buildScene(count, 1, seed, sources, particles);
+                }
+                else if (r.generator == "disk") {
+                    DiskSpec spec;
+                    spec.count = count;
+                    generateDisk(particles, source, spec, seed, threads);
+                }
+                else if (r.generator == "belt") {
+                    BeltSpec spec;
+                    spec.count = count;
+                    generateBelt(particles, source, spec, seed, threads);
+                }
+                else if (r.generator == "cluster") {
+                    ClusterSpec spec;
+                    spec.count = count;
+                    generateCluster(particles, spec, seed, threads);
+                }
+                else {
+                    BinarySpec spec;
+                    spec.pairs = count / 2;
+                    generateBinaries(particles, source, spec, seed, threads);
+                }
+
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                if (repeat == 0 || seconds < r.seconds) r.seconds = seconds;
+            }
+            results.push_back(r);
+            std::printf("%-12s %11zu %13.2f %15.1f\n", name, count, r.seconds * 1e3, count / r.seconds * 1e-6);
+        }
+    }
+
+    if (jsonPath.empty()) return;
+    std::ofstream out(jsonPath);
+    if (!out) {
+        std::cerr << "Failed to open " << jsonPath << "\n";
+        return;
+    }
+    out << "{\n";
+    out << "  \"threads\": " << threads << ",\n";
+    out << "  \"seed\": " << seed << ",\n";
+    out << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const GenerateResult& r = results[i];
+        out << "    { \"generator\": \"" << r.generator << "\", \"particles\": " << r.particles
+            << ", \"seconds\": " << r.seconds << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+// Relative error in a single pair's pull the vector kernels may show against
+// the scalar path, from the rsqrt/rcp estimates. Near a body's surface the
+// radii cancel most of the distance and the rounding of the distance grows
+// by dist / effectiveDist, so the check allows that factor on top; measured
+// up to about 8.6e-7 after it, and 3e-4 raw just outside a large source.
+// The potential the kernels can gather alongside is held to the same bound.
+constexpr double KERNEL_TOLERANCE = 2.0e-6;
+
+// Every pair of random targets and attractors of every particle and source
+// type, from overlapping to far apart, one attractor at a time so no sum
+// hides a pair's error. Returns false if a kernel is past the tolerance.
+static bool runKernelCheck(unsigned seed) {
+    const size_t targetCount = 4096;
+    const size_t attractorCount = 256;
+
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::vector<Scalar> tx(targetCount), ty(targetCount);
+    std::vector<float> tr(targetCount);
+    for (size_t i = 0; i < targetCount; ++i) {
+        // Log-uniform offsets from the origin, with a far-off origin for
+        // some so the double path's separations are exercised
+        double dist = std::pow(10.0, unit(rng) * 5.0 - 1.0);
+        double angle = unit(rng) * 6.283185307179586;
+        double origin = i % 4 == 0 ? 1.0e5 : 0.0;
+        tx[i] = static_cast<Scalar>(origin + dist * std::cos(angle));
+        ty[i] = static_cast<Scalar>(dist * std::sin(angle));
+        tr[i] = getParticleTypeInfo(static_cast<ParticleType>(rng() % 3)).radius;
+    }
+
+    std::vector<Scalar> axScalar(targetCount), ayScalar(targetCount), ax(targetCount), ay(targetCount);
+    std::vector<double> phiScalar(targetCount), phi(targetCount);
+    const SimdLevel levels[] = { SimdLevel::SSE, SimdLevel::AVX2 };
+    SimdLevel cpu = detectSimdLevel();
+    bool passed = true;
+
+    std::cout << "kernel      pairs   max rel. error   max scaled error   mean rel. error   max potential error\n";
+    for (SimdLevel level : levels) {
+        if (level > cpu) continue;
+        std::mt19937 attractorRng(seed);
+        double worst = 0.0;
+        double worstScaled = 0.0;
+        double worstPotential = 0.0;
+        double sum = 0.0;
+        size_t pairs = 0;
+
+        for (size_t k = 0; k < attractorCount; ++k) {
+            Scalar x = static_cast<Scalar>((k % 4 == 0 ? 1.0e5 : 0.0) + unit(attractorRng) * 10.0 - 5.0);
+            Scalar y = static_cast<Scalar>(unit(attractorRng) * 10.0 - 5.0);
+            float strength;
+            float radius;
+            if (k % 2 == 0) {
+                GravitySource source(0.0f, 0.0f, static_cast<GravitySourceType>(attractorRng() % 4));
+                strength = source.get_strength();
+                radius = source.get_radius();
+            }
+            else {
+                const ParticleTypeInfo& info = getParticleTypeInfo(static_cast<ParticleType>(attractorRng() % 3));
+                strength = info.mass;
+                radius = info.radius;
+            }
+
+            std::fill(axScalar.begin(), axScalar.end(), Scalar(0));
+            std::fill(ayScalar.begin(), ayScalar.end(), Scalar(0));
+            std::fill(ax.begin(), ax.end(), Scalar(0));
+            std::fill(ay.begin(), ay.end(), Scalar(0));
+            std::fill(phiScalar.begin(), phiScalar.end(), 0.0);
+            std::fill(phi.begin(), phi.end(), 0.0);
+            accumulateAttraction(SimdLevel::Scalar, tx.data(), ty.data(), tr.data(), 0, targetCount,
+                &x, &y, &strength, &radius, 1, axScalar.data(), ayScalar.data(), phiScalar.data());
+            accumulateAttraction(level, tx.data(), ty.data(), tr.data(), 0, targetCount,
+                &x, &y, &strength, &radius, 1, ax.data(), ay.data(), phi.data());
+
+            for (size_t i = 0; i < targetCount; ++i) {
+                double exact = std::hypot(double(axScalar[i]), double(ayScalar[i]));
+                if (exact == 0.0) continue;
+                double error = std::hypot(double(ax[i]) - axScalar[i], double(ay[i]) - ayScalar[i]) / exact;
+
+                double dx = double(x) - tx[i];
+                double dy = double(y) - ty[i];
+                double dist = std::sqrt(dx * dx + dy * dy + double(SOFTENING) * SOFTENING);
+                double effectiveDist = std::max(dist - radius - tr[i], double(SOFTENING));
+                double scaled = error / std::max(1.0, dist / effectiveDist);
+                double potentialError = std::abs(phi[i] - phiScalar[i]) / std::abs(phiScalar[i])
+                    / std::max(1.0, dist / effectiveDist);
+
+                worst = std::max(worst, error);
+                worstScaled = std::max(worstScaled, scaled);
+                worstPotential = std::max(worstPotential, potentialError);
+                sum += error;
+                ++pairs;
+            }
+        }
+
+        std::printf("%-8s %8zu %16.3e %18.3e %17.3e %21.3e\n", level == SimdLevel::SSE ? "sse" : "avx2", pairs,
+            worst, worstScaled, sum / pairs, worstPotential);
+        if (worstScaled > KERNEL_TOLERANCE || worstPotential > KERNEL_TOLERANCE) {
+            std::cerr << "Vector kernel past the tolerance of " << KERNEL_TOLERANCE << "\n";
+            passed = false;
+        }
+    }
+    return passed;
+}
+
+// Barnes-Hut error allowed against direct sum at the default theta, per
+// particle, as a fraction of the sum of the magnitudes of its pairwise
+// pulls: the scale the opening angle bounds. The net pull can cancel to
+// almost nothing, so it is no yardstick on its own. Measured up to about
+// 9e-3 across seeds, with a mean of 3e-4.
+constexpr double TREE_TOLERANCE = 2.0e-2;
+
+// Random bodies of every particle type, sparse and clumped, with mutual
+// gravity through the tree and through direct sum. Returns false if any
+// particle is past the tolerance.
+static bool runTreeCheck(unsigned seed) {
+    const size_t count = 3000;
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+    ParticleSystem particles;
+    particles.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        // A third packed into a clump, where surfaces nearly touch
+        double extent = i % 3 == 0 ? 400.0 : 8000.0;
+        particles.add(static_cast<Scalar>((unit(rng) - 0.5) * extent), static_cast<Scalar>((unit(rng) - 0.5) * extent),
+            0, 0, static_cast<ParticleType>(rng() % 5));
+    }
+    size_t n = particles.size();
+    const Scalar* px = particles.pos_x();
+    const Scalar* py = particles.pos_y();
+    const float* mass = particles.masses();
+    const float* radius = particles.radii();
+
+    std::vector<double> scale(n, 0.0);
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            if (j == i) continue;
+            Vector2s pull(0, 0);
+            accumulatePull(pull, px[j] - px[i], py[j] - py[i], mass[j], radius[j] + radius[i]);
+            scale[i] += std::hypot(double(pull.x), double(pull.y));
+        }
+    }
+
+    std::vector<GravitySource> sources;
+    PhysicsSettings physics;
+    physics.solver = GravitySolver::DirectSum;
+    computeAccelerations(particles, sources, true, physics);
+    std::vector<Scalar> exactX(particles.acc_x(), particles.acc_x() + n);
+    std::vector<Scalar> exactY(particles.acc_y(), particles.acc_y() + n);
+
+    bool passed = true;
+    std::cout << "theta   max error   mean error   max rel. to net pull\n";
+    const float thetas[] = { 0.3f, 0.5f, 0.7f };
+    for (float theta : thetas) {
+        physics.solver = GravitySolver::BarnesHut;
+        physics.theta = theta;
+        computeAccelerations(particles, sources, true, physics);
+        double worst = 0.0;
+        double sum = 0.0;
+        double worstNet = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            double error = std::hypot(double(particles.acc_x()[i]) - exactX[i], double(particles.acc_y()[i]) - exactY[i]);
+            worst = std::max(worst, error / scale[i]);
+            sum += error / scale[i];
+            worstNet = std::max(worstNet, error / std::hypot(double(exactX[i]), double(exactY[i])));
+        }
+        std::printf("%5.2f %11.3e %12.3e %22.3e\n", theta, worst, sum / n, worstNet);
+        if (theta == PhysicsSettings().theta && worst > TREE_TOLERANCE) {
+            std::cerr << "Barnes-Hut past the tolerance of " << TREE_TOLERANCE << " at theta " << theta << "\n";
+            passed = false;
+        }
+    }
+    return passed;
+}
+
+static std::vector<size_t> parseCounts(const std::string& list) {
+    std::vector<size_t> counts;
+    std::stringstream in(list);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        if (!item.empty()) counts.push_back(static_cast<size_t>(std::atoll(item.c_str())));
+    }
+    return counts;
+}
+
+static void writeJson(const std::string& path, const std::vector<BenchResult>& results,
+    int sourceCount, unsigned threads, unsigned seed) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Failed to open " << path << "\n";
+        return;
+    }
+
+    out << "{\n";
+    out << "  \"sources\": " << sourceCount << ",\n";
+    out << "  \"threads\": " << threads << ",\n";
+    out << "  \"seed\": " << seed << ",\n";
+    out << "  \"precision\": \"" << (sizeof(Scalar) == sizeof(double) ? "double" : "float") << "\",\n";
+    out << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        out << "    { \"mode\": \"" << r.mode << "\", \"particles\": " << r.particles
+            << ", \"steps\": " << r.steps << ", \"seconds\": " << r.seconds
+            << ", \"ns_per_particle_step\": " << r.nsPerParticleStep
+            << ", \"steps_per_second\": " << r.stepsPerSecond
+            << ", \"memory_bytes\": " << r.memoryBytes << " }"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+int main(int argc, char** argv) {
+    std::vector<size_t> counts = { 100, 1000, 10000, 100000, 1000000 };
+    int sourceCount = 2;
+    size_t maxDirect = 20000;
+    double minTime = 0.5;
+    unsigned seed = 42;
+    std::string jsonPath;
+    bool energy = false;
+    bool generate = false;
+    bool checkKernels = false;
+    bool checkTree = false;
+    double orbitTime = 20000.0;
+    PhysicsSettings physics;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--counts" && hasValue) counts = parseCounts(argv[++i]);
+        else if (arg == "--sources" && hasValue) sourceCount = std::atoi(argv[++i]);
+        else if (arg == "--max-direct" && hasValue) maxDirect = static_cast<size_t>(std::atoll(argv[++i]));
+        else if (arg == "--min-time" && hasValue) minTime = std::atof(argv[++i]);
+        else if (arg == "--threads" && hasValue) physics.threadCount = static_cast<unsigned>(std::atoi(argv[++i]));
+        else if (arg == "--seed" && hasValue) seed = static_cast<unsigned>(std::atoi(argv[++i]));
+        else if (arg == "--json" && hasValue) jsonPath = argv[++i];
+        else if (arg == "--energy") energy = true;
+        else if (arg == "--orbit-time" && hasValue) orbitTime = std::atof(argv[++i]);
+        else if (arg == "--generate") generate = true;
+        else if (arg == "--check-kernels") checkKernels = true;
+        else if (arg == "--check-tree") checkTree = true;
+        else {
+            std::cerr << "Usage: Benchmark [--counts A,B,...] [--sources 1-4] [--max-direct N]\n"
+                         "                 [--min-time S] [--threads N] [--seed N] [--json FILE]\n"
+                         "       Benchmark --energy [--orbit-time T] [--threads N] [--seed N] [--json FILE]\n"
+                         "       Benchmark --generate [--counts A,B,...] [--threads N] [--seed N] [--json FILE]\n"
+                         "       Benchmark --check-kernels [--seed N]\n"
+                         "       Benchmark --check-tree [--seed N]\n";
+            return -1;
+        }
+    }
+
+    if (checkKernels) return runKernelCheck(seed) ? 0 : 1;
+    if (checkTree) return runTreeCheck(seed) ? 0 : 1;
+
+    if (energy) {
+        runEnergyBenchmark(orbitTime, seed, physics, jsonPath);
+        return 0;
+    }
+
+    std::sort(counts.begin(), counts.end());
+
+    if (generate) {
+        runGenerateBenchmark(counts, seed, physics.threadCount, jsonPath);
+        return 0;
+    }
+
+    if (sourceCount < 1 || sourceCount > 4) {
+        std::cerr << "--sources must be between 1 and 4\n";
+        return -1;
+    }
+
+    const BenchCase cases[] = {
+        { "sources-only", false, GravitySolver::BarnesHut, false, 0.0f, false },
+        { "sources-field", false, GravitySolver::BarnesHut, true, 0.0f, false },
+        { "sources-kepler", false, GravitySolver::BarnesHut, false, 0.0f, true },
+        { "mutual-barnes-hut", true, GravitySolver::BarnesHut, false, 0.0f, false },
+        { "mutual-mesh", true, GravitySolver::ParticleMesh, false, 0.0f, false },
+        { "mutual-direct", true, GravitySolver::DirectSum, false, 0.0f, false },
+        { "mutual-direct-passive", true, GravitySolver::DirectSum, false, 0.1f, false }
+    };
+
+    std::vector<BenchResult> results;
+    std::vector<GravitySource> sources;
+
+    // Build the solution with SIMULATOR_DOUBLE_PRECISION to compare the two
+    std::cout << "Simulation precision: " << (sizeof(Scalar) == sizeof(double) ? "double" : "float") << "\n";
+    std::cout << "mode                    particles     steps   ns/particle-step     steps/s   memory (KiB)\n";
+
+    for (const BenchCase& bench : cases) {
+        for (size_t count : counts) {
+            // Direct sum is O(N^2); past this it only measures patience
+            if (bench.solver == GravitySolver::DirectSum && bench.mutualGravity && count > maxDirect) continue;
+
+            // Fresh store and force-pass scratch per case so the memory
+            // reported is only what this case allocates
+            ParticleSystem particles;
+            WarpState warp;
+            releaseForcePassMemory();
+            buildScene(count, sourceCount, seed, sources, particles);
+            physics.solver = bench.solver;
+            physics.sourceField = bench.sourceField;
+            physics.passiveMass = bench.passiveMass;
+            physics.keplerOrbits = bench.keplerOrbits;
+
+            // Warm-up step fills the acceleration cache, tree and thread pool;
+            // Kepler orbits also sort the particles on their first jump
+            updateParticles(particles, sources, bench.mutualGravity, physics);
+            if (bench.keplerOrbits) warpParticles(particles, sources, physics, KEPLER_JUMP, warp);
+
+            long steps = 0;
+            auto start = std::chrono::steady_clock::now();
+            double seconds = 0.0;
+            while (steps < 3 || seconds < minTime) {
+                if (bench.keplerOrbits) {
+                    warpParticles(particles, sources, physics, KEPLER_JUMP, warp);
+                    steps += KEPLER_JUMP;
+                }
+                else {
+                    updateParticles(particles, sources, bench.mutualGravity, physics);
+                    ++steps;
+                }
+                seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            }
+
+            BenchResult r;
+            r.mode = bench.mode;
+            r.particles = count;
+            r.steps = steps;
+            r.seconds = seconds;
+            r.nsPerParticleStep = seconds * 1e9 / (static_cast<double>(steps) * count);
+            r.stepsPerSecond = steps / seconds;
+            r.memoryBytes = particles.memory_bytes() + forcePassMemoryBytes();
+            results.push_back(r);
+
+            std::printf("%-22s %10zu %9ld %18.2f %11.2f %14.1f\n", r.mode.c_str(), r.particles, r.steps,
+                r.nsPerParticleStep, r.stepsPerSecond, r.memoryBytes / 1024.0);
+        }
+    }
+
+    if (!jsonPath.empty()) writeJson(jsonPath, results, sourceCount, physics.threadCount, seed);
+    return 0;
+}
@@ -0,0 +1,423 @@
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include "Diagnostics.h"
+#include "Integrators.h"
+#include "Scenario.h"
+#include "Simulation.h"
+#include "Snapshot.h"
+#include "Trajectory.h"
+
+// Batch driver: runs a scenario with no window, font or frame limit.
+//
+//   Headless <scenario.txt> [options]
+//   Headless --resume <snapshot.ogs> [options]
+//     --steps N            physics steps to run (default 1000)
+//     --mutual             force mutual gravity on
+//     --dt D               physics step size (default 1.5)
+//     --max-level K        block timesteps down to dt / 2^K, 0 = single global step (default 0)
+//     --solver S           direct | barnes-hut | pm (default direct)
+//     --theta T            Barnes-Hut opening angle (default 0.5)
+//     --mesh-size N        particle-mesh grid points per side (default 512)
+//     --mesh-padding P     particle-mesh margin, fraction of the particles' extent (default 0.05)
+//     --mesh-assignment A  cic | tsc (default cic)
+//     --p3m                add the exact short-range force to the particle mesh
+//     --source-field       read the sources' pull from a cached field (pays off with many sources)
+//     --passive-mass M     particles lighter than M feel mutual gravity but exert none (default 0)
+//     --kepler             without mutual gravity, move undisturbed orbits in closed form,
+//                          jumping from one output frame to the next
+//     --kepler-tolerance T  pull those orbits may ignore, fraction of the source's (default 0.01)
+//     --threads N          force-pass threads, 0 = all (default 0)
+//     --simd S             scalar | sse | avx2 (default avx2, capped by CPU)
+//     --integrator I       leapfrog | yoshida4 | rk45 (default leapfrog)
+//     --rk45-tolerance T   RK45 position error allowed per substep, px (default 1e-4)
+//     --collisions C       none | merge | bounce (default none)
+//     --restitution E      bounce restitution, 1 = elastic (default 1)
+//     --absorb             particles touching a source are absorbed into it
+//     --seed N             seed for the orbit perturbation of placed particles
+//     --output FILE        write particle state as CSV
+//     --output-every K     also write a frame every K steps (needs --output)
+//     --resume FILE        continue from a binary snapshot instead of a scenario;
+//                          its settings apply unless overridden by other options
+//     --save FILE          write a binary snapshot after the last step
+//     --record FILE        stream a compressed trajectory, every frame kept
+//     --record-every K     steps between trajectory frames (default 10)
+//     --rebase-every K     move the origin to the barycenter every K steps, 0 = never
+//                          (default 0); CSV output stays in world coordinates
+//     --diagnostics FILE   write energy, momentum and angular momentum as CSV,
+//                          or JSON if FILE ends in .json
+//     --diagnostics-every K  steps between diagnostics samples (default 100)
+//
+//   Headless --check-trajectory FILE
+//     records a scene that loses, merges and gains particles to FILE, reads
+//     every frame back and exits non-zero if one differs from what was recorded
+
+static void printUsage() {
+    std::cerr <<
+        "Usage: Headless <scenario.txt> [--steps N] [--mutual] [--dt D] [--max-level K]\n"
+        "                [--solver direct|barnes-hut|pm] [--theta T] [--threads N]\n"
+        "                [--mesh-size N] [--mesh-padding P] [--mesh-assignment cic|tsc] [--p3m]\n"
+        "                [--source-field] [--passive-mass M] [--kepler] [--kepler-tolerance T]\n"
+        "                [--simd scalar|sse|avx2] [--integrator leapfrog|yoshida4|rk45]\n"
+        "                [--rk45-tolerance T] [--collisions none|merge|bounce]\n"
+        "                [--restitution E] [--absorb] [--seed N] [--output FILE] [--output-every K]\n"
+        "                [--save FILE] [--record FILE] [--record-every K] [--rebase-every K]\n"
+        "                [--diagnostics FILE] [--diagnostics-every K]\n"
+        "       Headless --resume <snapshot.ogs> [options]\n"
+        "       Headless --check-trajectory FILE\n";
+}
+
+static void writeFrame(std::ofstream& out, long step, const ParticleSystem& particles, sf::Vector2<double> origin) {
+    for (size_t i = 0; i < particles.size(); ++i) {
+        sf::Vector2<double> pos = sf::Vector2<double>(particles.get_pos(i)) + origin;
+        Vector2s vel = particles.get_velocity(i);
+        out << step << ',' << i << ',' << particleTypeName(particles.get_type(i)) << ','
+            << pos.x << ',' << pos.y << ',' << vel.x << ',' << vel.y << '\n';
+    }
+}
+
+// What a replayed frame must reproduce
+struct ExpectedFrame {
+    long step;
+    std::vector<GravitySource> sources;
+    ParticleSystem particles;
+};
+
+static bool sameFrame(const ExpectedFrame& expected, long step, const ParticleSystem& particles,
+    const std::vector<GravitySource>& sources) {
+    // Half a quantum of rounding, plus the float error of the value itself
+    const double positionError = 1.0 / 512.0 + 1.0e-3;
+    const double velocityError = 1.0 / 8192.0 + 1.0e-5;
+    const ParticleSystem& recorded = expected.particles;
+
+    if (step != expected.step || sources.size() != expected.sources.size() || particles.size() != recorded.size())
+        return false;
+    for (size_t s = 0; s < sources.size(); ++s) {
+        if (sources[s].get_type() != expected.sources[s].get_type()
+            || sources[s].get_strength() != expected.sources[s].get_strength()) return false;
+    }
+    for (size_t i = 0; i < particles.size(); ++i) {
+        if (particles.get_type(i) != recorded.get_type(i) || particles.get_mass(i) != recorded.get_mass(i)
+            || particles.get_radius(i) != recorded.get_radius(i)) return false;
+        Vector2s pos = particles.get_pos(i) - recorded.get_pos(i);
+        Vector2s vel = particles.get_velocity(i) - recorded.get_velocity(i);
+        if (std::abs(pos.x) > positionError || std::abs(pos.y) > positionError
+            || std::abs(vel.x) > velocityError || std::abs(vel.y) > velocityError) return false;
+    }
+    return true;
+}
+
+// Records an orbiting scene while particles are removed (swap and
+// compacting), merged into one another and added, crossing several chunks,
+// then checks every frame read back, in order and out of order.
+static bool checkTrajectory(const std::string& path) {
+    const long steps = 100;
+    std::vector<GravitySource> sources;
+    sources.emplace_back(0.0f, 0.0f, GravitySourceType::YellowDwarf);
+    ParticleSystem particles;
+    for (int i = 0; i < 300; ++i) {
+        double r = 400.0 + 2.0 * i;
+        double angle = 0.37 * i;
+        double v = std::sqrt(G * sources[0].get_strength() / r);
+        particles.add(static_cast<Scalar>(r * std::cos(angle)), static_cast<Scalar>(r * std::sin(angle)),
+            static_cast<Scalar>(-v * std::sin(angle)), static_cast<Scalar>(v * std::cos(angle)),
+            static_cast<ParticleType>(i % 3));
+    }
+
+    TrajectoryRecorder recorder;
+    if (!recorder.open(path, 1)) return false;
+    recorder.set_drop_when_busy(false);
+
+    PhysicsSettings physics;
+    std::vector<ExpectedFrame> expected;
+    for (long step = 1; step <= steps; ++step) {
+        updateParticles(particles, sources, false, physics);
+
+        // The last particle, of another type, moves into the gap
+        if (step % 10 == 3) particles.remove(static_cast<size_t>(step));
+        // Everything after the first removed particle shifts down
+        if (step % 25 == 7) {
+            std::vector<unsigned char> removed(particles.size(), 0);
+            for (size_t i = static_cast<size_t>(step); i < removed.size(); i += 17) removed[i] = 1;
+            particles.remove_marked(removed);
+        }
+        // A merge: the survivor grows and its partner goes
+        if (step % 20 == 11) {
+            size_t survivor = static_cast<size_t>(step) % particles.size();
+            size_t partner = (survivor + 1) % particles.size();
+            particles.set_mass(survivor, particles.get_mass(survivor) + particles.get_mass(partner));
+            particles.set_radius(survivor, particles.get_radius(survivor) * 1.26f);
+            particles.remove(partner);
+        }
+        // One out and one in keeps the count
+        if (step % 30 == 19) {
+            particles.remove(0);
+            particles.add(Scalar(900), Scalar(0), Scalar(0), Scalar(std::sqrt(G * sources[0].get_strength() / 900.0)),
+                ParticleType::Terrestrial);
+        }
+        if (step % 40 == 29) sources[0].set_strength(sources[0].get_strength() * 1.01f);
+
+        recorder.record(step, step * static_cast<double>(physics.dt), particles, sources);
+        expected.push_back({ step, sources, particles });
+    }
+    recorder.close();
+
+    TrajectoryReader reader;
+    if (!reader.open(path)) return false;
+    if (reader.frame_count() != expected.size()) {
+        std::cerr << "Read " << reader.frame_count() << " frames, recorded " << expected.size() << "\n";
+        return false;
+    }
+
+    // Every frame in order, then backwards so each decodes from its chunk's start
+    std::vector<size_t> order;
+    for (size_t f = 0; f < expected.size(); ++f) order.push_back(f);
+    for (size_t f = expected.size(); f-- > 0;) order.push_back(f);
+
+    ParticleSystem replayed;
+    std::vector<GravitySource> replayedSources;
+    for (size_t f : order) {
+        long step = 0;
+        if (!reader.read_frame(f, replayed, replayedSources, &step)
+            || !sameFrame(expected[f], step, replayed, replayedSources)) {
+            std::cerr << "Trajectory frame " << f << " does not match what was recorded\n";
+            return false;
+        }
+    }
+    std::cout << "Trajectory round trip: " << expected.size() << " frames match\n";
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printUsage();
+        return -1;
+    }
+    if (std::string(argv[1]) == "--check-trajectory") {
+        if (argc != 3) {
+            printUsage();
+            return -1;
+        }
+        return checkTrajectory(argv[2]) ? 0 : 1;
+    }
+
+    std::string scenarioPath;
+    std::string snapshotPath;
+    std::string savePath;
+    std::string recordPath;
+    long recordEvery = 10;
+    std::string outputPath;
+    long steps = 1000;
+    long outputEvery = 0;
+    long rebaseEvery = 0;
+    std::string diagnosticsPath;
+    int diagnosticsEvery = 100;
+    unsigned seed = 1;
+    bool forceMutual = false;
+    PhysicsSettings physics;
+
+    // A resumed run starts from the snapshot's settings; the option loop
+    // below then overrides whatever was given explicitly
+    Snapshot snapshot;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "--resume") snapshotPath = argv[i + 1];
+    }
+    if (!snapshotPath.empty()) {
+        if (!loadSnapshot(snapshotPath, snapshot)) return -1;
+        physics = snapshot.settings;
+    }
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--steps" && hasValue) steps = std::atol(argv[++i]);
+        else if (arg == "--mutual") forceMutual = true;
+        else if (arg == "--dt" && hasValue) physics.dt = static_cast<float>(std::atof(argv[++i]));
+        else if (arg == "--max-level" && hasValue) {
+            physics.maxStepLevel = std::atoi(argv[++i]);
+            physics.blockTimesteps = physics.maxStepLevel > 0;
+        }
+        else if (arg == "--theta" && hasValue) physics.theta = static_cast<float>(std::atof(argv[++i]));
+        else if (arg == "--mesh-size" && hasValue) physics.meshSize = std::atoi(argv[++i]);
+        else if (arg == "--mesh-padding" && hasValue) physics.meshPadding = static_cast<float>(std::atof(argv[++i]));
+        else if (arg == "--p3m") physics.meshShortRange = true;
+        else if (arg == "--source-field") physics.sourceField = true;
+        else if (arg == "--passive-mass" && hasValue) physics.passiveMass = static_cast<float>(std::atof(argv[++i]));
+        else if (arg == "--kepler") physics.keplerOrbits = true;
+        else if (arg == "--kepler-tolerance" && hasValue) physics.keplerTolerance = static_cast<float>(std::atof(argv[++i]));
+        else if (arg == "--threads" && hasValue) physics.threadCount = static_cast<unsigned>(std::atoi(argv[++i]));
+        else if (arg == "--seed" && hasValue) seed = static_cast<unsigned>(std::atoi(argv[++i]));
+        else if (arg == "--output" && hasValue) outputPath = argv[++i];
+        else if (arg == "--resume" && hasValue) ++i;
+        else if (arg == "--save" && hasValue) savePath = argv[++i];
+        else if (arg == "--record" && hasValue) recordPath = argv[++i];
+        else if (arg == "--record-every" && hasValue) recordEvery = std::atol(argv[++i]);
+        else if (arg == "--output-every" && hasValue) outputEvery = std::atol(argv[++i]);
+        else if (arg == "--rebase-every" && hasValue) rebaseEvery = std::atol(argv[++i]);
+        else if (arg == "--diagnostics" && hasValue) diagnosticsPath = argv[++i];
+        else if (arg == "--diagnostics-every" && hasValue) diagnosticsEvery = std::atoi(argv[++i]);
+        else if (arg == "--solver" && hasValue) {
+            std::string value = argv[++i];
+            if (value == "direct") physics.solver = GravitySolver::DirectSum;
+            else if (value == "barnes-hut") physics.solver = GravitySolver::BarnesHut;
+            else if (value == "pm") physics.solver = GravitySolver::ParticleMesh;
+            else {
+                std::cerr << "Unknown solver " << value << "\n";
+                return -1;
+            }
+        }
+        else if (arg == "--mesh-assignment" && hasValue) {
+            std::string value = argv[++i];
+            if (value == "cic") physics.meshAssignment = MeshAssignment::CloudInCell;
+            else if (value == "tsc") physics.meshAssignment = MeshAssignment::TriangularShapedCloud;
+            else {
+                std::cerr << "Unknown mesh assignment " << value << "\n";
+                return -1;
+            }
+        }
+        else if (arg == "--integrator" && hasValue) {
+            std::string value = argv[++i];
+            if (value == "leapfrog") physics.integrator = Integrator::Leapfrog;
+            else if (value == "yoshida4") physics.integrator = Integrator::Yoshida4;
+            else if (value == "rk45") physics.integrator = Integrator::RK45;
+            else {
+                std::cerr << "Unknown integrator " << value << "\n";
+                return -1;
+            }
+        }
+        else if (arg == "--rk45-tolerance" && hasValue) physics.rk45Tolerance = static_cast<float>(std::atof(argv[++i]));
+        else if (arg == "--restitution" && hasValue) physics.restitution = static_cast<float>(std::atof(argv[++i]));
+        else if (arg == "--absorb") physics.absorbIntoSources = true;
+        else if (arg == "--collisions" && hasValue) {
+            std::string value = argv[++i];
+            if (value == "none") physics.collisions = CollisionResponse::None;
+            else if (value == "merge") physics.collisions = CollisionResponse::Merge;
+            else if (value == "bounce") physics.collisions = CollisionResponse::Bounce;
+            else {
+                std::cerr << "Unknown collision response " << value << "\n";
+                return -1;
+            }
+        }
+        else if (arg == "--simd" && hasValue) {
+            std::string value = argv[++i];
+            if (value == "scalar") physics.simd = SimdLevel::Scalar;
+            else if (value == "sse") physics.simd = SimdLevel::SSE;
+            else if (value == "avx2") physics.simd = SimdLevel::AVX2;
+            else {
+                std::cerr << "Unknown SIMD level " << value << "\n";
+                return -1;
+            }
+        }
+        else if (arg[0] != '-' && scenarioPath.empty()) scenarioPath = arg;
+        else {
+            printUsage();
+            return -1;
+        }
+    }
+
+    std::srand(seed);
+    Scenario scenario;
+    double simTime = 0.0;
+    sf::Vector2<double> origin;
+    if (!snapshotPath.empty()) {
+        if (!scenarioPath.empty()) {
+            printUsage();
+            return -1;
+        }
+        scenario.sources = std::move(snapshot.sources);
+        scenario.particles = std::move(snapshot.particles);
+        scenario.mutualGravity = snapshot.mutualGravity;
+        simTime = snapshot.time;
+        origin = snapshot.origin;
+    }
+    else if (scenarioPath.empty() || !loadScenario(scenarioPath, scenario)) return -1;
+    bool mutualGravity = scenario.mutualGravity || forceMutual;
+
+    std::ofstream output;
+    if (!outputPath.empty()) {
+        output.open(outputPath);
+        if (!output) {
+            std::cerr << "Failed to open " << outputPath << "\n";
+            return -1;
+        }
+        output << "step,index,type,x,y,vx,vy\n";
+    }
+
+    std::cout << "Running " << steps << " steps: " << scenario.particles.size() << " particles, "
+        << scenario.sources.size() << " sources, mutual gravity " << (mutualGravity ? "on" : "off")
+        << ", " << integratorName(physics.integrator) << " integrator\n";
+
+    // Batch runs want complete trajectories, so the recorder waits rather than drops
+    TrajectoryRecorder recorder;
+    if (!recordPath.empty()) {
+        if (!recorder.open(recordPath, static_cast<int>(recordEvery))) return -1;
+        recorder.set_drop_when_busy(false);
+    }
+
+    Diagnostics diagnostics(diagnosticsPath.empty() ? 0 : std::max(diagnosticsEvery, 1));
+    if (diagnostics.is_enabled())
+        diagnostics.sample(0, simTime, scenario.particles, scenario.sources, mutualGravity, physics);
+
+    CollisionStats collisionTotals;
+    auto start = std::chrono::steady_clock::now();
+    // Closed-form orbits jump from one written frame to the next when
+    // nothing needs the steps in between
+    bool warp = physics.keplerOrbits && !mutualGravity && physics.collisions == CollisionResponse::None
+        && !physics.absorbIntoSources && recordPath.empty() && !diagnostics.is_enabled() && rebaseEvery <= 0;
+    WarpState warpState;
+    for (long step = 1; step <= steps; ++step) {
+        if (warp) {
+            long last = outputEvery > 0 ? std::min(steps, (step + outputEvery - 1) / outputEvery * outputEvery) : steps;
+            long span = std::min<long>(last - step + 1, INT_MAX);
+            warpParticles(scenario.particles, scenario.sources, physics, static_cast<int>(span), warpState);
+            step += span - 1;
+        }
+        else {
+            CollisionStats stats = updateParticles(scenario.particles, scenario.sources, mutualGravity, physics);
+            collisionTotals.merged += stats.merged;
+            collisionTotals.bounced += stats.bounced;
+            collisionTotals.separated += stats.separated;
+            collisionTotals.absorbed += stats.absorbed;
+        }
+        recorder.record(step, simTime + step * static_cast<double>(physics.dt), scenario.particles, scenario.sources);
+        diagnostics.step(step, simTime + step * static_cast<double>(physics.dt),
+            scenario.particles, scenario.sources, mutualGravity, physics);
+        if (rebaseEvery > 0 && step % rebaseEvery == 0) {
+            Vector2s shift = barycenter(scenario.particles, scenario.sources);
+            rebaseOrigin(scenario.particles, scenario.sources, shift);
+            origin += sf::Vector2<double>(shift);
+        }
+        if (output.is_open() && outputEvery > 0 && step % outputEvery == 0 && step != steps)
+            writeFrame(output, step, scenario.particles, origin);
+    }
+    recorder.close();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    simTime += steps * static_cast<double>(physics.dt);
+
+    if (output.is_open()) writeFrame(output, steps, scenario.particles, origin);
+    if (!savePath.empty() &&
+        !saveSnapshot(savePath, scenario.sources, scenario.particles, mutualGravity, physics, simTime, origin)) return -1;
+
+    if (physics.collisions != CollisionResponse::None || physics.absorbIntoSources)
+        std::cout << "Collisions: " << collisionTotals.merged << " merged, " << collisionTotals.bounced
+            << " bounced, " << collisionTotals.separated << " pushed apart, " << collisionTotals.absorbed
+            << " absorbed, " << scenario.particles.size() << " particles left\n";
+    if (diagnostics.is_enabled()) {
+        bool json = diagnosticsPath.size() >= 5 && diagnosticsPath.compare(diagnosticsPath.size() - 5, 5, ".json") == 0;
+        if (!(json ? diagnostics.write_json(diagnosticsPath) : diagnostics.write_csv(diagnosticsPath))) return -1;
+        std::cout << "Diagnostics: " << diagnostics.get_samples().size() << " samples, energy drift "
+            << diagnostics.energy_drift() << ", angular momentum drift " << diagnostics.angular_momentum_drift() << "\n";
+    }
+    if (!recordPath.empty())
+        std::cout << "Recorded " << recorder.get_frames_written() << " frames to " << recordPath << "\n";
+    std::cout << "Done in " << seconds << " s (" << (seconds > 0.0 ? steps / seconds : 0.0) << " steps/s)\n";
+    return 0;
+}
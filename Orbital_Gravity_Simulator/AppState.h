@@ -6,7 +6,8 @@ enum class AppState {
     StartMenu,
     AwaitingSources,
     Running,
-    Paused
+    Paused,
+    Replaying  // showing a recorded trajectory, physics stopped
 };
 
 // Enum for the current interaction mode
@@ -0,0 +1,295 @@
+#include "SimulationThread.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include "Generators.h"
+#include "Profiler.h"
+#include "Simulation.h"
+
+// A lagging simulation still shows progress at about this rate
+const sf::Time MAX_PUBLISH_INTERVAL = sf::milliseconds(16);
+
+// Sleep between idle polls of the command queue
+const sf::Time IDLE_WAIT = sf::milliseconds(1);
+
+// Time warp: particle-steps of integration one jump may take, so a jump
+// that cannot be closed-form for every particle still publishes often
+const size_t WARP_STEP_BUDGET = size_t(1) << 18;
+
+sf::Time simulationClockNow() {
+    static const sf::Clock clock;
+    return clock.getElapsedTime();
+}
+
+void SimulationFrame::capture(const ParticleSystem& particles, const std::vector<GravitySource>& sources) {
+    size_t n = particles.size();
+    posX.assign(particles.pos_x(), particles.pos_x() + n);
+    posY.assign(particles.pos_y(), particles.pos_y() + n);
+    prevX.assign(particles.prev_x(), particles.prev_x() + n);
+    prevY.assign(particles.prev_y(), particles.prev_y() + n);
+    radius.assign(particles.radii(), particles.radii() + n);
+    type.assign(particles.types(), particles.types() + n);
+    this->sources = sources;
+}
+
+float SimulationFrame::blend(sf::Time now) const {
+    if (stepSeconds <= 0.0f) return 1.0f;
+    float elapsed = (now - publishedAt).asSeconds();
+    return std::min(1.0f, interpolation + elapsed / stepSeconds);
+}
+
+SimulationThread::SimulationThread(size_t reserveParticles) {
+    particles.reserve(reserveParticles);
+    sources.reserve(16);
+    publish(1.0f);
+    thread = std::thread(&SimulationThread::run, this);
+}
+
+SimulationThread::~SimulationThread() {
+    stopping = true;
+    thread.join();
+    stop_recording();
+}
+
+bool SimulationThread::post(SimulationCommand command) {
+    if (!commands.push(std::move(command))) {
+        std::cerr << "Simulation command queue full, input dropped\n";
+        return false;
+    }
+    ++posted;
+    return true;
+}
+
+void SimulationThread::flush() {
+    while (applied.load(std::memory_order_acquire) < posted) sf::sleep(IDLE_WAIT);
+}
+
+bool SimulationThread::update_frame() {
+    return frames.update();
+}
+
+const SimulationFrame& SimulationThread::get_frame() const {
+    return frames.read_buffer();
+}
+
+Vector2s SimulationThread::to_local(sf::Vector2<double> worldPos) const {
+    return Vector2s(static_cast<Scalar>(worldPos.x - worldOrigin.x), static_cast<Scalar>(worldPos.y - worldOrigin.y));
+}
+
+bool SimulationThread::apply_pending() {
+    bool any = false;
+    SimulationCommand command;
+    while (commands.pop(command)) {
+        apply(command);
+        applied.fetch_add(1, std::memory_order_release);
+        any = true;
+    }
+    return any;
+}
+
+void SimulationThread::run() {
+    while (!stopping) {
+        bool changed = apply_pending();
+
+        int steps = 0;
+        if (config.running) {
+            steps = stepper.advance(stepClock.restart().asSeconds());
+        }
+
+        if (steps > 0) {
+            PROFILE_SCOPE("Physics");
+            sf::Time lastPublish = simulationClockNow();
+            if (changed) warpIntegrated = SIZE_MAX;
+            for (int step = 0; step < steps && config.running && !stopping;) {
+                // Closed-form orbits can cross the batch in one jump. Collisions,
+                // recording and diagnostics need every step, so they rule it out.
+                bool warp = config.physics.keplerOrbits && !config.mutualGravity
+                    && config.physics.collisions == CollisionResponse::None && !config.physics.absorbIntoSources
+                    && !recorder.is_open() && diagnostics.get_every_steps() == 0;
+
+                int taken = 1;
+                if (warp) {
+                    // All but the last step, which stays an ordinary one for
+                    // render interpolation; shorter if the jump integrates
+                    // particles, and short until a jump has found out how many
+                    size_t jump = static_cast<size_t>(steps - step - 1);
+                    if (warpIntegrated == SIZE_MAX) jump = std::min<size_t>(jump, 2);
+                    else if (warpIntegrated > 0) jump = std::min(jump, WARP_STEP_BUDGET / warpIntegrated);
+                    if (jump > 1) {
+                        warpIntegrated = warpParticles(particles, sources, config.physics, static_cast<int>(jump), warpState);
+                        taken += static_cast<int>(jump);
+                    }
+                }
+                particles.save_positions();
+                updateParticles(particles, sources, config.mutualGravity, config.physics);
+                step += taken;
+                simStep += taken;
+                simTime += static_cast<double>(config.physics.dt) * taken;
+                recorder.record(simStep, simTime, particles, sources);
+                diagnostics.step(simStep, simTime, particles, sources, config.mutualGravity, config.physics);
+
+                // Steps slower than frames: show and take input after each
+                // one rather than only after the whole batch
+                if (step < steps && simulationClockNow() - lastPublish > MAX_PUBLISH_INTERVAL) {
+                    if (apply_pending()) warpIntegrated = SIZE_MAX;
+                    publish(0.0f);
+                    lastPublish = simulationClockNow();
+                }
+            }
+        }
+
+        if (steps > 0) publish(stepper.interpolation());
+        else if (changed) publish(1.0f);
+        else sf::sleep(IDLE_WAIT);
+    }
+}
+
+void SimulationThread::publish(float interpolation) {
+    PROFILE_SCOPE("Publish");
+    SimulationFrame& frame = frames.write_buffer();
+    frame.capture(particles, sources);
+    frame.origin = worldOrigin;
+    frame.step = simStep;
+    frame.time = simTime;
+    frame.interpolation = config.running ? interpolation : 1.0f;
+    frame.stepSeconds = config.running ? stepper.get_step_dt() / (BASE_SIM_RATE * stepper.get_time_scale()) : 0.0f;
+    frame.publishedAt = simulationClockNow();
+
+    frame.recording = recorder.is_open();
+    frame.diagnosticsEvery = diagnostics.get_every_steps();
+    frame.diagnosticsSamples = diagnostics.get_samples().size();
+    frame.diagnostics = frame.diagnosticsSamples > 0 ? diagnostics.get_samples().back() : DiagnosticsSample();
+    frame.energyDrift = diagnostics.energy_drift();
+    frame.angularMomentumDrift = diagnostics.angular_momentum_drift();
+    frames.publish();
+}
+
+void SimulationThread::stop_recording() {
+    if (!recorder.is_open()) return;
+    size_t dropped = recorder.get_frames_dropped();
+    recorder.close();
+    std::cout << "Recorded " << recorder.get_frames_written() << " frames to " << recordingPath
+        << " (" << dropped << " dropped)\n";
+}
+
+void SimulationThread::apply(SimulationCommand& command) {
+    switch (command.type) {
+    case SimulationCommandType::Configure:
+        // Paused time is not owed as steps on resume
+        if (command.config.running && !config.running) stepClock.restart();
+        config = command.config;
+        stepper.set_time_scale(config.timeScale);
+        stepper.set_substeps(config.substeps);
+        config.physics.dt = stepper.get_step_dt();
+        break;
+
+    case SimulationCommandType::AddSource: {
+        Vector2s pos = to_local(command.worldPos);
+        sources.emplace_back(pos.x, pos.y, command.sourceType);
+        particles.set_accelerations_valid(false);
+        break;
+    }
+
+    case SimulationCommandType::AddParticle: {
+        Vector2s pos = to_local(command.worldPos);
+        size_t source = findNearestSource(pos, sources);
+        if (source != NO_BODY)
+            addParticlesAtPosition(particles, pos, particles.size(), particles.size(), command.particleType, sources[source]);
+        else
+            particles.add(pos.x, pos.y, 0, 0, command.particleType);
+        break;
+    }
+
+    case SimulationCommandType::SpawnDisk: {
+        if (sources.empty()) break;
+        Vector2s pos = to_local(command.worldPos);
+        const GravitySource& source = sources[findNearestSource(pos, sources)];
+        Vector2s d = pos - source.get_pos();
+        Scalar dist = std::sqrt(d.x * d.x + d.y * d.y);
+
+        DiskSpec spec;
+        spec.type = command.particleType;
+        spec.count = command.count;
+        spec.innerRadius = std::max(dist * Scalar(0.8), Scalar(source.get_radius() * 2));
+        spec.outerRadius = std::max(dist * Scalar(1.2), spec.innerRadius + 1);
+        spec.selfGravity = config.mutualGravity;
+        generateDisk(particles, source, spec, command.seed, config.physics.threadCount);
+        break;
+    }
+
+    case SimulationCommandType::RemoveParticle: {
+        size_t i = findNearestParticle(to_local(command.worldPos), particles, static_cast<Scalar>(command.pickRadius));
+        if (i != NO_BODY) particles.remove(i);
+        break;
+    }
+
+    case SimulationCommandType::RemoveSource: {
+        Vector2s pos = to_local(command.worldPos);
+        size_t i = findNearestSource(pos, sources);
+        if (i == NO_BODY) break;
+        Vector2s d = sources[i].get_pos() - pos;
+        if (std::sqrt(d.x * d.x + d.y * d.y) <= sources[i].get_radius() + command.pickRadius)
+            removeSource(particles, sources, i);
+        break;
+    }
+
+    case SimulationCommandType::Rebase: {
+        rebaseOrigin(particles, sources, to_local(command.worldPos));
+        worldOrigin = command.worldPos;
+        break;
+    }
+
+    case SimulationCommandType::Reset:
+        particles.clear();
+        sources.clear();
+        stepper.reset();
+        warpState = WarpState();
+        simTime = 0.0;
+        simStep = 0;
+        worldOrigin = sf::Vector2<double>();
+        diagnostics.clear(particles);
+        break;
+
+    case SimulationCommandType::LoadScene:
+        sources = std::move(command.snapshot->sources);
+        particles = std::move(command.snapshot->particles);
+        simTime = command.snapshot->time;
+        worldOrigin = command.snapshot->origin;
+        stepper.reset();
+        warpState = WarpState();
+        diagnostics.clear(particles);
+        break;
+
+    case SimulationCommandType::SaveSnapshot:
+        if (saveSnapshot(command.path, sources, particles, config.mutualGravity, config.physics, simTime, worldOrigin))
+            std::cout << "Saved " << particles.size() << " particles to " << command.path << "\n";
+        break;
+
+    case SimulationCommandType::ToggleRecording:
+        if (recorder.is_open()) {
+            stop_recording();
+        }
+        else if (recorder.open(command.path, command.everySteps)) {
+            recordingPath = command.path;
+        }
+        break;
+
+    case SimulationCommandType::StopRecording:
+        stop_recording();
+        break;
+
+    case SimulationCommandType::ToggleDiagnostics:
+        if (diagnostics.is_enabled()) {
+            if (diagnostics.write_csv(command.path))
+                std::cout << "Wrote " << diagnostics.get_samples().size() << " diagnostics samples to "
+                    << command.path << "\n";
+            diagnostics.set_every_steps(0);
+            diagnostics.clear(particles);
+        }
+        else {
+            diagnostics.set_every_steps(command.everySteps);
+            diagnostics.sample(simStep, simTime, particles, sources, config.mutualGravity, config.physics);
+        }
+        break;
+    }
+}
@@ -0,0 +1,151 @@
+#ifndef SIMULATOR_SIMULATIONTHREAD_H
+#define SIMULATOR_SIMULATIONTHREAD_H
+
+#include <SFML/System.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "CommandQueue.h"
+#include "Diagnostics.h"
+#include "GravitySource.h"
+#include "ParticleSystem.h"
+#include "PhysicsSettings.h"
+#include "Simulation.h"
+#include "Snapshot.h"
+#include "TimeStepper.h"
+#include "Trajectory.h"
+#include "TripleBuffer.h"
+
+// What the UI controls about the running simulation
+struct SimulationConfig {
+    PhysicsSettings physics;
+    bool mutualGravity = false;
+    bool running = false;  // stepping; adding and removing bodies works either way
+    float timeScale = 1.0f;
+    int substeps = 3;
+};
+
+enum class SimulationCommandType {
+    Configure,
+    AddSource,
+    AddParticle,         // on an orbit around the nearest source
+    SpawnDisk,           // through the position, around the nearest source
+    RemoveParticle,      // nearest within pickRadius
+    RemoveSource,        // nearest, if pickRadius reaches its surface
+    Rebase,              // move the simulation's (0, 0) to worldPos
+    Reset,
+    LoadScene,           // replace everything with the snapshot
+    SaveSnapshot,        // to path
+    ToggleRecording,     // trajectory to path, a frame every everySteps
+    StopRecording,
+    ToggleDiagnostics    // on every everySteps steps, or off writing CSV to path
+};
+
+// Positions are world coordinates: the UI's view origin plus view position
+struct SimulationCommand {
+    SimulationCommandType type;
+    SimulationConfig config;
+    sf::Vector2<double> worldPos;
+    ParticleType particleType = ParticleType::Planetoid;
+    GravitySourceType sourceType = GravitySourceType::RedDwarf;
+    double pickRadius = 0.0;
+    size_t count = 0;
+    uint64_t seed = 0;
+    int everySteps = 0;
+    const char* path = nullptr;  // string literal, outlives the command
+    std::shared_ptr<Snapshot> snapshot;
+
+    explicit SimulationCommand(SimulationCommandType type = SimulationCommandType::Configure) : type(type) {}
+};
+
+// Everything the UI draws, copied out after each batch of steps
+struct SimulationFrame {
+    std::vector<Scalar> posX, posY, prevX, prevY;
+    std::vector<float> radius;
+    std::vector<ParticleType> type;
+    std::vector<GravitySource> sources;
+    sf::Vector2<double> origin;  // world position of the frame's (0, 0)
+
+    long step = 0;
+    double time = 0.0;
+    // Blend from prev to pos: interpolation at publishedAt, then one step per stepSeconds
+    float interpolation = 1.0f;
+    float stepSeconds = 0.0f;  // 0 while not running
+    sf::Time publishedAt;
+
+    bool recording = false;
+    int diagnosticsEvery = 0;  // 0 = off
+    size_t diagnosticsSamples = 0;
+    DiagnosticsSample diagnostics;  // latest, if any
+    double energyDrift = 0.0;
+    double angularMomentumDrift = 0.0;
+
+    void capture(const ParticleSystem& particles, const std::vector<GravitySource>& sources);
+    size_t size() const { return posX.size(); }
+    // Fraction of the way from prev to pos at the given time on the shared clock
+    float blend(sf::Time now) const;
+};
+
+// Owns the scene and steps it on a thread of its own, so a slow physics
+// step never holds up input or drawing. The UI posts commands through a
+// bounded lock-free queue and draws the newest complete frame from a
+// triple buffer; neither side waits on the other. Both are single
+// producer, single consumer: only the thread that constructed this may
+// post or read frames.
+class SimulationThread {
+public:
+    static constexpr size_t QUEUE_CAPACITY = 256;
+
+private:
+    // Sim thread only, once started
+    ParticleSystem particles;
+    std::vector<GravitySource> sources;
+    SimulationConfig config;
+    TimeStepper stepper;
+    sf::Clock stepClock;
+    double simTime = 0.0;
+    long simStep = 0;
+    sf::Vector2<double> worldOrigin;
+    Diagnostics diagnostics;
+    TrajectoryRecorder recorder;
+    const char* recordingPath = "";
+    WarpState warpState;
+    size_t warpIntegrated = SIZE_MAX;  // particles the last time-warp jump integrated, unknown after a change
+
+    CommandQueue<SimulationCommand, QUEUE_CAPACITY> commands;
+    TripleBuffer<SimulationFrame> frames;
+    std::atomic<bool> stopping{ false };
+    std::atomic<size_t> applied{ 0 };
+    size_t posted = 0;  // UI only
+    std::thread thread;
+
+    void run();
+    bool apply_pending();
+    void apply(SimulationCommand& command);
+    void publish(float interpolation);
+    void stop_recording();
+    Vector2s to_local(sf::Vector2<double> worldPos) const;
+
+public:
+    explicit SimulationThread(size_t reserveParticles);
+    ~SimulationThread();
+
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+
+    // Returns false, dropping the command, if the queue is full
+    bool post(SimulationCommand command);
+    // Blocks until every posted command has been applied
+    void flush();
+
+    // Takes the newest published frame, if there is one
+    bool update_frame();
+    const SimulationFrame& get_frame() const;
+};
+
+// Shared clock for SimulationFrame::publishedAt and blend
+sf::Time simulationClockNow();
+
+#endif
@@ -1,44 +1,114 @@
 #include "Utils.h"
+#include "Integrators.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
 
 sf::Clock simClock;
 
-void addParticlesAtPosition(
-    std::vector<Particle>& particles,
-    sf::Vector2f pos,
-    int count,
-    int i,
-    ParticleType type,
-    const GravitySource& source
-) {
-    float dx = pos.x - source.get_pos().x;
-    float dy = pos.y - source.get_pos().y;
-    float r_sq = dx * dx + dy * dy;
+// Bodies are batched by on-screen size so a frame costs three draw calls
+// however many particles there are: sub-pixel bodies as single points,
+// small ones as textured quads, large ones as triangle fans
+sf::VertexArray pointVertices(sf::Points);
+sf::VertexArray quadVertices(sf::Quads);
+sf::VertexArray meshVertices(sf::Triangles);
+sf::Texture discTexture;
+
+constexpr unsigned DISC_TEXTURE_SIZE = 64;
+constexpr float POINT_RADIUS_PX = 0.5f;                      // below this a body is one pixel
+constexpr float MESH_RADIUS_PX = DISC_TEXTURE_SIZE * 0.5f;   // above this the texture would blur
+constexpr float MESH_EDGE_PX = 4.0f;                         // target fan edge length on screen
 
-    // Handle near-center case
-    if (r_sq < 1e-5f) {
-        particles.emplace_back(pos.x, pos.y, 0, 0, type);
+// White disc with a one-texel soft edge, tinted per vertex
+static const sf::Texture& getDiscTexture() {
+    if (discTexture.getSize().x == 0) {
+        sf::Image image;
+        image.create(DISC_TEXTURE_SIZE, DISC_TEXTURE_SIZE, sf::Color::Transparent);
+        float center = DISC_TEXTURE_SIZE * 0.5f;
+        for (unsigned y = 0; y < DISC_TEXTURE_SIZE; ++y) {
+            for (unsigned x = 0; x < DISC_TEXTURE_SIZE; ++x) {
+                float dx = x + 0.5f - center;
+                float dy = y + 0.5f - center;
+                float coverage = std::min(std::max(center - std::sqrt(dx * dx + dy * dy), 0.0f), 1.0f);
+                image.setPixel(x, y, sf::Color(255, 255, 255, static_cast<sf::Uint8>(coverage * 255)));
+            }
+        }
+        discTexture.loadFromImage(image);
+        discTexture.setSmooth(true);
     }
-    else {
-        float r = std::sqrt(r_sq);
-        float v = std::sqrt(G * source.get_strength() / r);
+    return discTexture;
+}
 
-        // Normalized tangent vector
-        float tx = -dy / r;
-        float ty = dx / r;
+// Visible world rectangle plus the scale it is drawn at
+struct ViewBounds {
+    float left, top, right, bottom;
+    float pixelsPerUnit;
+};
 
-        // Base velocity + small random perturbation
-        float perturbation = 0.05f * v * (std::rand() % 100 - 50) / 50.0f;
-        float vel_x = v * tx + perturbation * tx;
-        float vel_y = v * ty + perturbation * ty;
+static ViewBounds getViewBounds(const sf::RenderWindow& window) {
+    const sf::View& view = window.getView();
+    sf::Vector2f center = view.getCenter();
+    sf::Vector2f half = view.getSize() * 0.5f;
+    return { center.x - half.x, center.y - half.y, center.x + half.x, center.y + half.y,
+        window.getSize().x / view.getSize().x };
+}
+
+// Culls the body against the view and adds it to the batch for its on-screen size
+static void appendBody(const ViewBounds& bounds, float x, float y, float radius, sf::Color color) {
+    if (x + radius < bounds.left || x - radius > bounds.right ||
+        y + radius < bounds.top || y - radius > bounds.bottom) return;
+
+    float screenRadius = radius * bounds.pixelsPerUnit;
+
+    if (screenRadius < POINT_RADIUS_PX) {
+        // Fade by covered pixel fraction so dense regions read as density
+        color.a = static_cast<sf::Uint8>(std::max(color.a * screenRadius / POINT_RADIUS_PX, 48.0f));
+        pointVertices.append(sf::Vertex(sf::Vector2f(x, y), color));
+    }
+    else if (screenRadius <= MESH_RADIUS_PX) {
+        const float size = static_cast<float>(DISC_TEXTURE_SIZE);
+        quadVertices.append(sf::Vertex(sf::Vector2f(x - radius, y - radius), color, sf::Vector2f(0.0f, 0.0f)));
+        quadVertices.append(sf::Vertex(sf::Vector2f(x + radius, y - radius), color, sf::Vector2f(size, 0.0f)));
+        quadVertices.append(sf::Vertex(sf::Vector2f(x + radius, y + radius), color, sf::Vector2f(size, size)));
+        quadVertices.append(sf::Vertex(sf::Vector2f(x - radius, y + radius), color, sf::Vector2f(0.0f, size)));
+    }
+    else {
+        // Segment count follows the on-screen circumference
+        int segments = static_cast<int>(2.0f * 3.14159265f * screenRadius / MESH_EDGE_PX);
+        segments = std::min(std::max(segments, 16), 512);
+        float step = 2.0f * 3.14159265f / segments;
 
-        particles.emplace_back(pos.x, pos.y, vel_x, vel_y, type);
+        sf::Vector2f center(x, y);
+        sf::Vector2f prev(x + radius, y);
+        for (int k = 1; k <= segments; ++k) {
+            sf::Vector2f next(x + radius * std::cos(k * step), y + radius * std::sin(k * step));
+            meshVertices.append(sf::Vertex(center, color));
+            meshVertices.append(sf::Vertex(prev, color));
+            meshVertices.append(sf::Vertex(next, color));
+            prev = next;
+        }
     }
 }
 
+sf::Color getParticleColor(ParticleType type) {
+    switch (type) {
+    case ParticleType::Planetoid:   return sf::Color(165, 42, 42);   // reddish brown
+    case ParticleType::Satellite:   return sf::Color(192, 192, 192); // pale grey
+    case ParticleType::Terrestrial: return sf::Color(11, 102, 35);   // Forest green
+    case ParticleType::GasGiant:    return sf::Color(255, 174, 66);  // Yellowish orange
+    case ParticleType::IceGiant:    return sf::Color(0, 255, 255);   // cyan
+    default:                        return sf::Color::White;
+    }
+}
 
-void updateParticles(std::vector<Particle>& particles, const std::vector<GravitySource>& sources, bool mutualGravity) {
-    for (auto& particle : particles) {
-        particle.update_physics(particles, sources, mutualGravity);
+sf::Color getSourceColor(GravitySourceType type) {
+    switch (type) {
+    case GravitySourceType::RedDwarf:    return sf::Color::Red;
+    case GravitySourceType::WhiteDwarf:  return sf::Color::White;
+    case GravitySourceType::YellowDwarf: return sf::Color(139, 128, 0);
+    case GravitySourceType::NeutronStar: return sf::Color(175, 238, 238);
+    default:                             return sf::Color::White;
     }
 }
 
@@ -53,14 +123,27 @@ void renderScene(
     sf::RenderWindow& window,
     bool pause,
     bool mutualGravity,
-    std::vector<GravitySource>& sources,
-    std::vector<Particle>& particles
+    const PhysicsSettings& settings,
+    const TimeStepper& stepper,
+    const SimulationFrame& frame,
+    float interpolation,
+    Vector2s offset
 ) {
+    char speed[64];
+    std::snprintf(speed, sizeof(speed), "Speed: %gx, %d substeps (dt %.2f)\n",
+        stepper.get_time_scale(), stepper.get_substeps(), stepper.get_step_dt());
+    const char* collisionName = settings.collisions == CollisionResponse::Merge ? "Merge"
+        : settings.collisions == CollisionResponse::Bounce ? "Bounce" : "OFF";
+    const char* solverName = settings.solver == GravitySolver::BarnesHut ? "Barnes-Hut"
+        : settings.solver == GravitySolver::ParticleMesh ? "Particle Mesh" : "Direct Sum";
+    char passiveMass[32] = "OFF";
+    if (settings.passiveMass > 0.0f) std::snprintf(passiveMass, sizeof(passiveMass), "%g", settings.passiveMass);
+
 
     switch (state) {
     case AppState::AwaitingSources:
         instructions.setString(
-            "Click to add gravity sources.\nPress Enter to confirm."
+            "Click to add gravity sources.\nPress Enter to confirm.\nPress F9: Load snapshot"
         );
       
         break;
@@ -69,9 +152,32 @@ void renderScene(
         instructions.setString(
             "Simulation paused.\n"
             "Mutual Gravity: " + std::string(mutualGravity ? "ON" : "OFF") + "\n"
+            "Solver: " + std::string(solverName) + "\n"
+            "Integrator: " + std::string(integratorName(settings.integrator)) + "\n"
+            "Block Timesteps: " + std::string(settings.blockTimesteps ? "ON" : "OFF") + "\n"
+            "Source Field: " + std::string(settings.sourceField ? "ON" : "OFF") + "\n"
+            "Passive Below Mass: " + std::string(passiveMass) + "\n"
+            "Kepler Orbits: " + std::string(settings.keplerOrbits ? (mutualGravity ? "ON, idle under mutual gravity" : "ON") : "OFF") + "\n"
+            "Collisions: " + std::string(collisionName) + (settings.absorbIntoSources ? ", absorbed by sources" : "") + "\n"
+            + std::string(speed) +
             "Left-click: Add " + std::string(mode == Mode::AddParticle ? "Particle" : "Gravity Source") + "\n"
+            "Middle-click: Remove " + std::string(mode == Mode::AddParticle ? "Particle" : "Gravity Source") + "\n"
             "Press P/S: Switch mode\n"
+            "Press N: Spawn a disk through the cursor\n"
+            "Press B: Cycle solver\n"
+            "Press I: Cycle integrator\n"
+            "Press T: Toggle block timesteps\n"
+            "Press F: Toggle source field\n"
+            "Press M: Cycle passive mass\n"
+            "Press K: Toggle Kepler orbits (speeds up to 4096x)\n"
+            "Press C: Cycle collisions, X: Toggle absorption\n"
+            "Press +/-: Change speed\n"
+            "Press [/]: Change substeps\n"
             "Press Space: Resume\n"
+            "Press F5/F9: Save/Load snapshot\n"
+            "Press F6: Start/stop recording, F10: Replay\n"
+            "Press D: Start/stop diagnostics\n"
+            "Press F3: Toggle profiler\n"
             "Press R: Restart\n"
             "Press Esc: Quit"
         );
@@ -81,22 +187,79 @@ void renderScene(
         instructions.setString(
             "Simulation running.\n"
             "Mutual Gravity: " + std::string(mutualGravity ? "ON" : "OFF") + "\n"
+            "Solver: " + std::string(solverName) + "\n"
+            "Integrator: " + std::string(integratorName(settings.integrator)) + "\n"
+            "Block Timesteps: " + std::string(settings.blockTimesteps ? "ON" : "OFF") + "\n"
+            "Source Field: " + std::string(settings.sourceField ? "ON" : "OFF") + "\n"
+            "Passive Below Mass: " + std::string(passiveMass) + "\n"
+            "Kepler Orbits: " + std::string(settings.keplerOrbits ? (mutualGravity ? "ON, idle under mutual gravity" : "ON") : "OFF") + "\n"
+            "Collisions: " + std::string(collisionName) + (settings.absorbIntoSources ? ", absorbed by sources" : "") + "\n"
+            + std::string(speed) +
             "Left-click: Add " + std::string(mode == Mode::AddParticle ? "Particle" : "Gravity Source") + "\n"
+            "Middle-click: Remove " + std::string(mode == Mode::AddParticle ? "Particle" : "Gravity Source") + "\n"
             "Press P/S: Switch mode\n"
+            "Press N: Spawn a disk through the cursor\n"
+            "Press B: Cycle solver\n"
+            "Press I: Cycle integrator\n"
+            "Press T: Toggle block timesteps\n"
+            "Press F: Toggle source field\n"
+            "Press M: Cycle passive mass\n"
+            "Press K: Toggle Kepler orbits (speeds up to 4096x)\n"
+            "Press C: Cycle collisions, X: Toggle absorption\n"
+            "Press +/-: Change speed\n"
+            "Press [/]: Change substeps\n"
             "Press Space: Pause\n"
+            "Press F5/F9: Save/Load snapshot\n"
+            "Press F6: Start/stop recording, F10: Replay\n"
+            "Press D: Start/stop diagnostics\n"
+            "Press F3: Toggle profiler\n"
             "Press R: Restart\n"
             "Press Esc: Quit"
         );
         break;
+
+    case AppState::Replaying:
+        // Frame counter is kept up to date by the replay loop
+        break;
+    }
+
+    // Refill the batches in one pass over the visible bodies
+    ViewBounds bounds = getViewBounds(window);
+    pointVertices.clear();
+    quadVertices.clear();
+    meshVertices.clear();
+
+    // The offset carries the frame into the view's origin while a rebase is in flight
+    for (const auto& source : frame.sources) {
+        sf::Vector2f pos = toRender(source.get_pos() + offset);
+        appendBody(bounds, pos.x, pos.y, source.get_radius(), getSourceColor(source.get_type()));
+    }
+
+    sf::Color typeColors[5];
+    for (int t = 0; t < 5; ++t) typeColors[t] = getParticleColor(static_cast<ParticleType>(t));
+
+    // Positions are blended between the last two physics steps
+    const Scalar* px = frame.posX.data();
+    const Scalar* py = frame.posY.data();
+    const Scalar* prevX = frame.prevX.data();
+    const Scalar* prevY = frame.prevY.data();
+    const float* radii = frame.radius.data();
+    const ParticleType* types = frame.type.data();
+    for (size_t i = 0; i < frame.size(); ++i) {
+        float x = static_cast<float>(prevX[i] + (px[i] - prevX[i]) * interpolation + offset.x);
+        float y = static_cast<float>(prevY[i] + (py[i] - prevY[i]) * interpolation + offset.y);
+        appendBody(bounds, x, y, radii[i], typeColors[static_cast<int>(types[i])]);
     }
 
-    for (auto& source : sources) source.render(window);
-    for (auto& particle : particles) particle.render(window);
+    // Largest first so small bodies stay visible in front of them
+    if (meshVertices.getVertexCount() > 0) window.draw(meshVertices);
+    if (quadVertices.getVertexCount() > 0) window.draw(quadVertices, sf::RenderStates(&getDiscTexture()));
+    if (pointVertices.getVertexCount() > 0) window.draw(pointVertices);
 }
 
 void renderTypes(
-    const std::vector<sf::Text>& particleTypes,
-    const std::vector<sf::Text>& sourceTypes,
+    std::vector<sf::Text>& particleTypes,
+    std::vector<sf::Text>& sourceTypes,
     const ParticleType particleType,
     const GravitySourceType sourceType,
     Mode mode,
@@ -107,7 +270,7 @@ void renderTypes(
     float startY = 20;
     int lineHeight = 30;
 
-    const auto& types = (mode == Mode::AddParticle) ? particleTypes : sourceTypes;
+    auto& types = (mode == Mode::AddParticle) ? particleTypes : sourceTypes;
     int selectedIndex = (mode == Mode::AddParticle)
         ? static_cast<int>(particleType)
         : static_cast<int>(sourceType);
@@ -118,8 +281,9 @@ void renderTypes(
     float alpha = 128 + static_cast<int>(pulse * 127);   // 128-255
     float scale = 1.0f + 0.1f * pulse;                   // 1.0x-1.1x
 
+    // Styled in place; a copy per label per frame reallocates its glyph geometry
     for (size_t i = 0; i < types.size(); ++i) {
-        sf::Text t = types[i];
+        sf::Text& t = types[i];
         t.setPosition(startX, startY + i * lineHeight);
 
         if (i == selectedIndex) {
@@ -138,6 +302,81 @@ void renderTypes(
     }
 }
 
+// Rolling per-phase timings and a frame-time histogram, bottom left
+void renderProfiler(sf::Text& text, sf::RenderWindow& window) {
+#ifdef SIMULATOR_PROFILING
+    PhaseStats frame = profiler.get_frame_stats();
+    std::string lines;
+    char line[160];
+    std::snprintf(line, sizeof(line), "Frame: min %.2f, avg %.2f, p99 %.2f ms (%.0f fps), %zu particles\n",
+        frame.minMs, frame.avgMs, frame.p99Ms, frame.avgMs > 0.0 ? 1000.0 / frame.avgMs : 0.0, profiler.get_particle_count());
+    lines += line;
+    lines += "Phase: min / avg / p99 ms per frame\n";
+    for (const PhaseStats& phase : profiler.get_phase_stats()) {
+        if (phase.frames == 0) continue;
+        std::snprintf(line, sizeof(line), "%s: %.2f / %.2f / %.2f\n", phase.name, phase.minMs, phase.avgMs, phase.p99Ms);
+        lines += line;
+    }
+    lines += profiler.is_tracing() ? "Recording trace, F4: Stop and save" : "Press F4: Record trace";
+    text.setString(lines);
+
+    // Bars of frames per 2 ms bin; bins past 1/60 s in red
+    int counts[Profiler::HISTOGRAM_BINS];
+    profiler.get_frame_histogram(counts);
+    int highest = *std::max_element(counts, counts + Profiler::HISTOGRAM_BINS);
+
+    const float barWidth = 12.0f, histogramHeight = 80.0f;
+    float left = 20.0f;
+    float bottom = window.getSize().y - 20.0f;
+    sf::VertexArray bars(sf::Quads);
+    for (int bin = 0; bin < Profiler::HISTOGRAM_BINS; ++bin) {
+        float height = highest > 0 ? histogramHeight * counts[bin] / highest : 0.0f;
+        float x = left + bin * (barWidth + 2.0f);
+        bool slow = (bin + 1) * Profiler::HISTOGRAM_BIN_MS > 1000.0 / 60.0;
+        sf::Color color = slow ? sf::Color(220, 80, 60) : sf::Color(90, 200, 110);
+        bars.append(sf::Vertex(sf::Vector2f(x, bottom), color));
+        bars.append(sf::Vertex(sf::Vector2f(x + barWidth, bottom), color));
+        bars.append(sf::Vertex(sf::Vector2f(x + barWidth, bottom - height), color));
+        bars.append(sf::Vertex(sf::Vector2f(x, bottom - height), color));
+    }
+
+    sf::FloatRect bounds = text.getLocalBounds();
+    text.setPosition(left, bottom - histogramHeight - 20.0f - bounds.top - bounds.height);
+    window.draw(text);
+    window.draw(bars);
+#else
+    text.setString("Profiling is compiled out; build the Profile configuration");
+    text.setPosition(20.0f, window.getSize().y - 50.0f);
+    window.draw(text);
+#endif
+}
+
+// Latest sample and drift since the first, to the right of the instructions
+void renderDiagnostics(sf::Text& text, const sf::Text& instructions, const SimulationFrame& frame, sf::RenderWindow& window) {
+    char line[512];
+    if (frame.diagnosticsSamples == 0) {
+        std::snprintf(line, sizeof(line), "Diagnostics every %d steps\nWaiting for the first sample", frame.diagnosticsEvery);
+    }
+    else {
+        const DiagnosticsSample& s = frame.diagnostics;
+        std::snprintf(line, sizeof(line),
+            "Diagnostics every %d steps\n"
+            "Particles: %zu active, %zu passive\n"
+            "Energy: %.6g (drift %+.2e)\n"
+            "Kinetic: %.6g, Potential: %.6g\n"
+            "Momentum: (%.4g, %.4g)\n"
+            "Angular momentum: %.6g (drift %+.2e)\n"
+            "Press D: Stop and save",
+            frame.diagnosticsEvery, s.particleCount - s.passiveCount, s.passiveCount, s.total, frame.energyDrift, s.kinetic, s.potential,
+            s.momentum.x, s.momentum.y, s.angularMomentum, frame.angularMomentumDrift);
+    }
+    text.setString(line);
+
+    sf::FloatRect bounds = instructions.getGlobalBounds();
+    text.setPosition(bounds.left + bounds.width + 40.0f, instructions.getPosition().y);
+    window.draw(text);
+}
+
 void renderStartMenu(const sf::Text titleText, sf::Text subtitleText, sf::RenderWindow& window)
 {
     float time = simClock.getElapsedTime().asSeconds();
@@ -148,19 +387,4 @@ void renderStartMenu(const sf::Text titleText, sf::Text subtitleText, sf::Render
 
     window.draw(titleText);
     window.draw(subtitleText);
-}
-
-GravitySource* findNearestSource(sf::Vector2f pos, std::vector<GravitySource>& sources) {
-    GravitySource* closest = nullptr;
-    float minDist2 = std::numeric_limits<float>::max();
-    for (auto& s : sources) {
-        float dx = s.get_pos().x - pos.x;
-        float dy = s.get_pos().y - pos.y;
-        float dist2 = dx * dx + dy * dy;
-        if (dist2 < minDist2) {
-            minDist2 = dist2;
-            closest = &s;
-        }
-    }
-    return closest;
-}
+}
\ No newline at end of file
@@ -4,11 +4,17 @@
 #include <SFML/Graphics.hpp>
 #include <vector>
 #include "Particle.h"
+#include "ParticleSystem.h"
 #include "GravitySource.h"
 #include "AppState.h"
+#include "Diagnostics.h"
+#include "PhysicsSettings.h"
+#include "Simulation.h"
+#include "SimulationThread.h"
+#include "TimeStepper.h"
 
-void addParticlesAtPosition(std::vector<Particle>& particles, sf::Vector2f pos, int count, int i, ParticleType type, const GravitySource& source);
-void updateParticles(std::vector<Particle>& particles, const std::vector<GravitySource>& sources, bool mutualGravity);
+sf::Color getParticleColor(ParticleType type);
+sf::Color getSourceColor(GravitySourceType type);
 void renderScene(
     AppState state,
     const std::vector<sf::Text>& particleTypes,
@@ -20,19 +26,23 @@ void renderScene(
     sf::RenderWindow& window,
     bool pause,
     bool mutualGravity,
-    std::vector<GravitySource>& sources,
-    std::vector<Particle>& particles
+    const PhysicsSettings& settings,
+    const TimeStepper& stepper,
+    const SimulationFrame& frame,
+    float interpolation,
+    Vector2s offset
 );
 void renderTypes(
-    const std::vector<sf::Text>& particleTypes,
-    const std::vector<sf::Text>& sourceTypes,
+    std::vector<sf::Text>& particleTypes,
+    std::vector<sf::Text>& sourceTypes,
     const ParticleType particleType,
     const GravitySourceType sourceType,
     Mode mode,
     sf::RenderWindow& window
 
 );
+void renderProfiler(sf::Text& text, sf::RenderWindow& window);
+void renderDiagnostics(sf::Text& text, const sf::Text& instructions, const SimulationFrame& frame, sf::RenderWindow& window);
 void renderStartMenu(const sf::Text titleText, sf::Text subtitleText, sf::RenderWindow& window);
-GravitySource* findNearestSource(sf::Vector2f pos, std::vector<GravitySource>& sources);
 
 #endif
\ No newline at end of file
@@ -1,15 +1,62 @@
 #include <iostream>
 #include <vector>
 #include <cstdlib>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <utility>
 #include <SFML/Graphics.hpp>
+#include "Generators.h"
 #include "GravitySource.h"
 #include "Particle.h"
+#include "ParticleSystem.h"
+#include "Profiler.h"
+#include "SimulationThread.h"
+#include "Snapshot.h"
+#include "Trajectory.h"
 #include "Utils.h"
 
 // SCALES
 // 1 px = 600 km
 // 1 mass unit = 1 earth (5.9710^24 kg)
 
+// Written by F5, read back by F9
+const char* SNAPSHOT_PATH = "snapshot.ogs";
+
+// Written while F6 recording is on, played back by F10
+const char* TRAJECTORY_PATH = "trajectory.ogt";
+constexpr int RECORD_EVERY_STEPS = 3;  // one frame per rendered frame at 1x speed
+
+// Written when D turns diagnostics off
+const char* DIAGNOSTICS_PATH = "diagnostics.csv";
+constexpr int DIAGNOSTICS_EVERY_STEPS = 10;
+
+// F4 records every profiled scope until pressed again
+const char* TRACE_PATH = "trace.json";
+
+// Room for spawn-heavy scenes before the particle arrays first grow
+constexpr size_t PARTICLE_RESERVE = 1 << 16;
+
+// N spawns a disk this size through the cursor, +/-20% of its distance
+constexpr size_t SPAWN_DISK_COUNT = 10000;
+
+// Middle-click removes the nearest body within this many pixels
+constexpr float PICK_RADIUS_PX = 12.0f;
+
+// Panning the camera further than this from (0, 0) shifts the simulation
+// origin to the camera, so the bodies on screen keep sub-pixel precision
+constexpr float REBASE_DISTANCE = 20000.0f;
+
+// Fastest +/- speed; Kepler orbits cross a frame's steps in one jump, so
+// they can go far beyond what stepping every particle keeps up with
+constexpr float MAX_TIME_SCALE = 64.0f;
+constexpr float MAX_KEPLER_TIME_SCALE = 4096.0f;
+
+float maxTimeScale(const PhysicsSettings& physics) {
+    return physics.keplerOrbits ? MAX_KEPLER_TIME_SCALE : MAX_TIME_SCALE;
+}
+
 int main() {
     sf::VideoMode desktop = sf::VideoMode::getDesktopMode();
     sf::RenderWindow window(desktop, "Gravity Simulator", sf::Style::Fullscreen);
@@ -27,8 +74,9 @@ int main() {
         return -1;
     }
 
-    std::vector<GravitySource> sources;
-    std::vector<Particle> particles;
+    // The scene lives on the simulation thread; this one only posts commands
+    // and draws the frames it publishes
+    SimulationThread simulation(PARTICLE_RESERVE);
 
     sf::Text titleText;
     titleText.setFont(open_sans);
@@ -56,22 +104,25 @@ int main() {
     instructions.setFillColor(sf::Color::White);
     instructions.setPosition(20, 20);
 
+    sf::Text diagnosticsText;
+    diagnosticsText.setFont(open_sans);
+    diagnosticsText.setCharacterSize(20);
+    diagnosticsText.setFillColor(sf::Color::White);
+
+    sf::Text profilerText;
+    profilerText.setFont(open_sans);
+    profilerText.setCharacterSize(16);
+    profilerText.setFillColor(sf::Color::White);
+
     // Particle types and colors
     std::vector<sf::Text> particleTypes;
     std::vector<std::string> particleNames = {
         "1: Planetoid", "2: Satellite", "3: Terrestrial",
         "4: Gas Giant", "5: Ice Giant"
     };
-    std::vector<sf::Color> particleColors = {
-        sf::Color(165, 42, 42),   // reddish brown
-        sf::Color(192, 192, 192), // pale grey
-        sf::Color(11, 102, 35),   // green
-        sf::Color(255, 174, 66),  // orange
-        sf::Color(0, 255, 255)    // cyan
-    };
     for (size_t i = 0; i < particleNames.size(); ++i) {
         sf::Text text(particleNames[i], open_sans, 20);
-        text.setFillColor(particleColors[i]);
+        text.setFillColor(getParticleColor(static_cast<ParticleType>(i)));
         particleTypes.push_back(text);
     }
 
@@ -80,28 +131,48 @@ int main() {
     std::vector<std::string> sourceNames = {
         "1: Red Dwarf", "2: White Dwarf", "3: Yellow Dwarf", "4: Neutron Star"
     };
-    std::vector<sf::Color> sourceColors = {
-        sf::Color::Red, sf::Color::White,
-        sf::Color(139, 128, 0), sf::Color(175, 238, 238)
-    };
     for (size_t i = 0; i < sourceNames.size(); ++i) {
         sf::Text text(sourceNames[i], open_sans, 20);
-        text.setFillColor(sourceColors[i]);
+        text.setFillColor(getSourceColor(static_cast<GravitySourceType>(i)));
         sourceTypes.push_back(text);
     }
 
+
     AppState state = AppState::StartMenu;
     Mode mode = Mode::AddSource;
 
     bool pause = false;
     bool mutualGravity = false;
+    PhysicsSettings physics;
+    TimeStepper stepper;  // holds time scale and substeps for the simulation
+    sf::Vector2<double> viewOrigin;  // world position of the view's (0, 0)
+
+    // Replay reads recorded frames here, leaving the simulation alone
+    TrajectoryReader replay;
+    size_t replayFrame = 0;
+    ParticleSystem replayParticles;
+    std::vector<GravitySource> replaySources;
+    SimulationFrame replayView;
+
+    bool showProfiler = false;
+    uint64_t diskSeed = 0;  // one more per spawned disk, so a session replays the same
 
     ParticleType particleType = ParticleType::Terrestrial;
     GravitySourceType sourceType = GravitySourceType::RedDwarf;
 
+    // World position under a pixel, for commands to the simulation
+    auto worldAt = [&](sf::Vector2i pixel) {
+        return viewOrigin + sf::Vector2<double>(window.mapPixelToCoords(pixel, view));
+    };
+
     while (window.isOpen()) {
+        simulation.update_frame();
+        const SimulationFrame& frame = simulation.get_frame();
+        bool editing = state == AppState::Running || state == AppState::Paused;
+
         sf::Event event;
         while (window.pollEvent(event)) {
+            PROFILE_SCOPE("Events");
             if (event.type == sf::Event::Closed) window.close();
 
             else if (event.type == sf::Event::KeyPressed) {
@@ -110,9 +181,36 @@ int main() {
                 case sf::Keyboard::P: mode = Mode::AddParticle; break;
                 case sf::Keyboard::S: mode = Mode::AddSource; break;
                 case sf::Keyboard::G: mutualGravity = !mutualGravity; break;
+                case sf::Keyboard::T: physics.blockTimesteps = !physics.blockTimesteps; break;
+                case sf::Keyboard::I:
+                    physics.integrator = physics.integrator == Integrator::Leapfrog ? Integrator::Yoshida4
+                        : physics.integrator == Integrator::Yoshida4 ? Integrator::RK45
+                        : Integrator::Leapfrog;
+                    break;
+                case sf::Keyboard::C:
+                    physics.collisions = physics.collisions == CollisionResponse::None ? CollisionResponse::Merge
+                        : physics.collisions == CollisionResponse::Merge ? CollisionResponse::Bounce
+                        : CollisionResponse::None;
+                    break;
+                case sf::Keyboard::X: physics.absorbIntoSources = !physics.absorbIntoSources; break;
+                case sf::Keyboard::F: physics.sourceField = !physics.sourceField; break;
+                case sf::Keyboard::K:
+                    physics.keplerOrbits = !physics.keplerOrbits;
+                    stepper.set_time_scale(std::min(stepper.get_time_scale(), maxTimeScale(physics)));
+                    break;
+                case sf::Keyboard::M:
+                    // Off, then planetoids and satellites passive, then terrestrials too
+                    physics.passiveMass = physics.passiveMass <= 0.0f ? 0.1f
+                        : physics.passiveMass < 2.0f ? 2.0f
+                        : 0.0f;
+                    break;
+                case sf::Keyboard::B:
+                    physics.solver = physics.solver == GravitySolver::BarnesHut ? GravitySolver::ParticleMesh
+                        : physics.solver == GravitySolver::ParticleMesh ? GravitySolver::DirectSum
+                        : GravitySolver::BarnesHut;
+                    break;
                 case sf::Keyboard::R:
-                    particles.clear();
-                    sources.clear();
+                    simulation.post(SimulationCommand(SimulationCommandType::Reset));
                     state = AppState::AwaitingSources;
                     mode = Mode::AddSource;
                     zoomLevel = 1.0f;
@@ -120,6 +218,97 @@ int main() {
                     window.setView(view);
                     mutualGravity = false;
                     pause = false;
+                    stepper.reset();
+                    viewOrigin = sf::Vector2<double>();
+                    break;
+                case sf::Keyboard::F6:
+                    if (frame.recording || editing) {
+                        SimulationCommand command(SimulationCommandType::ToggleRecording);
+                        command.path = TRAJECTORY_PATH;
+                        command.everySteps = RECORD_EVERY_STEPS;
+                        simulation.post(command);
+                    }
+                    break;
+                case sf::Keyboard::D:
+                    if (frame.diagnosticsEvery > 0 || editing) {
+                        SimulationCommand command(SimulationCommandType::ToggleDiagnostics);
+                        command.path = DIAGNOSTICS_PATH;
+                        command.everySteps = DIAGNOSTICS_EVERY_STEPS;
+                        simulation.post(command);
+                    }
+                    break;
+                case sf::Keyboard::N:
+                    if (editing && !frame.sources.empty()) {
+                        SimulationCommand command(SimulationCommandType::SpawnDisk);
+                        command.worldPos = worldAt(sf::Mouse::getPosition(window));
+                        command.particleType = particleType;
+                        command.count = SPAWN_DISK_COUNT;
+                        command.seed = ++diskSeed;
+                        simulation.post(command);
+                    }
+                    break;
+                case sf::Keyboard::F3:
+                    showProfiler = !showProfiler;
+                    if (!profiler.is_tracing()) profiler.set_enabled(showProfiler);
+                    break;
+                case sf::Keyboard::F4:
+                    if (profiler.is_tracing()) {
+                        if (profiler.stop_trace(TRACE_PATH))
+                            std::cout << "Wrote trace to " << TRACE_PATH << "\n";
+                        if (!showProfiler) profiler.set_enabled(false);
+                    }
+                    else {
+                        if (!profiler.is_enabled()) profiler.set_enabled(true);
+                        profiler.start_trace();
+                    }
+                    break;
+                case sf::Keyboard::F10:
+                    // The recording must be closed before it can be read
+                    simulation.post(SimulationCommand(SimulationCommandType::StopRecording));
+                    simulation.flush();
+                    if (replay.open(TRAJECTORY_PATH) && replay.frame_count() > 0) {
+                        state = AppState::Replaying;
+                        pause = false;
+                        replayFrame = 0;
+                    }
+                    break;
+                case sf::Keyboard::F5:
+                    if (editing) {
+                        SimulationCommand command(SimulationCommandType::SaveSnapshot);
+                        command.path = SNAPSHOT_PATH;
+                        simulation.post(command);
+                    }
+                    break;
+                case sf::Keyboard::F9: {
+                    // Resumes paused, so the restored scene can be looked at first
+                    std::shared_ptr<Snapshot> snapshot = std::make_shared<Snapshot>();
+                    if (loadSnapshot(SNAPSHOT_PATH, *snapshot)) {
+                        mutualGravity = snapshot->mutualGravity;
+                        physics = snapshot->settings;
+                        viewOrigin = snapshot->origin;
+                        state = AppState::Paused;
+                        mode = Mode::AddParticle;
+                        pause = true;
+                        stepper.reset();
+                        SimulationCommand command(SimulationCommandType::LoadScene);
+                        command.snapshot = std::move(snapshot);
+                        simulation.post(command);
+                    }
+                    break;
+                }
+                case sf::Keyboard::Equal:
+                case sf::Keyboard::Add:
+                    stepper.set_time_scale(std::min(stepper.get_time_scale() * 2.0f, maxTimeScale(physics)));
+                    break;
+                case sf::Keyboard::Hyphen:
+                case sf::Keyboard::Subtract:
+                    stepper.set_time_scale(std::max(stepper.get_time_scale() * 0.5f, 0.125f));
+                    break;
+                case sf::Keyboard::RBracket:
+                    stepper.set_substeps(std::min(stepper.get_substeps() + 1, 32));
+                    break;
+                case sf::Keyboard::LBracket:
+                    stepper.set_substeps(stepper.get_substeps() - 1);
                     break;
                 case sf::Keyboard::Num1:
                     if (mode == Mode::AddParticle) particleType = ParticleType::Planetoid;
@@ -143,7 +332,7 @@ int main() {
                 case sf::Keyboard::Enter:
                     if (state == AppState::StartMenu)
                         state = AppState::AwaitingSources;
-                    else if (state == AppState::AwaitingSources && !sources.empty()) {
+                    else if (state == AppState::AwaitingSources && !frame.sources.empty()) {
                         state = AppState::Running;
                         mode = Mode::AddParticle;
                         pause = false;
@@ -154,8 +343,21 @@ int main() {
                         pause = !pause;
                         state = pause ? AppState::Paused : AppState::Running;
                     }
+                    else if (state == AppState::Replaying) {
+                        pause = !pause;
+                    }
                     break;
                 }
+
+                // Any key may have changed a setting or started or stopped the clock
+                SimulationCommand configure(SimulationCommandType::Configure);
+                configure.config.physics = physics;
+                configure.config.mutualGravity = mutualGravity;
+                configure.config.running = state == AppState::Running && !pause;
+                configure.config.timeScale = stepper.get_time_scale();
+                configure.config.substeps = stepper.get_substeps();
+                simulation.post(configure);
+                editing = state == AppState::Running || state == AppState::Paused;
             }
             else if (event.type == sf::Event::MouseWheelScrolled && state != AppState::StartMenu) {
                 // Zoom to mouse pointer
@@ -184,22 +386,59 @@ int main() {
                 dragStart = dragCurrent;
                 window.setView(view);
             }
-            else if (state == AppState::AwaitingSources && event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Left) {
-                sf::Vector2f pos = window.mapPixelToCoords(sf::Mouse::getPosition(window), view);
-                sources.emplace_back(pos.x, pos.y, sourceType);
+            else if ((state == AppState::AwaitingSources || editing) && event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Left) {
+                bool addSource = state == AppState::AwaitingSources || mode == Mode::AddSource;
+                SimulationCommand command(addSource ? SimulationCommandType::AddSource : SimulationCommandType::AddParticle);
+                command.worldPos = worldAt(sf::Mouse::getPosition(window));
+                command.sourceType = sourceType;
+                command.particleType = particleType;
+                simulation.post(command);
             }
-            else if ((state == AppState::Running || state == AppState::Paused) && event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Left) {
-                sf::Vector2f pos = window.mapPixelToCoords(sf::Mouse::getPosition(window), view);
-                GravitySource* source = findNearestSource(pos, sources);
-                if (mode == Mode::AddParticle)
-                    addParticlesAtPosition(particles, pos, particles.size(), particles.size(), particleType, *source);
-                else
-                    sources.emplace_back(pos.x, pos.y, sourceType);
+            else if (editing && event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Middle) {
+                SimulationCommand command(mode == Mode::AddParticle ? SimulationCommandType::RemoveParticle : SimulationCommandType::RemoveSource);
+                command.worldPos = worldAt(sf::Mouse::getPosition(window));
+                command.pickRadius = PICK_RADIUS_PX * zoomLevel;
+                simulation.post(command);
             }
         }
 
-        if (state == AppState::Running && !pause)
-            updateParticles(particles, sources, mutualGravity);
+        // Blend from where the latest frame left off, at the simulation's pace
+        const SimulationFrame* shown = &frame;
+        float interpolation = frame.blend(simulationClockNow());
+        Vector2s offset(static_cast<Scalar>(frame.origin.x - viewOrigin.x), static_cast<Scalar>(frame.origin.y - viewOrigin.y));
+
+        if (state == AppState::Replaying) {
+            // One recorded frame per rendered frame, looping at the end
+            long step = 0;
+            replay.read_frame(replayFrame, replayParticles, replaySources, &step);
+            replayView.capture(replayParticles, replaySources);
+            shown = &replayView;
+            interpolation = 1.0f;
+            offset = Vector2s();
+            instructions.setString(
+                "Replaying " + std::string(TRAJECTORY_PATH) + "\n"
+                "Frame " + std::to_string(replayFrame + 1) + "/" + std::to_string(replay.frame_count()) +
+                ", step " + std::to_string(step) + "\n"
+                "Press Space: " + std::string(pause ? "Resume" : "Pause") + "\n"
+                "Press R: Restart\n"
+                "Press Esc: Quit"
+            );
+            if (!pause) replayFrame = (replayFrame + 1) % replay.frame_count();
+        }
+
+        if (state == AppState::AwaitingSources || editing) {
+            // The view moves now; frames keep their old origin until the
+            // simulation catches up, which the offset covers
+            sf::Vector2f center = view.getCenter();
+            if (std::abs(center.x) > REBASE_DISTANCE || std::abs(center.y) > REBASE_DISTANCE) {
+                viewOrigin += sf::Vector2<double>(center);
+                view.move(-center);
+                offset -= Vector2s(center);
+                SimulationCommand command(SimulationCommandType::Rebase);
+                command.worldPos = viewOrigin;
+                simulation.post(command);
+            }
+        }
 
         window.clear();
         window.setView(view);
@@ -210,8 +449,9 @@ int main() {
         }
         else
         {
+            PROFILE_SCOPE("Render scene");
             renderScene(state, particleTypes, sourceTypes, particleType, sourceType,
-                instructions, mode, window, pause, mutualGravity, sources, particles);
+                instructions, mode, window, pause, mutualGravity, physics, stepper, *shown, interpolation, offset);
         }
 
         // Switch to default view for UI elements pinned to screen
@@ -219,11 +459,20 @@ int main() {
 
         if (state != AppState::StartMenu)
         {
+            PROFILE_SCOPE("Overlay");
             window.draw(instructions);
+            if (frame.diagnosticsEvery > 0 && editing)
+                renderDiagnostics(diagnosticsText, instructions, frame, window);
             renderTypes(particleTypes, sourceTypes, particleType, sourceType, mode, window);
         }
+        if (showProfiler) renderProfiler(profilerText, window);
 
-        window.display();
+        // Includes the wait for the frame limit
+        {
+            PROFILE_SCOPE("Display");
+            window.display();
+        }
+        PROFILE_END_FRAME(shown->size());
     }
 
     return 0;
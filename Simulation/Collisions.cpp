@@ -0,0 +1,192 @@
+#include "Collisions.h"
+#include "Profiler.h"
+#include "SpatialHash.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+static SpatialHash collisionGrid;
+static std::vector<std::pair<unsigned, unsigned>> contactPairs;
+static std::vector<unsigned char> removedParticles;
+static std::vector<unsigned char> mergedParticles;  // survivors of a merge this call
+
+// Cells about one typical body across; big bodies span several cells
+// instead of blowing every cell up to their size
+static float chooseCellSize(const float* radius, size_t count) {
+    double sum = 0.0;
+    float largest = 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        sum += radius[i];
+        largest = std::max(largest, radius[i]);
+    }
+    float typical = static_cast<float>(2.0 * sum / count);
+    return std::max({ typical, largest / 8.0f, 1.0f });
+}
+
+// Every overlapping pair (i < j), each reported once. Touching bodies
+// share at least one cell, so only entries of the same bucket are compared.
+static void findContacts(const ParticleSystem& particles) {
+    const Scalar* px = particles.pos_x();
+    const Scalar* py = particles.pos_y();
+    const float* r = particles.radii();
+    size_t n = particles.size();
+
+    collisionGrid.build(px, py, r, n, chooseCellSize(r, n));
+    contactPairs.clear();
+
+    for (size_t b = 0; b < collisionGrid.bucket_count(); ++b) {
+        const SpatialHash::Entry* begin = collisionGrid.bucket_begin(b);
+        const SpatialHash::Entry* end = collisionGrid.bucket_end(b);
+
+        for (const SpatialHash::Entry* e1 = begin; e1 != end; ++e1) {
+            for (const SpatialHash::Entry* e2 = e1 + 1; e2 != end; ++e2) {
+                if (e1->cx != e2->cx || e1->cy != e2->cy) continue;  // other cell, same bucket
+
+                Scalar dx = e2->x - e1->x;
+                Scalar dy = e2->y - e1->y;
+                float reach = e1->radius + e2->radius;
+                if (dx * dx + dy * dy >= reach * reach) continue;
+
+                // Bodies sharing several cells are reported from the first
+                // cell of their common range only
+                int firstX = std::max(collisionGrid.cell(e1->x - e1->radius), collisionGrid.cell(e2->x - e2->radius));
+                int firstY = std::max(collisionGrid.cell(e1->y - e1->radius), collisionGrid.cell(e2->y - e2->radius));
+                if (e1->cx != firstX || e1->cy != firstY) continue;
+
+                contactPairs.emplace_back(std::min(e1->body, e2->body), std::max(e1->body, e2->body));
+            }
+        }
+    }
+
+    // Bucket order follows the hash; sorted pairs resolve in particle order
+    std::sort(contactPairs.begin(), contactPairs.end());
+}
+
+// Perfectly inelastic: the heavier body keeps its type and index and takes
+// the combined mass, momentum and centre of mass. Radius grows by area.
+static void mergePair(ParticleSystem& particles, size_t a, size_t b) {
+    size_t keep = particles.get_mass(a) >= particles.get_mass(b) ? a : b;
+    size_t gone = keep == a ? b : a;
+
+    float m1 = particles.get_mass(keep);
+    float m2 = particles.get_mass(gone);
+    float total = m1 + m2;
+    Vector2s p1 = particles.get_pos(keep), p2 = particles.get_pos(gone);
+    Vector2s v1 = particles.get_velocity(keep), v2 = particles.get_velocity(gone);
+    float r1 = particles.get_radius(keep), r2 = particles.get_radius(gone);
+
+    // set_pos also resets the render history, so the survivor does not streak
+    particles.set_pos(keep, (p1 * Scalar(m1) + p2 * Scalar(m2)) / Scalar(total));
+    particles.set_velocity(keep, (v1 * Scalar(m1) + v2 * Scalar(m2)) / Scalar(total));
+    particles.set_mass(keep, total);
+    particles.set_radius(keep, std::sqrt(r1 * r1 + r2 * r2));
+    removedParticles[gone] = 1;
+    mergedParticles[keep] = 1;
+}
+
+// Pushes the bodies apart so they do not register the same contact again
+// next step, then applies an impulse along the contact normal if they are
+// approaching. Returns false if they were already separating; they have
+// moved either way.
+static bool bouncePair(ParticleSystem& particles, size_t a, size_t b, float restitution) {
+    Scalar* px = particles.pos_x();
+    Scalar* py = particles.pos_y();
+    Scalar* vx = particles.vel_x();
+    Scalar* vy = particles.vel_y();
+    const float* m = particles.masses();
+    const float* r = particles.radii();
+
+    Scalar dx = px[b] - px[a];
+    Scalar dy = py[b] - py[a];
+    Scalar dist = std::sqrt(dx * dx + dy * dy);
+    Scalar nx = dist > 0 ? dx / dist : 1;
+    Scalar ny = dist > 0 ? dy / dist : 0;
+
+    Scalar invMassA = Scalar(1) / m[a];
+    Scalar invMassB = Scalar(1) / m[b];
+    Scalar invMassSum = invMassA + invMassB;
+
+    Scalar overlap = r[a] + r[b] - dist;
+    px[a] -= nx * overlap * (invMassA / invMassSum);
+    py[a] -= ny * overlap * (invMassA / invMassSum);
+    px[b] += nx * overlap * (invMassB / invMassSum);
+    py[b] += ny * overlap * (invMassB / invMassSum);
+
+    Scalar approach = (vx[b] - vx[a]) * nx + (vy[b] - vy[a]) * ny;
+    if (approach >= 0) return false;  // already separating
+
+    Scalar impulse = -(1 + restitution) * approach / invMassSum;
+    vx[a] -= impulse * invMassA * nx;
+    vy[a] -= impulse * invMassA * ny;
+    vx[b] += impulse * invMassB * nx;
+    vy[b] += impulse * invMassB * ny;
+    return true;
+}
+
+CollisionStats resolveCollisions(
+    ParticleSystem& particles,
+    std::vector<GravitySource>& sources,
+    const PhysicsSettings& settings
+) {
+    PROFILE_SCOPE("Collisions");
+    CollisionStats stats;
+    size_t n = particles.size();
+    if (n == 0) return stats;
+
+    removedParticles.assign(n, 0);
+
+    if (settings.collisions != CollisionResponse::None) {
+        findContacts(particles);
+        bool merge = settings.collisions == CollisionResponse::Merge;
+        if (merge) mergedParticles.assign(n, 0);
+
+        for (const auto& pair : contactPairs) {
+            size_t a = pair.first, b = pair.second;
+            if (removedParticles[a] || removedParticles[b]) continue;
+
+            if (merge) {
+                // A survivor's other contacts were found where it was before
+                // the merge; they are checked again next step
+                if (mergedParticles[a] || mergedParticles[b]) continue;
+                mergePair(particles, a, b);
+                ++stats.merged;
+            }
+            else if (bouncePair(particles, a, b, settings.restitution)) {
+                ++stats.bounced;
+            }
+            else {
+                ++stats.separated;
+            }
+        }
+    }
+
+    if (settings.absorbIntoSources) {
+        const Scalar* px = particles.pos_x();
+        const Scalar* py = particles.pos_y();
+        const float* r = particles.radii();
+        const float* m = particles.masses();
+
+        for (size_t i = 0; i < n; ++i) {
+            if (removedParticles[i]) continue;
+            for (auto& src : sources) {
+                Scalar dx = src.get_pos().x - px[i];
+                Scalar dy = src.get_pos().y - py[i];
+                Scalar reach = src.get_radius() + r[i];
+                if (dx * dx + dy * dy < reach * reach) {
+                    src.set_strength(src.get_strength() + m[i]);
+                    removedParticles[i] = 1;
+                    ++stats.absorbed;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (stats.merged > 0 || stats.absorbed > 0) particles.remove_marked(removedParticles);
+    return stats;
+}
+
+size_t collisionMemoryBytes() {
+    return collisionGrid.memory_bytes() + contactPairs.capacity() * sizeof(contactPairs[0]) + removedParticles.capacity()
+        + mergedParticles.capacity();
+}
@@ -0,0 +1,32 @@
+#ifndef SIMULATOR_COLLISIONS_H
+#define SIMULATOR_COLLISIONS_H
+
+#include <cstddef>
+#include <vector>
+#include "GravitySource.h"
+#include "ParticleSystem.h"
+#include "PhysicsSettings.h"
+
+struct CollisionStats {
+    size_t merged = 0;    // particles folded into another
+    size_t bounced = 0;   // approaching pairs that bounced
+    size_t separated = 0; // touching pairs already moving apart, only pushed out of overlap
+    size_t absorbed = 0;  // particles swallowed by a source
+};
+
+// Finds touching particles with a spatial hash (near-linear in particle
+// count) and applies settings.collisions to each pair, then swallows
+// particles that touch a source if settings.absorbIntoSources is set.
+// A particle takes part in at most one merge per call; chains finish on
+// later steps.
+// Removed particles are compacted out, survivors keep their order.
+CollisionStats resolveCollisions(
+    ParticleSystem& particles,
+    std::vector<GravitySource>& sources,
+    const PhysicsSettings& settings
+);
+
+// Scratch memory kept alive between calls (grid, pair list)
+size_t collisionMemoryBytes();
+
+#endif
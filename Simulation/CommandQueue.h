@@ -0,0 +1,38 @@
+#ifndef SIMULATOR_COMMANDQUEUE_H
+#define SIMULATOR_COMMANDQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// Bounded lock-free queue from one producer thread to one consumer thread.
+// push fails instead of blocking or allocating once Capacity - 1 items are
+// waiting.
+template <typename T, size_t Capacity>
+class CommandQueue {
+private:
+    T slots[Capacity];
+    std::atomic<size_t> head{ 0 };  // next to pop, written by the consumer
+    std::atomic<size_t> tail{ 0 };  // next free, written by the producer
+
+public:
+    bool push(T value) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t next = (t + 1) % Capacity;
+        if (next == head.load(std::memory_order_acquire)) return false;
+        slots[t] = std::move(value);
+        tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& value) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false;
+        value = std::move(slots[h]);
+        slots[h] = T();  // drop anything the slot owns now, not a lap later
+        head.store((h + 1) % Capacity, std::memory_order_release);
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef SIMULATOR_DIAGNOSTICS_H
+#define SIMULATOR_DIAGNOSTICS_H
+
+#include <SFML/System/Vector2.hpp>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "GravitySource.h"
+#include "ParticleSystem.h"
+#include "PhysicsSettings.h"
+
+// Conserved quantities of the particles at one instant. Sources are fixed,
+// so they add potential energy but no kinetic energy or momentum, and the
+// momentum is only conserved in scenes without them.
+struct DiagnosticsSample {
+    long step = 0;
+    double time = 0.0;
+    size_t particleCount = 0;
+    size_t passiveCount = 0;  // lighter than the passive mass: feel mutual gravity, exert none
+    double kinetic = 0.0;
+    double potential = 0.0;
+    double total = 0.0;
+    sf::Vector2<double> momentum;
+    double angularMomentum = 0.0;  // about the barycenter of particles and sources
+};
+
+// One measurement; the potential costs about one force pass, the rest O(N)
+DiagnosticsSample measureDiagnostics(
+    const ParticleSystem& particles,
+    const std::vector<GravitySource>& sources,
+    bool mutualGravity,
+    const PhysicsSettings& settings
+);
+
+// Measures every K physics steps and keeps the time series in memory.
+// With K = 0 it is off and step() is a single inline compare. Before a
+// sampled step the force pass is asked to gather the potential in its own
+// tree walk, mesh lookup or direct-sum kernel. That pass costs more (about
+// 1.5x for direct sum, which adds a term per pair) but there is no second
+// sweep: the sample itself is O(N) unless a collision changed the
+// particles after that pass, which costs a separate potential pass.
+class Diagnostics {
+private:
+    int everySteps = 0;
+    int sinceSample = 0;
+    std::vector<DiagnosticsSample> samples;
+
+    void request_potential(ParticleSystem& particles) const;
+
+public:
+    explicit Diagnostics(int everySteps = 0);
+
+    // Call after every physics step; returns true if a sample was taken
+    bool step(long step, double time, ParticleSystem& particles,
+        const std::vector<GravitySource>& sources, bool mutualGravity, const PhysicsSettings& settings) {
+        if (everySteps <= 0) return false;
+        if (++sinceSample >= everySteps) {
+            sample(step, time, particles, sources, mutualGravity, settings);
+            return true;
+        }
+        if (sinceSample == everySteps - 1) request_potential(particles);
+        return false;
+    }
+
+    // Takes a sample now and restarts the K-step count
+    void sample(long step, double time, ParticleSystem& particles,
+        const std::vector<GravitySource>& sources, bool mutualGravity, const PhysicsSettings& settings);
+
+    // Also cancels a potential request pending on the particles
+    void clear(ParticleSystem& particles);
+
+    // Relative change since the first sample, 0 with fewer than two
+    double energy_drift() const;
+    double angular_momentum_drift() const;
+
+    // Both report problems on std::cerr and return false
+    bool write_csv(const std::string& path) const;
+    bool write_json(const std::string& path) const;
+
+    bool is_enabled() const;
+    int get_every_steps() const;
+    const std::vector<DiagnosticsSample>& get_samples() const;
+
+    void set_every_steps(int everySteps);
+};
+
+#endif
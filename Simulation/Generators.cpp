@@ -0,0 +1,181 @@
+#include "Generators.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <functional>
+
+// Particles per work item; generation is cheap per particle
+constexpr size_t GENERATOR_CHUNK = 4096;
+constexpr double TWO_PI = 6.283185307179586;
+
+// Independent stream for particle i, whatever thread fills it
+static Rng streamFor(uint64_t seed, size_t i) {
+    Rng mixer(seed ^ (static_cast<uint64_t>(i) * 0xD1B54A32D192ED03ull));
+    return Rng(mixer.next());
+}
+
+// On the force pass's workers, which are idle while a scene is generated
+static void fillParallel(size_t count, unsigned threadCount, const std::function<void(size_t, size_t)>& body) {
+    if (count <= GENERATOR_CHUNK || threadCount == 1) {
+        body(0, count);
+        return;
+    }
+    simulationPool(threadCount).parallel_for(count, GENERATOR_CHUNK, body);
+}
+
+// Speed of a circular orbit at separation r under accumulatePull, which
+// softens the distance and subtracts both radii
+static double circularSpeed(double r, double strength, double radii) {
+    double dist = std::sqrt(r * r + double(SOFTENING) * SOFTENING);
+    double effectiveDist = std::max(dist - radii, double(SOFTENING));
+    return r * std::sqrt(G * strength / dist) / effectiveDist;
+}
+
+// With both radii subtracted from the distance, L^2 = r^3 a(r) only grows
+// with r beyond three times their sum; circular orbits closer in are unstable
+static double minimumOrbit(double radii) {
+    return 3.0 * radii;
+}
+
+static void setParticle(ParticleSystem& particles, size_t i, double x, double y, double vx, double vy) {
+    particles.pos_x()[i] = static_cast<Scalar>(x);
+    particles.pos_y()[i] = static_cast<Scalar>(y);
+    particles.prev_x()[i] = static_cast<Scalar>(x);
+    particles.prev_y()[i] = static_cast<Scalar>(y);
+    particles.vel_x()[i] = static_cast<Scalar>(vx);
+    particles.vel_y()[i] = static_cast<Scalar>(vy);
+}
+
+size_t generateDisk(ParticleSystem& particles, const GravitySource& source, const DiskSpec& spec,
+    uint64_t seed, unsigned threadCount) {
+    size_t first = particles.append(spec.count, spec.type);
+    const ParticleTypeInfo& info = getParticleTypeInfo(spec.type);
+    double cx = source.get_pos().x, cy = source.get_pos().y;
+    double inner = std::max(double(spec.innerRadius), minimumOrbit(source.get_radius() + info.radius));
+    double outer = std::max(double(spec.outerRadius), inner);
+    double inner2 = inner * inner;
+    double outer2 = outer * outer;
+    double diskMass = double(info.mass) * spec.count;
+
+    fillParallel(spec.count, threadCount, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k) {
+            Rng rng = streamFor(seed, k);
+            double area = rng.uniform();
+            double r = std::sqrt(inner2 + area * (outer2 - inner2));
+            double angle = rng.uniform(0.0, TWO_PI);
+
+            double v = circularSpeed(r, source.get_strength(), source.get_radius() + info.radius);
+            if (spec.selfGravity) v = std::sqrt(v * v + G * diskMass * area / r);
+            v *= 1.0 + spec.velocityJitter * rng.uniform(-1.0, 1.0);
+
+            double c = std::cos(angle), s = std::sin(angle);
+            setParticle(particles, first + k, cx + r * c, cy + r * s, -v * s, v * c);
+        }
+    });
+    return first;
+}
+
+size_t generateBelt(ParticleSystem& particles, const GravitySource& source, const BeltSpec& spec,
+    uint64_t seed, unsigned threadCount) {
+    size_t first = particles.append(spec.count, spec.type);
+    const ParticleTypeInfo& info = getParticleTypeInfo(spec.type);
+    double cx = source.get_pos().x, cy = source.get_pos().y;
+    double minRadius = minimumOrbit(source.get_radius() + info.radius);
+
+    fillParallel(spec.count, threadCount, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k) {
+            Rng rng = streamFor(seed, k);
+            double r = std::max(spec.radius + spec.width * rng.normal(), minRadius);
+            double angle = rng.uniform(0.0, TWO_PI);
+            double e = spec.maxEccentricity * rng.uniform();
+            double anomaly = rng.uniform(0.0, TWO_PI);
+
+            // Kepler orbit through r at true anomaly f: with p = r (1 + e cos f),
+            // v_t = v_c sqrt(1 + e cos f) and v_r = v_c e sin f / sqrt(1 + e cos f)
+            double vc = circularSpeed(r, source.get_strength(), source.get_radius() + info.radius);
+            double shape = std::sqrt(1.0 + e * std::cos(anomaly));
+            double vt = vc * shape;
+            double vr = vc * e * std::sin(anomaly) / shape;
+
+            double c = std::cos(angle), s = std::sin(angle);
+            setParticle(particles, first + k, cx + r * c, cy + r * s, vr * c - vt * s, vr * s + vt * c);
+        }
+    });
+    return first;
+}
+
+size_t generateCluster(ParticleSystem& particles, const ClusterSpec& spec, uint64_t seed, unsigned threadCount) {
+    size_t first = particles.append(spec.count, spec.type);
+    double a = spec.scaleRadius;
+    double totalMass = double(getParticleTypeInfo(spec.type).mass) * spec.count;
+
+    fillParallel(spec.count, threadCount, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k) {
+            Rng rng = streamFor(seed, k);
+
+            // Radius from the inverted cumulative mass, skipping the far tail
+            double r;
+            do {
+                double m = std::max(rng.uniform(), 1.0e-10);
+                r = a / std::sqrt(std::pow(m, -2.0 / 3.0) - 1.0);
+            } while (r > 20.0 * a);
+
+            // Speed as a fraction q of escape speed, g(q) = q^2 (1 - q^2)^3.5 by rejection
+            double q;
+            do {
+                q = rng.uniform();
+            } while (0.1 * rng.uniform() >= q * q * std::pow(1.0 - q * q, 3.5));
+            double v = q * std::sqrt(2.0 * G * totalMass) * std::pow(r * r + a * a, -0.25);
+
+            // Isotropic directions, keeping the in-plane components
+            double z = rng.uniform(-1.0, 1.0), phi = rng.uniform(0.0, TWO_PI);
+            double planar = std::sqrt(1.0 - z * z);
+            double vz = rng.uniform(-1.0, 1.0), vphi = rng.uniform(0.0, TWO_PI);
+            double vPlanar = std::sqrt(1.0 - vz * vz);
+
+            setParticle(particles, first + k,
+                spec.center.x + r * planar * std::cos(phi), spec.center.y + r * planar * std::sin(phi),
+                spec.velocity.x + v * vPlanar * std::cos(vphi), spec.velocity.y + v * vPlanar * std::sin(vphi));
+        }
+    });
+    return first;
+}
+
+size_t generateBinaries(ParticleSystem& particles, const GravitySource& source, const BinarySpec& spec,
+    uint64_t seed, unsigned threadCount) {
+    size_t first = particles.append(spec.pairs, spec.primary);
+    particles.append(spec.pairs, spec.secondary);
+
+    const ParticleTypeInfo& primary = getParticleTypeInfo(spec.primary);
+    const ParticleTypeInfo& secondary = getParticleTypeInfo(spec.secondary);
+    double pairMass = double(primary.mass) + secondary.mass;
+    double primaryShare = primary.mass / pairMass;
+    double cx = source.get_pos().x, cy = source.get_pos().y;
+    double inner = std::max(double(spec.innerRadius), minimumOrbit(source.get_radius() + primary.radius));
+    double outer = std::max(double(spec.outerRadius), inner);
+    double inner2 = inner * inner;
+    double outer2 = outer * outer;
+    double separation = std::max(double(spec.separation), minimumOrbit(primary.radius + secondary.radius));
+    double relativeSpeed = circularSpeed(separation, pairMass, primary.radius + secondary.radius);
+
+    fillParallel(spec.pairs, threadCount, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k) {
+            Rng rng = streamFor(seed, k);
+            double r = std::sqrt(inner2 + rng.uniform() * (outer2 - inner2));
+            double angle = rng.uniform(0.0, TWO_PI);
+            double spin = rng.uniform(0.0, TWO_PI);
+
+            double c = std::cos(angle), s = std::sin(angle);
+            double v = circularSpeed(r, source.get_strength(), source.get_radius() + primary.radius);
+            double bx = cx + r * c, by = cy + r * s;
+            double bvx = -v * s, bvy = v * c;
+
+            // Both about the pair's barycenter, turning the same way as the orbit
+            double ux = std::cos(spin), uy = std::sin(spin);
+            double d1 = separation * (1.0 - primaryShare), d2 = separation * primaryShare;
+            double v1 = relativeSpeed * (1.0 - primaryShare), v2 = relativeSpeed * primaryShare;
+            setParticle(particles, first + k, bx - d1 * ux, by - d1 * uy, bvx + v1 * uy, bvy - v1 * ux);
+            setParticle(particles, first + spec.pairs + k, bx + d2 * ux, by + d2 * uy, bvx - v2 * uy, bvy + v2 * ux);
+        }
+    });
+    return first;
+}
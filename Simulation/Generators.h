@@ -0,0 +1,97 @@
+#ifndef SIMULATOR_GENERATORS_H
+#define SIMULATOR_GENERATORS_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include "GravitySource.h"
+#include "Particle.h"
+#include "ParticleSystem.h"
+#include "Scalar.h"
+
+// Bulk scene generators. Each call appends a whole population of one
+// particle type straight into the arrays, filled in parallel, and returns
+// the index of the first particle it added. Particle i of a call draws
+// from its own random stream of (seed, i), so the same seed gives the same
+// scene on any number of threads. Orbits are kept at least three times
+// the summed radii out, inside which this force law has no stable circles.
+
+// SplitMix64: one word of state, so seeding a stream per particle is free
+class Rng {
+private:
+    uint64_t state;
+
+public:
+    explicit Rng(uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // [0, 1) with 53 random bits
+    double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+    double uniform(double lo, double hi) { return lo + (hi - lo) * uniform(); }
+
+    // Standard normal, Box-Muller
+    double normal() {
+        double u = 1.0 - uniform();
+        return std::sqrt(-2.0 * std::log(u)) * std::cos(6.283185307179586 * uniform());
+    }
+};
+
+// Circular orbits around a source, spread evenly over the annulus's area
+struct DiskSpec {
+    ParticleType type = ParticleType::Planetoid;
+    size_t count = 10000;
+    Scalar innerRadius = 300;
+    Scalar outerRadius = 3000;
+    float velocityJitter = 0.0f;  // random extra speed, as a fraction of circular
+    bool selfGravity = false;     // orbit the disk mass inside each radius too, for mutual gravity
+};
+
+// Narrow ring of eccentric orbits around a source
+struct BeltSpec {
+    ParticleType type = ParticleType::Planetoid;
+    size_t count = 10000;
+    Scalar radius = 1500;          // mean distance from the source
+    Scalar width = 100;            // standard deviation of the distance
+    float maxEccentricity = 0.1f;  // uniform in [0, max), at a random point of the orbit
+};
+
+// Plummer sphere (Aarseth, Henon & Wielen 1974) seen face on: sampled in
+// three dimensions and projected, so without the third dimension's support
+// it contracts somewhat before settling. Needs mutual gravity.
+struct ClusterSpec {
+    ParticleType type = ParticleType::Planetoid;
+    size_t count = 10000;
+    Vector2s center;
+    Vector2s velocity;       // bulk velocity of the whole cluster
+    Scalar scaleRadius = 500;  // Plummer radius; half the mass lies within 1.3 of it
+};
+
+// Pairs orbiting each other, their barycenters on circular orbits around
+// a source. Only separations well inside the Hill radius, r (m / 3M)^(1/3),
+// survive the source's tides. Needs mutual gravity.
+struct BinarySpec {
+    ParticleType primary = ParticleType::GasGiant;
+    ParticleType secondary = ParticleType::Satellite;
+    size_t pairs = 1000;
+    Scalar innerRadius = 8000;
+    Scalar outerRadius = 20000;
+    Scalar separation = 400;
+};
+
+// 0 threads uses every hardware thread
+size_t generateDisk(ParticleSystem& particles, const GravitySource& source, const DiskSpec& spec,
+    uint64_t seed, unsigned threadCount = 0);
+size_t generateBelt(ParticleSystem& particles, const GravitySource& source, const BeltSpec& spec,
+    uint64_t seed, unsigned threadCount = 0);
+size_t generateCluster(ParticleSystem& particles, const ClusterSpec& spec, uint64_t seed, unsigned threadCount = 0);
+// Pair k is the particles first + k (primary) and first + pairs + k
+size_t generateBinaries(ParticleSystem& particles, const GravitySource& source, const BinarySpec& spec,
+    uint64_t seed, unsigned threadCount = 0);
+
+#endif
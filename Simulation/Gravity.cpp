@@ -0,0 +1,468 @@
+#include "Gravity.h"
+#include "GravityKernels.h"
+#include "ParticleMesh.h"
+#include "Profiler.h"
+#include "QuadTree.h"
+#include "SourceField.h"
+#include "ThreadPool.h"
+#include <algorithm>
+
+// Particles per work item; small enough that clustered scenes balance
+constexpr size_t FORCE_CHUNK = 128;
+
+static QuadTree gravityTree;
+static ParticleMesh gravityMesh;
+static SourceField sourceField;
+static bool sourceFieldActive = false;  // sourceField is current for this pass
+static const SimdLevel cpuSimdLevel = detectSimdLevel();
+
+// Sources repacked as arrays for the vector kernels
+static std::vector<Scalar> sourceX, sourceY;
+static std::vector<float> sourceStrength, sourceRadius;
+
+// Particles that pull, packed for direct sum when some are passive
+static std::vector<Scalar> attractorX, attractorY;
+static std::vector<float> attractorMass, attractorRadius;
+static std::vector<size_t> attractorIndex;
+static bool packedAttractors = false;
+static float passiveMass = 0.0f;  // of the current pass
+
+// Gathered targets for partial force passes
+static std::vector<Scalar> activeX, activeY, activeAccX, activeAccY;
+static std::vector<float> activeRadius;
+
+// Per-particle potential energy, summed in index order after the pass
+static std::vector<double> particlePotential;
+
+Vector2s sourceAcceleration(Scalar x, Scalar y, float radius, const std::vector<GravitySource>& sources) {
+    Vector2s accel(0, 0);
+
+    for (const auto& src : sources) {
+        Vector2s srcPos = src.get_pos();
+        accumulatePull(accel, srcPos.x - x, srcPos.y - y, src.get_strength(), src.get_radius() + radius);
+    }
+
+    return accel;
+}
+
+Vector2s directAcceleration(Scalar x, Scalar y, float radius, size_t self, const ParticleSystem& particles) {
+    Vector2s accel(0, 0);
+
+    const Scalar* px = particles.pos_x();
+    const Scalar* py = particles.pos_y();
+    const float* m = particles.masses();
+    const float* r = particles.radii();
+    size_t n = particles.size();
+
+    for (size_t j = 0; j < n; ++j) {
+        if (j == self) continue;
+        accumulatePull(accel, px[j] - x, py[j] - y, m[j], r[j] + radius);
+    }
+
+    return accel;
+}
+
+// How a force pass evaluates mutual gravity
+enum class MutualPath {
+    None,
+    Direct,
+    Tree,  // gravityTree, built for this pass
+    Mesh   // gravityMesh, solved for this pass
+};
+
+// Tree or mesh, thread pool, packed sources and the source field shared by
+// the force passes. The mesh also solves for the potential if withPotential
+// is set. Partial passes leave the source field's extent as it is rather
+// than scan every particle for it.
+static MutualPath prepareForcePass(
+    const ParticleSystem& particles,
+    const std::vector<GravitySource>& sources,
+    bool mutualGravity,
+    const PhysicsSettings& settings,
+    bool withPotential,
+    bool partial = false
+) {
+    ThreadPool& pool = simulationPool(settings.threadCount);
+
+    MutualPath path = MutualPath::None;
+    if (mutualGravity) {
+        path = settings.solver == GravitySolver::BarnesHut ? MutualPath::Tree
+            : settings.solver == GravitySolver::ParticleMesh ? MutualPath::Mesh
+            : MutualPath::Direct;
+    }
+    if (path == MutualPath::Tree) {
+        PROFILE_SCOPE("Tree build");
+        gravityTree.set_theta(settings.theta);
+        gravityTree.build(particles, settings.passiveMass);
+    }
+    else if (path == MutualPath::Mesh) {
+        gravityMesh.set_size(settings.meshSize);
+        gravityMesh.set_padding(settings.meshPadding);
+        gravityMesh.set_assignment(settings.meshAssignment);
+        gravityMesh.set_short_range(settings.meshShortRange);
+        gravityMesh.set_passive_mass(settings.passiveMass);
+        gravityMesh.build(particles, pool, withPotential);
+    }
+
+    passiveMass = settings.passiveMass;
+    packedAttractors = path == MutualPath::Direct && passiveMass > 0.0f;
+    if (packedAttractors) {
+        attractorX.clear();
+        attractorY.clear();
+        attractorMass.clear();
+        attractorRadius.clear();
+        attractorIndex.clear();
+        const float* masses = particles.masses();
+        for (size_t i = 0; i < particles.size(); ++i) {
+            if (masses[i] < passiveMass) continue;
+            attractorX.push_back(particles.pos_x()[i]);
+            attractorY.push_back(particles.pos_y()[i]);
+            attractorMass.push_back(masses[i]);
+            attractorRadius.push_back(particles.radii()[i]);
+            attractorIndex.push_back(i);
+        }
+    }
+
+    sourceX.clear();
+    sourceY.clear();
+    sourceStrength.clear();
+    sourceRadius.clear();
+    for (const auto& src : sources) {
+        sourceX.push_back(src.get_pos().x);
+        sourceY.push_back(src.get_pos().y);
+        sourceStrength.push_back(src.get_strength());
+        sourceRadius.push_back(src.get_radius());
+    }
+
+    sourceFieldActive = settings.sourceField && !sources.empty();
+    if (sourceFieldActive) {
+        sourceField.update(particles.pos_x(), particles.pos_y(), partial ? 0 : particles.size(),
+            sourceX.data(), sourceY.data(), sourceStrength.data(), sourceRadius.data(), sourceX.size(),
+            std::min(settings.simd, cpuSimdLevel), pool);
+    }
+    else {
+        sourceField.clear();
+    }
+
+    return path;
+}
+
+// Particles that pull in a direct-sum pass: all of them, or the packed
+// ones when some are passive
+struct Attractors {
+    const Scalar* x;
+    const Scalar* y;
+    const float* mass;
+    const float* radius;
+    const size_t* index;  // particle index of each, null if they are the particles
+    size_t count;
+};
+
+static Attractors directAttractors(const ParticleSystem& particles) {
+    if (packedAttractors) {
+        return { attractorX.data(), attractorY.data(), attractorMass.data(), attractorRadius.data(),
+            attractorIndex.data(), attractorX.size() };
+    }
+    return { particles.pos_x(), particles.pos_y(), particles.masses(), particles.radii(), nullptr, particles.size() };
+}
+
+// Adds the sources' pull on targets [begin, end), from the source field
+// where it can answer and exactly elsewhere
+static void addSourcePull(SimdLevel simd, const Scalar* x, const Scalar* y, const float* radius,
+    size_t begin, size_t end, Scalar* ax, Scalar* ay) {
+    if (!sourceFieldActive) {
+        accumulateAttraction(simd, x, y, radius, begin, end,
+            sourceX.data(), sourceY.data(), sourceStrength.data(), sourceRadius.data(), sourceX.size(), ax, ay);
+        return;
+    }
+    for (size_t i = begin; i < end; ++i) {
+        if (!sourceField.sample(x[i], y[i], radius[i], ax[i], ay[i])) {
+            accumulateAttraction(simd, x, y, radius, i, i + 1,
+                sourceX.data(), sourceY.data(), sourceStrength.data(), sourceRadius.data(), sourceX.size(), ax, ay);
+        }
+    }
+}
+
+// Finishes particlePotential[begin, end): adds the source terms to the
+// mutual potential the tree walk, mesh or direct kernel stored there
+static void finishPotentials(const ParticleSystem& particles, size_t begin, size_t end, MutualPath path) {
+    const Scalar* px = particles.pos_x();
+    const Scalar* py = particles.pos_y();
+    const float* masses = particles.masses();
+    const float* radii = particles.radii();
+
+    for (size_t i = begin; i < end; ++i) {
+        double sourcePhi = 0.0;
+        for (size_t s = 0; s < sourceX.size(); ++s)
+            sourcePhi += pullPotential(sourceX[s] - px[i], sourceY[s] - py[i], sourceStrength[s], sourceRadius[s] + radii[i]);
+
+        double mutualPhi = path == MutualPath::None ? 0.0 : particlePotential[i];
+
+        // A pair of active particles is seen from both ends, so each end
+        // takes half; a passive particle's pairs only from its own end
+        double pairShare = masses[i] < passiveMass ? 1.0 : 0.5;
+        particlePotential[i] = masses[i] * (sourcePhi + pairShare * mutualPhi);
+    }
+}
+
+static double sumPotentials(size_t n) {
+    double total = 0.0;
+    for (size_t i = 0; i < n; ++i) total += particlePotential[i];
+    return total;
+}
+
+void computeAccelerations(
+    ParticleSystem& particles,
+    const std::vector<GravitySource>& sources,
+    bool mutualGravity,
+    const PhysicsSettings& settings
+) {
+    PROFILE_SCOPE("Force pass");
+    IntegratorState& state = particles.integrator_state();
+    bool gatherPotential = state.potentialRequested;
+    MutualPath path = prepareForcePass(particles, sources, mutualGravity, settings, gatherPotential);
+    SimdLevel simd = std::min(settings.simd, cpuSimdLevel);
+
+    const Scalar* px = particles.pos_x();
+    const Scalar* py = particles.pos_y();
+    const float* radii = particles.radii();
+    Scalar* ax = particles.acc_x();
+    Scalar* ay = particles.acc_y();
+    size_t n = particles.size();
+    Attractors attractors = directAttractors(particles);
+
+    if (gatherPotential) particlePotential.resize(n);
+
+    // Each particle only writes its own slot and chunk boundaries are
+    // fixed, so any thread count gives bit-identical results
+    simulationPool(settings.threadCount).parallel_for(n, FORCE_CHUNK, [&](size_t begin, size_t end) {
+        std::fill(ax + begin, ax + end, Scalar(0));
+        std::fill(ay + begin, ay + end, Scalar(0));
+
+        addSourcePull(simd, px, py, radii, begin, end, ax, ay);
+
+        if (path == MutualPath::Tree) {
+            for (size_t i = begin; i < end; ++i) {
+                Vector2s pos(px[i], py[i]);
+                Vector2s accel;
+                if (gatherPotential) {
+                    particlePotential[i] = 0.0;
+                    accel = gravityTree.acceleration(pos, radii[i], static_cast<int>(i), particlePotential[i]);
+                }
+                else {
+                    accel = gravityTree.acceleration(pos, radii[i], static_cast<int>(i));
+                }
+                ax[i] += accel.x;
+                ay[i] += accel.y;
+            }
+        }
+        else if (path == MutualPath::Mesh) {
+            for (size_t i = begin; i < end; ++i) {
+                Vector2s pos(px[i], py[i]);
+                Vector2s accel;
+                if (gatherPotential) {
+                    particlePotential[i] = 0.0;
+                    accel = gravityMesh.acceleration(pos, radii[i], i, particlePotential[i]);
+                }
+                else {
+                    accel = gravityMesh.acceleration(pos, radii[i], i);
+                }
+                ax[i] += accel.x;
+                ay[i] += accel.y;
+            }
+        }
+        else if (path == MutualPath::Direct) {
+            // A particle's pull on itself is exactly zero, no need to skip
+            // it; the kernel leaves its potential out the same way
+            double* phi = nullptr;
+            if (gatherPotential) {
+                std::fill(particlePotential.begin() + begin, particlePotential.begin() + end, 0.0);
+                phi = particlePotential.data();
+            }
+            accumulateAttraction(simd, px, py, radii, begin, end,
+                attractors.x, attractors.y, attractors.mass, attractors.radius, attractors.count, ax, ay, phi);
+        }
+
+        if (gatherPotential) finishPotentials(particles, begin, end, path);
+    });
+
+    if (gatherPotential) {
+        state.potential = sumPotentials(n);
+        state.potentialKey = state.forceKey;
+        state.potentialStamp = particles.edit_stamp();
+        state.potentialGathered = true;
+    }
+
+    particles.set_accelerations_valid(true);
+}
+
+void computeAccelerationsFor(
+    ParticleSystem& particles,
+    const std::vector<size_t>& active,
+    const std::vector<GravitySource>& sources,
+    bool mutualGravity,
+    const PhysicsSettings& settings
+) {
+    if (active.empty()) return;
+
+    PROFILE_SCOPE("Partial force pass");
+    MutualPath path = prepareForcePass(particles, sources, mutualGravity, settings, false, true);
+    SimdLevel simd = std::min(settings.simd, cpuSimdLevel);
+
+    const Scalar* px = particles.pos_x();
+    const Scalar* py = particles.pos_y();
+    const float* radii = particles.radii();
+    Scalar* ax = particles.acc_x();
+    Scalar* ay = particles.acc_y();
+    Attractors attractors = directAttractors(particles);
+    size_t count = active.size();
+
+    // Active targets are packed contiguously so the vector kernels can run on them
+    activeX.resize(count);
+    activeY.resize(count);
+    activeRadius.resize(count);
+    activeAccX.resize(count);
+    activeAccY.resize(count);
+    for (size_t k = 0; k < count; ++k) {
+        activeX[k] = px[active[k]];
+        activeY[k] = py[active[k]];
+        activeRadius[k] = radii[active[k]];
+    }
+
+    const Scalar* tx = activeX.data();
+    const Scalar* ty = activeY.data();
+    const float* tr = activeRadius.data();
+    Scalar* tax = activeAccX.data();
+    Scalar* tay = activeAccY.data();
+
+    simulationPool(settings.threadCount).parallel_for(count, FORCE_CHUNK, [&](size_t begin, size_t end) {
+        std::fill(tax + begin, tax + end, Scalar(0));
+        std::fill(tay + begin, tay + end, Scalar(0));
+
+        addSourcePull(simd, tx, ty, tr, begin, end, tax, tay);
+
+        if (path == MutualPath::Tree) {
+            for (size_t k = begin; k < end; ++k) {
+                Vector2s accel = gravityTree.acceleration(Vector2s(tx[k], ty[k]), tr[k], static_cast<int>(active[k]));
+                tax[k] += accel.x;
+                tay[k] += accel.y;
+            }
+        }
+        else if (path == MutualPath::Mesh) {
+            for (size_t k = begin; k < end; ++k) {
+                Vector2s accel = gravityMesh.acceleration(Vector2s(tx[k], ty[k]), tr[k], active[k]);
+                tax[k] += accel.x;
+                tay[k] += accel.y;
+            }
+        }
+        else if (path == MutualPath::Direct) {
+            accumulateAttraction(simd, tx, ty, tr, begin, end,
+                attractors.x, attractors.y, attractors.mass, attractors.radius, attractors.count, tax, tay);
+        }
+
+        for (size_t k = begin; k < end; ++k) {
+            ax[active[k]] = tax[k];
+            ay[active[k]] = tay[k];
+        }
+    });
+}
+
+double potentialEnergy(
+    const ParticleSystem& particles,
+    const std::vector<GravitySource>& sources,
+    bool mutualGravity,
+    const PhysicsSettings& settings
+) {
+    PROFILE_SCOPE("Potential pass");
+    MutualPath path = prepareForcePass(particles, sources, mutualGravity, settings, true);
+    SimdLevel simd = std::min(settings.simd, cpuSimdLevel);
+
+    const Scalar* px = particles.pos_x();
+    const Scalar* py = particles.pos_y();
+    const float* radii = particles.radii();
+    size_t n = particles.size();
+    Attractors attractors = directAttractors(particles);
+    particlePotential.resize(n);
+
+    simulationPool(settings.threadCount).parallel_for(n, FORCE_CHUNK, [&](size_t begin, size_t end) {
+        if (path == MutualPath::Tree) {
+            for (size_t i = begin; i < end; ++i) {
+                particlePotential[i] = 0.0;
+                gravityTree.acceleration(Vector2s(px[i], py[i]), radii[i], static_cast<int>(i), particlePotential[i]);
+            }
+        }
+        else if (path == MutualPath::Mesh) {
+            for (size_t i = begin; i < end; ++i) {
+                particlePotential[i] = 0.0;
+                gravityMesh.acceleration(Vector2s(px[i], py[i]), radii[i], i, particlePotential[i]);
+            }
+        }
+        else if (path == MutualPath::Direct) {
+            // Same kernel as the force pass, targets shifted to one block
+            // at a time so the pull it also computes lands in scratch
+            std::fill(particlePotential.begin() + begin, particlePotential.begin() + end, 0.0);
+            for (size_t block = begin; block < end; block += FORCE_CHUNK) {
+                size_t blockEnd = std::min(end, block + FORCE_CHUNK);
+                Scalar scratchX[FORCE_CHUNK] = {};
+                Scalar scratchY[FORCE_CHUNK] = {};
+                accumulateAttraction(simd, px + block, py + block, radii + block, 0, blockEnd - block,
+                    attractors.x, attractors.y, attractors.mass, attractors.radius, attractors.count,
+                    scratchX, scratchY, particlePotential.data() + block);
+            }
+        }
+        finishPotentials(particles, begin, end, path);
+    });
+
+    return sumPotentials(n);
+}
+
+void requestPotentialEnergy(ParticleSystem& particles) {
+    IntegratorState& state = particles.integrator_state();
+    state.potentialRequested = true;
+    state.potentialGathered = false;
+}
+
+bool takePotentialEnergy(ParticleSystem& particles, uint64_t forceKey, double& energy) {
+    IntegratorState& state = particles.integrator_state();
+    // Collisions after the last force pass leave its potential stale, and
+    // they are also what bumps the edit stamp
+    bool gathered = state.potentialGathered && state.potentialKey == forceKey
+        && state.potentialStamp == particles.edit_stamp() && particles.accelerations_valid();
+    if (gathered) energy = state.potential;
+    state.potentialRequested = false;
+    state.potentialGathered = false;
+    return gathered;
+}
+
+size_t forcePassMemoryBytes() {
+    size_t scalars = sourceX.capacity() + sourceY.capacity()
+        + activeX.capacity() + activeY.capacity() + activeAccX.capacity() + activeAccY.capacity();
+    scalars += attractorX.capacity() + attractorY.capacity();
+    size_t floats = sourceStrength.capacity() + sourceRadius.capacity() + activeRadius.capacity()
+        + attractorMass.capacity() + attractorRadius.capacity();
+    return gravityTree.memory_bytes() + gravityMesh.memory_bytes() + sourceField.memory_bytes() + scalars * sizeof(Scalar) + floats * sizeof(float)
+        + particlePotential.capacity() * sizeof(double) + attractorIndex.capacity() * sizeof(size_t);
+}
+
+void releaseForcePassMemory() {
+    gravityTree = QuadTree();
+    gravityMesh = ParticleMesh();
+    sourceField = SourceField();
+    sourceFieldActive = false;
+    std::vector<Scalar>().swap(sourceX);
+    std::vector<Scalar>().swap(sourceY);
+    std::vector<float>().swap(sourceStrength);
+    std::vector<float>().swap(sourceRadius);
+    std::vector<Scalar>().swap(attractorX);
+    std::vector<Scalar>().swap(attractorY);
+    std::vector<float>().swap(attractorMass);
+    std::vector<float>().swap(attractorRadius);
+    std::vector<size_t>().swap(attractorIndex);
+    packedAttractors = false;
+    std::vector<Scalar>().swap(activeX);
+    std::vector<Scalar>().swap(activeY);
+    std::vector<Scalar>().swap(activeAccX);
+    std::vector<Scalar>().swap(activeAccY);
+    std::vector<float>().swap(activeRadius);
+    std::vector<double>().swap(particlePotential);
+}
@@ -0,0 +1,89 @@
+#ifndef SIMULATOR_GRAVITY_H
+#define SIMULATOR_GRAVITY_H
+
+#include <vector>
+#include <cmath>
+#include "Particle.h"
+#include "GravitySource.h"
+#include "ParticleSystem.h"
+#include "PhysicsSettings.h"
+#include "Scalar.h"
+
+// Pull of a body of the given strength (G * mass) at offset (dx, dy).
+// Effective distance subtracts both visual radii and is clamped to SOFTENING.
+inline void accumulatePull(Vector2s& accel, Scalar dx, Scalar dy, float strength, float radii) {
+    Scalar dist = std::sqrt(dx * dx + dy * dy + Scalar(SOFTENING * SOFTENING));
+
+    Scalar effectiveDist = dist - radii;
+    if (effectiveDist < SOFTENING) effectiveDist = SOFTENING;
+
+    Scalar invDist = Scalar(1) / effectiveDist;
+    Scalar a_mag = Scalar(G * strength) * invDist * invDist;
+    accel.x += a_mag * dx / dist;
+    accel.y += a_mag * dy / dist;
+}
+
+// Potential per unit mass matching accumulatePull: -G m / d outside the
+// clamp, continued linearly inside it where the pull is constant
+inline double pullPotential(double dx, double dy, float strength, float radii) {
+    double dist = std::sqrt(dx * dx + dy * dy + double(SOFTENING) * SOFTENING);
+    double effectiveDist = dist - radii;
+    double gm = double(G) * strength;
+    if (effectiveDist > SOFTENING) return -gm / effectiveDist;
+    return -gm / SOFTENING + gm * (effectiveDist - SOFTENING) / (double(SOFTENING) * SOFTENING);
+}
+
+// Acceleration at (x, y) on a body of the given radius from the fixed sources
+Vector2s sourceAcceleration(Scalar x, Scalar y, float radius, const std::vector<GravitySource>& sources);
+
+// Direct-sum acceleration from every particle except 'self'
+Vector2s directAcceleration(Scalar x, Scalar y, float radius, size_t self, const ParticleSystem& particles);
+
+// Fills the particle acceleration arrays. Every particle reads the same
+// snapshot of positions, so the result does not depend on particle order.
+void computeAccelerations(
+    ParticleSystem& particles,
+    const std::vector<GravitySource>& sources,
+    bool mutualGravity,
+    const PhysicsSettings& settings
+);
+
+// Recomputes accelerations for the listed particles only, against the
+// current positions of every particle. Used by block timesteps, where
+// only the particles finishing a substep need a new force.
+void computeAccelerationsFor(
+    ParticleSystem& particles,
+    const std::vector<size_t>& active,
+    const std::vector<GravitySource>& sources,
+    bool mutualGravity,
+    const PhysicsSettings& settings
+);
+
+// Total potential energy of the particles: pairwise when mutual gravity
+// is on, plus each particle against the sources. A separate pass through
+// the same tree, mesh or direct-sum path as computeAccelerations, so it
+// costs about one force pass; the sum is the same on any thread count.
+double potentialEnergy(
+    const ParticleSystem& particles,
+    const std::vector<GravitySource>& sources,
+    bool mutualGravity,
+    const PhysicsSettings& settings
+);
+
+// Potential energy gathered by the force pass itself, per particle system.
+// After a request, every full computeAccelerations on those particles also
+// sums the potential at the positions it evaluates, in the same tree walk,
+// mesh lookup or direct-sum kernel pass, and take returns the last sum.
+// Take also ends the request; it returns false if no full pass ran since,
+// if the particles were edited after it, or if that pass was not under
+// 'forceKey' (see Integrators.h).
+void requestPotentialEnergy(ParticleSystem& particles);
+bool takePotentialEnergy(ParticleSystem& particles, uint64_t forceKey, double& energy);
+
+// Scratch memory kept alive between force passes (tree, mesh, packed sources)
+size_t forcePassMemoryBytes();
+
+// Frees that scratch; the next pass allocates it again at its own size
+void releaseForcePassMemory();
+
+#endif
@@ -0,0 +1,453 @@
+#include "GravityKernels.h"
+#include "Particle.h"
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMULATOR_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC lets any function use AVX2 intrinsics; GCC and Clang need it per function
+#if defined(SIMULATOR_X86) && !defined(_MSC_VER)
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define SIMD_TARGET_AVX2
+#endif
+
+SimdLevel detectSimdLevel() {
+#ifdef SIMULATOR_X86
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] >= 7) {
+        __cpuid(info, 1);
+        bool fma = (info[2] & (1 << 12)) != 0;
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        __cpuidex(info, 7, 0);
+        bool avx2 = (info[1] & (1 << 5)) != 0;
+        // OS must save the YMM registers on context switch
+        if (fma && osxsave && avx && avx2 && (_xgetbv(0) & 6) == 6)
+            return SimdLevel::AVX2;
+    }
+    return SimdLevel::SSE;
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return SimdLevel::AVX2;
+    return SimdLevel::SSE;
+#endif
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+// Every kernel takes WithPotential: when set it also adds each target's
+// potential per unit mass to potential[i], pullPotential's formula from
+// the unclamped gap and the 1/effectiveDist the force already needs,
+// summed in double. Coincident pairs add nothing, like their pull.
+
+// T is float or double; masses and radii are float either way
+template <bool WithPotential, typename T>
+static void attractScalar(
+    const T* tx, const T* ty, const float* tr, size_t begin, size_t end,
+    const T* sx, const T* sy, const float* sm, const float* sr, size_t count,
+    T* accX, T* accY, double* potential
+) {
+    for (size_t i = begin; i < end; ++i) {
+        T ax = 0;
+        T ay = 0;
+        double phi = 0.0;
+        for (size_t j = 0; j < count; ++j) {
+            T dx = sx[j] - tx[i];
+            T dy = sy[j] - ty[i];
+            T dist = std::sqrt(dx * dx + dy * dy + T(SOFTENING * SOFTENING));
+
+            T gap = dist - (sr[j] + tr[i]);
+            T effectiveDist = gap < SOFTENING ? T(SOFTENING) : gap;
+
+            T invDist = T(1) / effectiveDist;
+            T a_mag = T(G * sm[j]) * invDist * invDist;
+            ax += a_mag * dx / dist;
+            ay += a_mag * dy / dist;
+
+            if (WithPotential && (dx != 0 || dy != 0)) {
+                T inside = gap < SOFTENING ? gap - T(SOFTENING) : T(0);
+                phi += T(G * sm[j]) * (inside * T(1.0f / (SOFTENING * SOFTENING)) - invDist);
+            }
+        }
+        accX[i] += ax;
+        accY[i] += ay;
+        if (WithPotential) potential[i] += phi;
+    }
+}
+
+#ifdef SIMULATOR_X86
+
+template <bool WithPotential>
+static void attractSse(
+    const float* tx, const float* ty, const float* tr, size_t begin, size_t end,
+    const float* sx, const float* sy, const float* sm, const float* sr, size_t count,
+    float* accX, float* accY, double* potential
+) {
+    const __m128 soft = _mm_set1_ps(SOFTENING);
+    const __m128 soft2 = _mm_set1_ps(SOFTENING * SOFTENING);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 threeHalves = _mm_set1_ps(1.5f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 invSoft2 = _mm_set1_ps(1.0f / (SOFTENING * SOFTENING));
+
+    size_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m128 x = _mm_loadu_ps(tx + i);
+        __m128 y = _mm_loadu_ps(ty + i);
+        __m128 r = _mm_loadu_ps(tr + i);
+        __m128 ax = _mm_setzero_ps();
+        __m128 ay = _mm_setzero_ps();
+        __m128d phi0 = _mm_setzero_pd(), phi1 = _mm_setzero_pd();
+
+        for (size_t j = 0; j < count; ++j) {
+            __m128 dx = _mm_sub_ps(_mm_set1_ps(sx[j]), x);
+            __m128 dy = _mm_sub_ps(_mm_set1_ps(sy[j]), y);
+            __m128 dist2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), soft2);
+
+            // 1/dist: rsqrt estimate plus one Newton-Raphson step
+            __m128 invDist = _mm_rsqrt_ps(dist2);
+            invDist = _mm_mul_ps(invDist, _mm_sub_ps(threeHalves, _mm_mul_ps(_mm_mul_ps(half, dist2), _mm_mul_ps(invDist, invDist))));
+            __m128 dist = _mm_mul_ps(dist2, invDist);
+
+            __m128 gap = _mm_sub_ps(dist, _mm_add_ps(r, _mm_set1_ps(sr[j])));
+            __m128 effectiveDist = _mm_max_ps(gap, soft);
+
+            // 1/effectiveDist: rcp estimate plus one Newton-Raphson step
+            __m128 invEff = _mm_rcp_ps(effectiveDist);
+            invEff = _mm_mul_ps(invEff, _mm_sub_ps(two, _mm_mul_ps(effectiveDist, invEff)));
+
+            __m128 a_mag = _mm_mul_ps(_mm_set1_ps(G * sm[j]), _mm_mul_ps(invEff, invEff));
+            __m128 scale = _mm_mul_ps(a_mag, invDist);
+            ax = _mm_add_ps(ax, _mm_mul_ps(scale, dx));
+            ay = _mm_add_ps(ay, _mm_mul_ps(scale, dy));
+
+            if (WithPotential) {
+                __m128 inside = _mm_mul_ps(_mm_min_ps(_mm_sub_ps(gap, soft), zero), invSoft2);
+                __m128 phi = _mm_mul_ps(_mm_set1_ps(G * sm[j]), _mm_sub_ps(inside, invEff));
+                __m128 apart = _mm_or_ps(_mm_cmpneq_ps(dx, zero), _mm_cmpneq_ps(dy, zero));
+                phi = _mm_and_ps(phi, apart);
+                phi0 = _mm_add_pd(phi0, _mm_cvtps_pd(phi));
+                phi1 = _mm_add_pd(phi1, _mm_cvtps_pd(_mm_movehl_ps(phi, phi)));
+            }
+        }
+
+        _mm_storeu_ps(accX + i, _mm_add_ps(_mm_loadu_ps(accX + i), ax));
+        _mm_storeu_ps(accY + i, _mm_add_ps(_mm_loadu_ps(accY + i), ay));
+        if (WithPotential) {
+            _mm_storeu_pd(potential + i, _mm_add_pd(_mm_loadu_pd(potential + i), phi0));
+            _mm_storeu_pd(potential + i + 2, _mm_add_pd(_mm_loadu_pd(potential + i + 2), phi1));
+        }
+    }
+
+    attractScalar<WithPotential>(tx, ty, tr, i, end, sx, sy, sm, sr, count, accX, accY, potential);
+}
+
+template <bool WithPotential>
+SIMD_TARGET_AVX2
+static void attractAvx2(
+    const float* tx, const float* ty, const float* tr, size_t begin, size_t end,
+    const float* sx, const float* sy, const float* sm, const float* sr, size_t count,
+    float* accX, float* accY, double* potential
+) {
+    const __m256 soft = _mm256_set1_ps(SOFTENING);
+    const __m256 soft2 = _mm256_set1_ps(SOFTENING * SOFTENING);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 threeHalves = _mm256_set1_ps(1.5f);
+    const __m256 two = _mm256_set1_ps(2.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 invSoft2 = _mm256_set1_ps(1.0f / (SOFTENING * SOFTENING));
+
+    size_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256 x = _mm256_loadu_ps(tx + i);
+        __m256 y = _mm256_loadu_ps(ty + i);
+        __m256 r = _mm256_loadu_ps(tr + i);
+        __m256 ax = _mm256_setzero_ps();
+        __m256 ay = _mm256_setzero_ps();
+        __m256d phi0 = _mm256_setzero_pd(), phi1 = _mm256_setzero_pd();
+
+        for (size_t j = 0; j < count; ++j) {
+            __m256 dx = _mm256_sub_ps(_mm256_set1_ps(sx[j]), x);
+            __m256 dy = _mm256_sub_ps(_mm256_set1_ps(sy[j]), y);
+            __m256 dist2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, soft2));
+
+            // 1/dist: rsqrt estimate plus one Newton-Raphson step
+            __m256 invDist = _mm256_rsqrt_ps(dist2);
+            invDist = _mm256_mul_ps(invDist, _mm256_fnmadd_ps(_mm256_mul_ps(half, dist2), _mm256_mul_ps(invDist, invDist), threeHalves));
+            __m256 dist = _mm256_mul_ps(dist2, invDist);
+
+            __m256 gap = _mm256_sub_ps(dist, _mm256_add_ps(r, _mm256_set1_ps(sr[j])));
+            __m256 effectiveDist = _mm256_max_ps(gap, soft);
+
+            // 1/effectiveDist: rcp estimate plus one Newton-Raphson step
+            __m256 invEff = _mm256_rcp_ps(effectiveDist);
+            invEff = _mm256_mul_ps(invEff, _mm256_fnmadd_ps(effectiveDist, invEff, two));
+
+            __m256 a_mag = _mm256_mul_ps(_mm256_set1_ps(G * sm[j]), _mm256_mul_ps(invEff, invEff));
+            __m256 scale = _mm256_mul_ps(a_mag, invDist);
+            ax = _mm256_fmadd_ps(scale, dx, ax);
+            ay = _mm256_fmadd_ps(scale, dy, ay);
+
+            if (WithPotential) {
+                __m256 inside = _mm256_mul_ps(_mm256_min_ps(_mm256_sub_ps(gap, soft), zero), invSoft2);
+                __m256 phi = _mm256_mul_ps(_mm256_set1_ps(G * sm[j]), _mm256_sub_ps(inside, invEff));
+                __m256 apart = _mm256_or_ps(_mm256_cmp_ps(dx, zero, _CMP_NEQ_UQ), _mm256_cmp_ps(dy, zero, _CMP_NEQ_UQ));
+                phi = _mm256_and_ps(phi, apart);
+                phi0 = _mm256_add_pd(phi0, _mm256_cvtps_pd(_mm256_castps256_ps128(phi)));
+                phi1 = _mm256_add_pd(phi1, _mm256_cvtps_pd(_mm256_extractf128_ps(phi, 1)));
+            }
+        }
+
+        _mm256_storeu_ps(accX + i, _mm256_add_ps(_mm256_loadu_ps(accX + i), ax));
+        _mm256_storeu_ps(accY + i, _mm256_add_ps(_mm256_loadu_ps(accY + i), ay));
+        if (WithPotential) {
+            _mm256_storeu_pd(potential + i, _mm256_add_pd(_mm256_loadu_pd(potential + i), phi0));
+            _mm256_storeu_pd(potential + i + 4, _mm256_add_pd(_mm256_loadu_pd(potential + i + 4), phi1));
+        }
+    }
+
+    // Leftover targets go through the 4-wide path, then scalar
+    attractSse<WithPotential>(tx, ty, tr, i, end, sx, sy, sm, sr, count, accX, accY, potential);
+}
+
+// Double state, float forces: separations are taken in double, where they
+// stay exact however far the bodies are from the origin, then narrowed so
+// the rest runs through the same float math at the full lane count
+template <bool WithPotential>
+static void attractSseDouble(
+    const double* tx, const double* ty, const float* tr, size_t begin, size_t end,
+    const double* sx, const double* sy, const float* sm, const float* sr, size_t count,
+    double* accX, double* accY, double* potential
+) {
+    const __m128 soft = _mm_set1_ps(SOFTENING);
+    const __m128 soft2 = _mm_set1_ps(SOFTENING * SOFTENING);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 threeHalves = _mm_set1_ps(1.5f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 invSoft2 = _mm_set1_ps(1.0f / (SOFTENING * SOFTENING));
+
+    size_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m128d x0 = _mm_loadu_pd(tx + i), x1 = _mm_loadu_pd(tx + i + 2);
+        __m128d y0 = _mm_loadu_pd(ty + i), y1 = _mm_loadu_pd(ty + i + 2);
+        __m128 r = _mm_loadu_ps(tr + i);
+        __m128 ax = _mm_setzero_ps();
+        __m128 ay = _mm_setzero_ps();
+        __m128d phi0 = _mm_setzero_pd(), phi1 = _mm_setzero_pd();
+
+        for (size_t j = 0; j < count; ++j) {
+            __m128d sxj = _mm_set1_pd(sx[j]);
+            __m128d syj = _mm_set1_pd(sy[j]);
+            __m128 dx = _mm_movelh_ps(_mm_cvtpd_ps(_mm_sub_pd(sxj, x0)), _mm_cvtpd_ps(_mm_sub_pd(sxj, x1)));
+            __m128 dy = _mm_movelh_ps(_mm_cvtpd_ps(_mm_sub_pd(syj, y0)), _mm_cvtpd_ps(_mm_sub_pd(syj, y1)));
+            __m128 dist2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), soft2);
+
+            __m128 invDist = _mm_rsqrt_ps(dist2);
+            invDist = _mm_mul_ps(invDist, _mm_sub_ps(threeHalves, _mm_mul_ps(_mm_mul_ps(half, dist2), _mm_mul_ps(invDist, invDist))));
+            __m128 dist = _mm_mul_ps(dist2, invDist);
+
+            __m128 gap = _mm_sub_ps(dist, _mm_add_ps(r, _mm_set1_ps(sr[j])));
+            __m128 effectiveDist = _mm_max_ps(gap, soft);
+
+            __m128 invEff = _mm_rcp_ps(effectiveDist);
+            invEff = _mm_mul_ps(invEff, _mm_sub_ps(two, _mm_mul_ps(effectiveDist, invEff)));
+
+            __m128 a_mag = _mm_mul_ps(_mm_set1_ps(G * sm[j]), _mm_mul_ps(invEff, invEff));
+            __m128 scale = _mm_mul_ps(a_mag, invDist);
+            ax = _mm_add_ps(ax, _mm_mul_ps(scale, dx));
+            ay = _mm_add_ps(ay, _mm_mul_ps(scale, dy));
+
+            if (WithPotential) {
+                __m128 inside = _mm_mul_ps(_mm_min_ps(_mm_sub_ps(gap, soft), zero), invSoft2);
+                __m128 phi = _mm_mul_ps(_mm_set1_ps(G * sm[j]), _mm_sub_ps(inside, invEff));
+                __m128 apart = _mm_or_ps(_mm_cmpneq_ps(dx, zero), _mm_cmpneq_ps(dy, zero));
+                phi = _mm_and_ps(phi, apart);
+                phi0 = _mm_add_pd(phi0, _mm_cvtps_pd(phi));
+                phi1 = _mm_add_pd(phi1, _mm_cvtps_pd(_mm_movehl_ps(phi, phi)));
+            }
+        }
+
+        _mm_storeu_pd(accX + i, _mm_add_pd(_mm_loadu_pd(accX + i), _mm_cvtps_pd(ax)));
+        _mm_storeu_pd(accX + i + 2, _mm_add_pd(_mm_loadu_pd(accX + i + 2), _mm_cvtps_pd(_mm_movehl_ps(ax, ax))));
+        _mm_storeu_pd(accY + i, _mm_add_pd(_mm_loadu_pd(accY + i), _mm_cvtps_pd(ay)));
+        _mm_storeu_pd(accY + i + 2, _mm_add_pd(_mm_loadu_pd(accY + i + 2), _mm_cvtps_pd(_mm_movehl_ps(ay, ay))));
+        if (WithPotential) {
+            _mm_storeu_pd(potential + i, _mm_add_pd(_mm_loadu_pd(potential + i), phi0));
+            _mm_storeu_pd(potential + i + 2, _mm_add_pd(_mm_loadu_pd(potential + i + 2), phi1));
+        }
+    }
+
+    attractScalar<WithPotential>(tx, ty, tr, i, end, sx, sy, sm, sr, count, accX, accY, potential);
+}
+
+SIMD_TARGET_AVX2
+static __m256 narrowPair(__m256d low, __m256d high) {
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(low)), _mm256_cvtpd_ps(high), 1);
+}
+
+template <bool WithPotential>
+SIMD_TARGET_AVX2
+static void attractAvx2Double(
+    const double* tx, const double* ty, const float* tr, size_t begin, size_t end,
+    const double* sx, const double* sy, const float* sm, const float* sr, size_t count,
+    double* accX, double* accY, double* potential
+) {
+    const __m256 soft = _mm256_set1_ps(SOFTENING);
+    const __m256 soft2 = _mm256_set1_ps(SOFTENING * SOFTENING);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 threeHalves = _mm256_set1_ps(1.5f);
+    const __m256 two = _mm256_set1_ps(2.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 invSoft2 = _mm256_set1_ps(1.0f / (SOFTENING * SOFTENING));
+
+    size_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256d x0 = _mm256_loadu_pd(tx + i), x1 = _mm256_loadu_pd(tx + i + 4);
+        __m256d y0 = _mm256_loadu_pd(ty + i), y1 = _mm256_loadu_pd(ty + i + 4);
+        __m256 r = _mm256_loadu_ps(tr + i);
+        __m256 ax = _mm256_setzero_ps();
+        __m256 ay = _mm256_setzero_ps();
+        __m256d phi0 = _mm256_setzero_pd(), phi1 = _mm256_setzero_pd();
+
+        for (size_t j = 0; j < count; ++j) {
+            __m256d sxj = _mm256_set1_pd(sx[j]);
+            __m256d syj = _mm256_set1_pd(sy[j]);
+            __m256 dx = narrowPair(_mm256_sub_pd(sxj, x0), _mm256_sub_pd(sxj, x1));
+            __m256 dy = narrowPair(_mm256_sub_pd(syj, y0), _mm256_sub_pd(syj, y1));
+            __m256 dist2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, soft2));
+
+            __m256 invDist = _mm256_rsqrt_ps(dist2);
+            invDist = _mm256_mul_ps(invDist, _mm256_fnmadd_ps(_mm256_mul_ps(half, dist2), _mm256_mul_ps(invDist, invDist), threeHalves));
+            __m256 dist = _mm256_mul_ps(dist2, invDist);
+
+            __m256 gap = _mm256_sub_ps(dist, _mm256_add_ps(r, _mm256_set1_ps(sr[j])));
+            __m256 effectiveDist = _mm256_max_ps(gap, soft);
+
+            __m256 invEff = _mm256_rcp_ps(effectiveDist);
+            invEff = _mm256_mul_ps(invEff, _mm256_fnmadd_ps(effectiveDist, invEff, two));
+
+            __m256 a_mag = _mm256_mul_ps(_mm256_set1_ps(G * sm[j]), _mm256_mul_ps(invEff, invEff));
+            __m256 scale = _mm256_mul_ps(a_mag, invDist);
+            ax = _mm256_fmadd_ps(scale, dx, ax);
+            ay = _mm256_fmadd_ps(scale, dy, ay);
+
+            if (WithPotential) {
+                __m256 inside = _mm256_mul_ps(_mm256_min_ps(_mm256_sub_ps(gap, soft), zero), invSoft2);
+                __m256 phi = _mm256_mul_ps(_mm256_set1_ps(G * sm[j]), _mm256_sub_ps(inside, invEff));
+                __m256 apart = _mm256_or_ps(_mm256_cmp_ps(dx, zero, _CMP_NEQ_UQ), _mm256_cmp_ps(dy, zero, _CMP_NEQ_UQ));
+                phi = _mm256_and_ps(phi, apart);
+                phi0 = _mm256_add_pd(phi0, _mm256_cvtps_pd(_mm256_castps256_ps128(phi)));
+                phi1 = _mm256_add_pd(phi1, _mm256_cvtps_pd(_mm256_extractf128_ps(phi, 1)));
+            }
+        }
+
+        _mm256_storeu_pd(accX + i, _mm256_add_pd(_mm256_loadu_pd(accX + i), _mm256_cvtps_pd(_mm256_castps256_ps128(ax))));
+        _mm256_storeu_pd(accX + i + 4, _mm256_add_pd(_mm256_loadu_pd(accX + i + 4), _mm256_cvtps_pd(_mm256_extractf128_ps(ax, 1))));
+        _mm256_storeu_pd(accY + i, _mm256_add_pd(_mm256_loadu_pd(accY + i), _mm256_cvtps_pd(_mm256_castps256_ps128(ay))));
+        _mm256_storeu_pd(accY + i + 4, _mm256_add_pd(_mm256_loadu_pd(accY + i + 4), _mm256_cvtps_pd(_mm256_extractf128_ps(ay, 1))));
+        if (WithPotential) {
+            _mm256_storeu_pd(potential + i, _mm256_add_pd(_mm256_loadu_pd(potential + i), phi0));
+            _mm256_storeu_pd(potential + i + 4, _mm256_add_pd(_mm256_loadu_pd(potential + i + 4), phi1));
+        }
+    }
+
+    attractSseDouble<WithPotential>(tx, ty, tr, i, end, sx, sy, sm, sr, count, accX, accY, potential);
+}
+
+#endif
+
+template <bool WithPotential>
+static void attract(
+    SimdLevel level,
+    const float* tx, const float* ty, const float* tr, size_t begin, size_t end,
+    const float* sx, const float* sy, const float* sm, const float* sr, size_t count,
+    float* accX, float* accY, double* potential
+) {
+    switch (level) {
+#ifdef SIMULATOR_X86
+    case SimdLevel::AVX2:
+        attractAvx2<WithPotential>(tx, ty, tr, begin, end, sx, sy, sm, sr, count, accX, accY, potential);
+        return;
+    case SimdLevel::SSE:
+        attractSse<WithPotential>(tx, ty, tr, begin, end, sx, sy, sm, sr, count, accX, accY, potential);
+        return;
+#endif
+    default:
+        attractScalar<WithPotential>(tx, ty, tr, begin, end, sx, sy, sm, sr, count, accX, accY, potential);
+        return;
+    }
+}
+
+template <bool WithPotential>
+static void attract(
+    SimdLevel level,
+    const double* tx, const double* ty, const float* tr, size_t begin, size_t end,
+    const double* sx, const double* sy, const float* sm, const float* sr, size_t count,
+    double* accX, double* accY, double* potential
+) {
+    switch (level) {
+#ifdef SIMULATOR_X86
+    case SimdLevel::AVX2:
+        attractAvx2Double<WithPotential>(tx, ty, tr, begin, end, sx, sy, sm, sr, count, accX, accY, potential);
+        return;
+    case SimdLevel::SSE:
+        attractSseDouble<WithPotential>(tx, ty, tr, begin, end, sx, sy, sm, sr, count, accX, accY, potential);
+        return;
+#endif
+    default:
+        attractScalar<WithPotential>(tx, ty, tr, begin, end, sx, sy, sm, sr, count, accX, accY, potential);
+        return;
+    }
+}
+
+void accumulateAttraction(
+    SimdLevel level,
+    const float* targetX, const float* targetY, const float* targetRadius,
+    size_t begin, size_t end,
+    const float* attractorX, const float* attractorY,
+    const float* attractorStrength, const float* attractorRadius,
+    size_t count,
+    float* accX, float* accY,
+    double* potential
+) {
+    if (potential) {
+        attract<true>(level, targetX, targetY, targetRadius, begin, end,
+            attractorX, attractorY, attractorStrength, attractorRadius, count, accX, accY, potential);
+    }
+    else {
+        attract<false>(level, targetX, targetY, targetRadius, begin, end,
+            attractorX, attractorY, attractorStrength, attractorRadius, count, accX, accY, nullptr);
+    }
+}
+
+void accumulateAttraction(
+    SimdLevel level,
+    const double* targetX, const double* targetY, const float* targetRadius,
+    size_t begin, size_t end,
+    const double* attractorX, const double* attractorY,
+    const float* attractorStrength, const float* attractorRadius,
+    size_t count,
+    double* accX, double* accY,
+    double* potential
+) {
+    if (potential) {
+        attract<true>(level, targetX, targetY, targetRadius, begin, end,
+            attractorX, attractorY, attractorStrength, attractorRadius, count, accX, accY, potential);
+    }
+    else {
+        attract<false>(level, targetX, targetY, targetRadius, begin, end,
+            attractorX, attractorY, attractorStrength, attractorRadius, count, accX, accY, nullptr);
+    }
+}
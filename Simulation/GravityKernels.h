@@ -0,0 +1,48 @@
+#ifndef SIMULATOR_GRAVITYKERNELS_H
+#define SIMULATOR_GRAVITYKERNELS_H
+
+#include <cstddef>
+#include "PhysicsSettings.h"
+
+// Highest instruction set this CPU (and OS) supports, detected once
+SimdLevel detectSimdLevel();
+
+// Adds to (accX, accY)[begin, end) the pull of 'count' attractors on the
+// targets [begin, end). Attractors are given as position, strength (mass)
+// and radius arrays; targets by position and radius.
+// Same radius-adjusted effectiveDist and SOFTENING rules as accumulatePull.
+// A target that coincides with an attractor gets zero pull from it, so a
+// particle set can be passed as both targets and attractors.
+// Vector paths use rsqrt/rcp with one Newton-Raphson refinement and agree
+// with the scalar path to under 1e-6 relative per pair, times
+// dist / effectiveDist where the radii cancel most of the distance: just
+// outside a large source that is up to about 3e-4 (Benchmark --check-kernels).
+// The double overload takes each separation in double, so it stays exact
+// far from the origin, and evaluates the force in float on the same lane
+// count; only the scalar path is double throughout.
+// Masses and radii stay float in both.
+// If 'potential' is given, each target's potential per unit mass from the
+// attractors (pullPotential, coincident pairs excluded) is also added to
+// potential[begin, end) in the same pass, summed in double.
+void accumulateAttraction(
+    SimdLevel level,
+    const float* targetX, const float* targetY, const float* targetRadius,
+    size_t begin, size_t end,
+    const float* attractorX, const float* attractorY,
+    const float* attractorStrength, const float* attractorRadius,
+    size_t count,
+    float* accX, float* accY,
+    double* potential = nullptr
+);
+void accumulateAttraction(
+    SimdLevel level,
+    const double* targetX, const double* targetY, const float* targetRadius,
+    size_t begin, size_t end,
+    const double* attractorX, const double* attractorY,
+    const float* attractorStrength, const float* attractorRadius,
+    size_t count,
+    double* accX, double* accY,
+    double* potential = nullptr
+);
+
+#endif
@@ -1,47 +1,38 @@
 #include "GravitySource.h"
+#include <atomic>
 
-GravitySource::GravitySource(float pos_x, float pos_y, GravitySourceType type)
-    : pos(pos_x, pos_y), type(type)
+GravitySource::GravitySource(Scalar pos_x, Scalar pos_y, GravitySourceType type)
+    : pos(pos_x, pos_y), type(type), id(next_id())
 {
-    s.setPosition(pos);
-
     switch (type) {
     case GravitySourceType::RedDwarf:
         strength = 25000.0f;
-        s.setFillColor(sf::Color::Red);
-        s.setRadius(178.8f); // ~107,280 km
+        radius = 178.8f; // ~107,280 km
         break;
 
     case GravitySourceType::WhiteDwarf:
         strength = 56000.0f;
-        s.setFillColor(sf::Color::White);
-        s.setRadius(11.66f); // ~6,996 km
+        radius = 11.66f; // ~6,996 km
         break;
 
     case GravitySourceType::YellowDwarf:
         strength = 333000.0f;
-        s.setFillColor(sf::Color(139, 128, 0));
-        s.setRadius(1160.56f); // ~696,336 km (Sun)
+        radius = 1160.56f; // ~696,336 km (Sun)
         break;
 
     case GravitySourceType::NeutronStar:
         strength = 450000.0f;
-        s.setFillColor(sf::Color(175, 238, 238));
-        s.setRadius(1.0f); // ~14 km
+        radius = 1.0f; // ~14 km
         break;
 
     default:
         strength = 0.0f;
+        radius = 0.0f;
         break;
     }
 }
 
-void GravitySource::render(sf::RenderWindow& window) {
-    s.setOrigin(s.getRadius(), s.getRadius());
-    window.draw(s);
-}
-
-sf::Vector2f GravitySource::get_pos() const {
+Vector2s GravitySource::get_pos() const {
     return pos;
 }
 
@@ -50,14 +41,25 @@ float GravitySource::get_strength() const {
 }
 
 float GravitySource::get_radius() const {
-    return s.getRadius();
+    return radius;
 }
 
 GravitySourceType GravitySource::get_type() const {
     return type;
 }
 
-void GravitySource::set_pos(float pos_x, float pos_y) {
+SourceHandle GravitySource::handle() const {
+    SourceHandle h;
+    h.id = id;
+    return h;
+}
+
+uint64_t GravitySource::next_id() {
+    static std::atomic<uint64_t> lastId{ 0 };
+    return ++lastId;
+}
+
+void GravitySource::set_pos(Scalar pos_x, Scalar pos_y) {
 	pos.x = pos_x;
     pos.y = pos_y;
 }
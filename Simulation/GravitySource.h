@@ -0,0 +1,48 @@
+#ifndef SIMULATOR_GRAVITYSOURCE_H
+#define SIMULATOR_GRAVITYSOURCE_H
+
+#include <cstdint>
+#include "Scalar.h"
+
+enum class GravitySourceType {
+    RedDwarf,
+    WhiteDwarf,
+    YellowDwarf,
+    NeutronStar
+};
+
+// Names one source for as long as it exists. It travels with the source
+// through copies of the source list and the swap that removing another
+// source does, and ids are never reused, so the handle of a removed source
+// stays invalid. Scenes hold a handful of sources, so lookups scan the
+// list rather than keep a slot table like ParticleSystem's.
+struct SourceHandle {
+    uint64_t id = 0;
+};
+
+class GravitySource {
+private:
+    Vector2s pos;
+    float strength;
+    float radius;
+    GravitySourceType type;
+    uint64_t id;
+
+    static uint64_t next_id();
+
+public:
+    GravitySource(Scalar pos_x, Scalar pos_y, GravitySourceType type);
+    GravitySource(Scalar pos_x, Scalar pos_y, float strength);
+
+    
+    Vector2s get_pos() const;
+    float get_strength() const;
+    float get_radius() const;
+    GravitySourceType get_type() const;
+    SourceHandle handle() const;
+
+    void set_pos(Scalar pos_x, Scalar pos_y);
+    void set_strength(float strength);
+};
+
+#endif
\ No newline at end of file
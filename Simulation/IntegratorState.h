@@ -0,0 +1,50 @@
+#ifndef SIMULATOR_INTEGRATORSTATE_H
+#define SIMULATOR_INTEGRATORSTATE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Scalar.h"
+
+// What integrateStep keeps from one step of a particle set to the next.
+// Each ParticleSystem owns one, so separate simulations (or the scratch
+// set a time warp integrates) never see each other's forces or substeps.
+struct IntegratorState {
+    static constexpr int RK_STAGES = 7;
+
+    // Hash of the sources and settings the cached accelerations were
+    // computed with; a step under any other forces recomputes them first
+    uint64_t forceKey = 0;
+
+    // Potential energy a force pass gathers on request (Diagnostics), with
+    // the force key and edit stamp of the pass that summed it
+    bool potentialRequested = false;
+    bool potentialGathered = false;
+    double potential = 0.0;
+    uint64_t potentialKey = 0;
+    uint64_t potentialStamp = 0;
+
+    // RK45 controller's proposal after the last accepted substep, 0 = none yet
+    double rkSubstep = 0.0;
+
+    // Scratch reused between steps: block timestep levels and the
+    // particles finishing a substep
+    std::vector<std::vector<size_t>> levelMembers;
+    std::vector<size_t> active;
+
+    // RK45 scratch: start of the substep and the velocity and acceleration
+    // of every stage
+    std::vector<Scalar> rkStartX, rkStartY, rkStartVX, rkStartVY;
+    std::vector<Scalar> rkVelX[RK_STAGES], rkVelY[RK_STAGES], rkAccX[RK_STAGES], rkAccY[RK_STAGES];
+
+    size_t memory_bytes() const {
+        size_t indices = active.capacity();
+        for (const auto& members : levelMembers) indices += members.capacity();
+        size_t scalars = rkStartX.capacity() + rkStartY.capacity() + rkStartVX.capacity() + rkStartVY.capacity();
+        for (int s = 0; s < RK_STAGES; ++s)
+            scalars += rkVelX[s].capacity() + rkVelY[s].capacity() + rkAccX[s].capacity() + rkAccY[s].capacity();
+        return indices * sizeof(size_t) + scalars * sizeof(Scalar);
+    }
+};
+
+#endif
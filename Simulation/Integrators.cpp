@@ -0,0 +1,391 @@
+#include "Integrators.h"
+#include "Gravity.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+
+// Splitting schemes: kick(0) drift(0) kick(1) drift(1) ... drift(DRIFTS - 1)
+// kick(DRIFTS), coefficients as fractions of dt. The opening kick uses the
+// cached accelerations and each drift is followed by one force pass.
+// Each scheme is its own splitStep instantiation, so the stage loop has a
+// compile-time trip count and the coefficients fold into constants.
+struct LeapfrogScheme {
+    static const int DRIFTS = 1;
+    static double drift(int) { return 1.0; }
+    static double kick(int) { return 0.5; }
+};
+
+// Yoshida's triple jump (Forest & Ruth 1990): leapfrog steps of w1, w0, w1
+// with w1 = 1 / (2 - 2^(1/3)) and w0 = 1 - 2 w1. w0 is negative, so the
+// middle drift runs backwards in time.
+constexpr double YOSHIDA_W1 = 1.3512071919596578;
+constexpr double YOSHIDA_W0 = -1.7024143839193153;
+
+struct Yoshida4Scheme {
+    static const int DRIFTS = 3;
+    static double drift(int s) { return s == 1 ? YOSHIDA_W0 : YOSHIDA_W1; }
+    static double kick(int s) { return (s == 0 || s == DRIFTS) ? 0.5 * YOSHIDA_W1 : 0.5 * (YOSHIDA_W1 + YOSHIDA_W0); }
+};
+
+template <typename Scheme>
+static void splitStep(ParticleSystem& particles, const std::vector<GravitySource>& sources, bool mutualGravity, const PhysicsSettings& settings) {
+    Scalar* px = particles.pos_x();
+    Scalar* py = particles.pos_y();
+    Scalar* vx = particles.vel_x();
+    Scalar* vy = particles.vel_y();
+    const Scalar* ax = particles.acc_x();
+    const Scalar* ay = particles.acc_y();
+    size_t n = particles.size();
+    double dt = settings.dt;
+
+    for (int s = 0; s < Scheme::DRIFTS; ++s) {
+        // Kick with the accelerations of the current positions, then drift
+        Scalar kick = static_cast<Scalar>(Scheme::kick(s) * dt);
+        Scalar drift = static_cast<Scalar>(Scheme::drift(s) * dt);
+        for (size_t i = 0; i < n; ++i) {
+            vx[i] += ax[i] * kick;
+            vy[i] += ay[i] * kick;
+            px[i] += vx[i] * drift;
+            py[i] += vy[i] * drift;
+        }
+
+        computeAccelerations(particles, sources, mutualGravity, settings);
+    }
+
+    // Closing kick
+    Scalar kick = static_cast<Scalar>(Scheme::kick(Scheme::DRIFTS) * dt);
+    for (size_t i = 0; i < n; ++i) {
+        vx[i] += ax[i] * kick;
+        vy[i] += ay[i] * kick;
+    }
+}
+
+// Block timestep level for one particle: the coarsest k with
+// dt / 2^k <= stepAccuracy * tau. tau ~ |v| / |a| is the time for the
+// velocity to turn appreciably (about an orbital period / 2pi); the
+// sqrt(|a| * SOFTENING) term keeps it finite for particles at rest.
+static int chooseStepLevel(Scalar vx, Scalar vy, Scalar ax, Scalar ay, float dt, float accuracy, int maxLevel) {
+    Scalar accel = std::sqrt(ax * ax + ay * ay);
+    if (accel <= 0.0f) return 0;
+
+    Scalar speed = std::sqrt(vx * vx + vy * vy);
+    Scalar target = accuracy * (speed + std::sqrt(accel * SOFTENING)) / accel;
+
+    int level = 0;
+    while (level < maxLevel && dt / static_cast<float>(1 << level) > target) ++level;
+    return level;
+}
+
+// Kick-drift-kick with block timesteps; without any particle needing a
+// finer level it is the plain leapfrog split step
+static void leapfrogStep(ParticleSystem& particles, const std::vector<GravitySource>& sources, bool mutualGravity, const PhysicsSettings& settings) {
+    Scalar* px = particles.pos_x();
+    Scalar* py = particles.pos_y();
+    Scalar* vx = particles.vel_x();
+    Scalar* vy = particles.vel_y();
+    const Scalar* ax = particles.acc_x();
+    const Scalar* ay = particles.acc_y();
+    unsigned char* level = particles.step_levels();
+    size_t n = particles.size();
+    float dt = settings.dt;
+    std::vector<std::vector<size_t>>& levelMembers = particles.integrator_state().levelMembers;
+    std::vector<size_t>& active = particles.integrator_state().active;
+
+    // Levels are picked while every particle is synchronised, at the start
+    // of the full step, and held until its end
+    int maxLevel = settings.blockTimesteps ? std::min(std::max(settings.maxStepLevel, 0), 16) : 0;
+    int finest = 0;
+    for (size_t i = 0; i < n; ++i) {
+        int k = maxLevel > 0 ? chooseStepLevel(vx[i], vy[i], ax[i], ay[i], dt, settings.stepAccuracy, maxLevel) : 0;
+        level[i] = static_cast<unsigned char>(k);
+        finest = std::max(finest, k);
+    }
+
+    if (finest == 0) {
+        splitStep<LeapfrogScheme>(particles, sources, mutualGravity, settings);
+        return;
+    }
+
+    levelMembers.resize(finest + 1);
+    for (auto& members : levelMembers) members.clear();
+    for (size_t i = 0; i < n; ++i) levelMembers[level[i]].push_back(i);
+
+    // The full step is cut into 2^finest substeps of h. A particle on level k
+    // takes one kick-drift-kick of dt / 2^k every 2^(finest - k) substeps.
+    int substeps = 1 << finest;
+    float h = dt / substeps;
+
+    for (int s = 0; s < substeps; ++s) {
+        // Opening kick for the levels starting a block step
+        for (int k = 0; k <= finest; ++k) {
+            int stride = 1 << (finest - k);
+            if (s % stride != 0) continue;
+            float halfStep = 0.5f * h * stride;
+            for (size_t i : levelMembers[k]) {
+                vx[i] += ax[i] * halfStep;
+                vy[i] += ay[i] * halfStep;
+            }
+        }
+
+        // With mutual gravity every particle pulls on the active ones, so all
+        // positions must be current. Without it a particle is only needed at
+        // its own block ends and drifts the whole block in one go.
+        if (mutualGravity) {
+            for (size_t i = 0; i < n; ++i) {
+                px[i] += vx[i] * h;
+                py[i] += vy[i] * h;
+            }
+        }
+        else {
+            for (int k = 0; k <= finest; ++k) {
+                int stride = 1 << (finest - k);
+                if ((s + 1) % stride != 0) continue;
+                float blockStep = h * stride;
+                for (size_t i : levelMembers[k]) {
+                    px[i] += vx[i] * blockStep;
+                    py[i] += vy[i] * blockStep;
+                }
+            }
+        }
+
+        // One force evaluation per block step, at its drifted end
+        if (s + 1 == substeps) {
+            computeAccelerations(particles, sources, mutualGravity, settings);
+        }
+        else {
+            active.clear();
+            for (int k = 0; k <= finest; ++k) {
+                if ((s + 1) % (1 << (finest - k)) == 0)
+                    active.insert(active.end(), levelMembers[k].begin(), levelMembers[k].end());
+            }
+            computeAccelerationsFor(particles, active, sources, mutualGravity, settings);
+        }
+
+        // Closing kick for the levels finishing a block step
+        for (int k = 0; k <= finest; ++k) {
+            int stride = 1 << (finest - k);
+            if ((s + 1) % stride != 0) continue;
+            float halfStep = 0.5f * h * stride;
+            for (size_t i : levelMembers[k]) {
+                vx[i] += ax[i] * halfStep;
+                vy[i] += ay[i] * halfStep;
+            }
+        }
+    }
+}
+
+// Dormand-Prince 5(4). The last stage is evaluated at the 5th-order
+// solution, so its derivatives open the next substep (first same as last).
+constexpr int RK_STAGES = IntegratorState::RK_STAGES;
+static const double RK_A[RK_STAGES][RK_STAGES - 1] = {
+    { 0, 0, 0, 0, 0, 0 },
+    { 1.0 / 5, 0, 0, 0, 0, 0 },
+    { 3.0 / 40, 9.0 / 40, 0, 0, 0, 0 },
+    { 44.0 / 45, -56.0 / 15, 32.0 / 9, 0, 0, 0 },
+    { 19372.0 / 6561, -25360.0 / 2187, 64448.0 / 6561, -212.0 / 729, 0, 0 },
+    { 9017.0 / 3168, -355.0 / 33, 46732.0 / 5247, 49.0 / 176, -5103.0 / 18656, 0 },
+    { 35.0 / 384, 0, 500.0 / 1113, 125.0 / 192, -2187.0 / 6784, 11.0 / 84 }
+};
+// 5th-order minus embedded 4th-order weights
+static const double RK_ERROR[RK_STAGES] = {
+    71.0 / 57600, 0, -71.0 / 16695, 71.0 / 1920, -17253.0 / 339200, 22.0 / 525, -1.0 / 40
+};
+
+// Covers settings.dt in as many substeps as the error estimate demands.
+// Energy drifts secularly, unlike the symplectic schemes; it is here as
+// an independent reference to check them against.
+static void rk45Step(ParticleSystem& particles, const std::vector<GravitySource>& sources, bool mutualGravity, const PhysicsSettings& settings) {
+    size_t n = particles.size();
+    Scalar* px = particles.pos_x();
+    Scalar* py = particles.pos_y();
+    Scalar* vx = particles.vel_x();
+    Scalar* vy = particles.vel_y();
+    const Scalar* ax = particles.acc_x();
+    const Scalar* ay = particles.acc_y();
+
+    IntegratorState& state = particles.integrator_state();
+    std::vector<Scalar>& rkStartX = state.rkStartX;
+    std::vector<Scalar>& rkStartY = state.rkStartY;
+    std::vector<Scalar>& rkStartVX = state.rkStartVX;
+    std::vector<Scalar>& rkStartVY = state.rkStartVY;
+    std::vector<Scalar>* rkVelX = state.rkVelX;
+    std::vector<Scalar>* rkVelY = state.rkVelY;
+    std::vector<Scalar>* rkAccX = state.rkAccX;
+    std::vector<Scalar>* rkAccY = state.rkAccY;
+
+    rkStartX.assign(px, px + n);
+    rkStartY.assign(py, py + n);
+    for (int s = 0; s < RK_STAGES; ++s) {
+        rkVelX[s].resize(n);
+        rkVelY[s].resize(n);
+        rkAccX[s].resize(n);
+        rkAccY[s].resize(n);
+    }
+    rkVelX[0].assign(vx, vx + n);
+    rkVelY[0].assign(vy, vy + n);
+    rkAccX[0].assign(ax, ax + n);
+    rkAccY[0].assign(ay, ay + n);
+
+    double dt = settings.dt;
+    double tolerance = std::max(settings.rk45Tolerance, 1.0e-9f);
+    double minStep = dt / 4096.0;  // accepted whatever the error, so a step always finishes
+    double remaining = dt;
+    double h = state.rkSubstep > 0.0 ? std::min(state.rkSubstep, dt) : dt;
+
+    // Stop short of rounding leftovers rather than take a vanishing substep
+    while (remaining > 1.0e-9 * dt) {
+        h = std::min(h, remaining);
+        rkStartVX = rkVelX[0];
+        rkStartVY = rkVelY[0];
+
+        for (int s = 1; s < RK_STAGES; ++s) {
+            for (size_t i = 0; i < n; ++i) {
+                double dx = 0.0, dy = 0.0, dvx = 0.0, dvy = 0.0;
+                for (int j = 0; j < s; ++j) {
+                    dx += RK_A[s][j] * rkVelX[j][i];
+                    dy += RK_A[s][j] * rkVelY[j][i];
+                    dvx += RK_A[s][j] * rkAccX[j][i];
+                    dvy += RK_A[s][j] * rkAccY[j][i];
+                }
+                px[i] = rkStartX[i] + static_cast<Scalar>(h * dx);
+                py[i] = rkStartY[i] + static_cast<Scalar>(h * dy);
+                rkVelX[s][i] = rkStartVX[i] + static_cast<Scalar>(h * dvx);
+                rkVelY[s][i] = rkStartVY[i] + static_cast<Scalar>(h * dvy);
+            }
+
+            computeAccelerations(particles, sources, mutualGravity, settings);
+            rkAccX[s].assign(ax, ax + n);
+            rkAccY[s].assign(ay, ay + n);
+        }
+
+        // Largest per-particle error, in px; velocity error counts as the
+        // position error it causes over one substep
+        double worst = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            double ex = 0.0, ey = 0.0, evx = 0.0, evy = 0.0;
+            for (int j = 0; j < RK_STAGES; ++j) {
+                ex += RK_ERROR[j] * rkVelX[j][i];
+                ey += RK_ERROR[j] * rkVelY[j][i];
+                evx += RK_ERROR[j] * rkAccX[j][i];
+                evy += RK_ERROR[j] * rkAccY[j][i];
+            }
+            double positionError = h * std::sqrt(ex * ex + ey * ey);
+            double velocityError = h * h * std::sqrt(evx * evx + evy * evy);
+            worst = std::max(worst, std::max(positionError, velocityError));
+        }
+        double error = worst / tolerance;
+
+        // Standard controller: 0.9 safety factor, growth and shrink limited
+        double factor = error > 0.0 ? 0.9 * std::pow(error, -0.2) : 5.0;
+        double next = std::max(h * std::min(std::max(factor, 0.2), 5.0), minStep);
+
+        if (error <= 1.0 || h <= minStep) {
+            // Accepted: the last stage is the new start
+            rkStartX.assign(px, px + n);
+            rkStartY.assign(py, py + n);
+            std::swap(rkVelX[0], rkVelX[RK_STAGES - 1]);
+            std::swap(rkVelY[0], rkVelY[RK_STAGES - 1]);
+            std::swap(rkAccX[0], rkAccX[RK_STAGES - 1]);
+            std::swap(rkAccY[0], rkAccY[RK_STAGES - 1]);
+            remaining -= h;
+            state.rkSubstep = next;
+        }
+        h = next;
+    }
+
+    // Positions and accelerations already hold the last accepted stage
+    std::copy(rkVelX[0].begin(), rkVelX[0].end(), vx);
+    std::copy(rkVelY[0].begin(), rkVelY[0].end(), vy);
+}
+
+// FNV-1a over the raw bytes of each value
+static void hashBytes(uint64_t& hash, const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+}
+
+template <typename T>
+static void hashValue(uint64_t& hash, const T& value) {
+    hashBytes(hash, &value, sizeof(value));
+}
+
+// The integrator is in the key too, so switching schemes starts from
+// freshly computed accelerations
+uint64_t forceKey(const std::vector<GravitySource>& sources, bool mutualGravity, const PhysicsSettings& settings) {
+    uint64_t hash = 14695981039346656037ull;
+    hashValue(hash, sources.size());
+    for (const auto& src : sources) {
+        hashValue(hash, src.get_pos().x);
+        hashValue(hash, src.get_pos().y);
+        hashValue(hash, src.get_strength());
+        hashValue(hash, src.get_radius());
+    }
+    hashValue(hash, mutualGravity);
+    hashValue(hash, settings.solver);
+    hashValue(hash, settings.theta);
+    hashValue(hash, settings.meshSize);
+    hashValue(hash, settings.meshPadding);
+    hashValue(hash, settings.meshAssignment);
+    hashValue(hash, settings.meshShortRange);
+    hashValue(hash, settings.sourceField);
+    hashValue(hash, settings.passiveMass);
+    hashValue(hash, settings.simd);
+    hashValue(hash, settings.integrator);
+    return hash;
+}
+
+void integrateStep(
+    ParticleSystem& particles,
+    const std::vector<GravitySource>& sources,
+    bool mutualGravity,
+    const PhysicsSettings& settings
+) {
+    PROFILE_SCOPE("Integrate");
+
+    uint64_t key = forceKey(sources, mutualGravity, settings);
+    IntegratorState& state = particles.integrator_state();
+    if (key != state.forceKey) {
+        particles.set_accelerations_valid(false);
+        state.forceKey = key;
+    }
+
+    // First step after particles or forces changed has nothing to reuse
+    if (!particles.accelerations_valid())
+        computeAccelerations(particles, sources, mutualGravity, settings);
+
+    switch (settings.integrator) {
+    case Integrator::Yoshida4:
+        splitStep<Yoshida4Scheme>(particles, sources, mutualGravity, settings);
+        break;
+    case Integrator::RK45:
+        rk45Step(particles, sources, mutualGravity, settings);
+        break;
+    default:
+        leapfrogStep(particles, sources, mutualGravity, settings);
+        break;
+    }
+}
+
+void markAccelerationsCurrent(
+    ParticleSystem& particles,
+    const std::vector<GravitySource>& sources,
+    bool mutualGravity,
+    const PhysicsSettings& settings
+) {
+    IntegratorState& state = particles.integrator_state();
+    state.forceKey = forceKey(sources, mutualGravity, settings);
+    // Filled without a full pass, so any potential gathered before is stale
+    state.potentialGathered = false;
+    particles.set_accelerations_valid(true);
+}
+
+const char* integratorName(Integrator integrator) {
+    switch (integrator) {
+    case Integrator::Yoshida4: return "Yoshida4";
+    case Integrator::RK45: return "RK45";
+    default: return "Leapfrog";
+    }
+}
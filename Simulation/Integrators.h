@@ -0,0 +1,36 @@
+#ifndef SIMULATOR_INTEGRATORS_H
+#define SIMULATOR_INTEGRATORS_H
+
+#include <cstdint>
+#include <vector>
+#include "GravitySource.h"
+#include "ParticleSystem.h"
+#include "PhysicsSettings.h"
+
+// Advances every particle by settings.dt with settings.integrator.
+// Every scheme finishes with the accelerations of the final positions in
+// the particle arrays, so the next step starts without a force pass
+// whichever integrator takes it.
+void integrateStep(
+    ParticleSystem& particles,
+    const std::vector<GravitySource>& sources,
+    bool mutualGravity,
+    const PhysicsSettings& settings
+);
+
+// Hash of everything that changes the force on a particle at a given
+// position: the sources and every setting the force pass reads
+uint64_t forceKey(const std::vector<GravitySource>& sources, bool mutualGravity, const PhysicsSettings& settings);
+
+// For code that fills the acceleration arrays itself: records that they
+// hold the forces of these sources and settings, so integrateStep reuses them
+void markAccelerationsCurrent(
+    ParticleSystem& particles,
+    const std::vector<GravitySource>& sources,
+    bool mutualGravity,
+    const PhysicsSettings& settings
+);
+
+const char* integratorName(Integrator integrator);
+
+#endif
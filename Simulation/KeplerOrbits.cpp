@@ -0,0 +1,301 @@
+#include "KeplerOrbits.h"
+#include "Particle.h"
+#include "ThreadPool.h"
+#include <cmath>
+
+constexpr double TWO_PI = 6.283185307179586;
+constexpr size_t ORBIT_CHUNK = 1024;
+
+// Ellipse of a body at (rx, ry) moving at (rvx, rvy) relative to a source
+struct Ellipse {
+    double a;  // semi-major axis
+    double c;  // e cos E
+    double s;  // e sin E
+    double e;
+};
+
+// False unless the body is outside 'reach', bound, and not so eccentric
+// that Kepler's equation is slow to solve
+static bool boundEllipse(double rx, double ry, double rvx, double rvy, double mu, double reach, Ellipse& orbit) {
+    double r0 = std::sqrt(rx * rx + ry * ry);
+    double energy = 0.5 * (rvx * rvx + rvy * rvy) - mu / r0;
+    if (r0 <= reach || energy >= 0.0) return false;
+    orbit.a = -mu / (2.0 * energy);
+    orbit.c = 1.0 - r0 / orbit.a;
+    orbit.s = (rx * rvx + ry * rvy) / std::sqrt(mu * orbit.a);
+    orbit.e = std::sqrt(orbit.c * orbit.c + orbit.s * orbit.s);
+    return orbit.e <= KeplerOrbits::MAX_ECCENTRICITY;
+}
+
+// The sources as classify() packed them
+struct PackedSources {
+    const double* x;
+    const double* y;
+    const double* strength;
+    const double* radius;
+    size_t count;
+};
+
+// Whether a body of 'radius' at (rx, ry) from source k, moving at
+// (rvx, rvy), can orbit it in closed form: on a bound ellipse where the
+// radii bend the pull at periapsis, and the other sources add to it at
+// apoapsis, by at most 'tolerance' of the pull
+static bool keplerian(const PackedSources& sources, size_t k, double rx, double ry, double rvx, double rvy,
+    double radius, double tolerance, Ellipse& orbit) {
+    const double softening = SOFTENING;
+    double reach = sources.radius[k] + radius;
+    if (!boundEllipse(rx, ry, rvx, rvy, G * sources.strength[k], reach, orbit)) return false;
+
+    // The radii bend the pull most at periapsis
+    double periapsis = orbit.a * (1.0 - orbit.e);
+    double apoapsis = orbit.a * (1.0 + orbit.e);
+    double effectiveDist = std::sqrt(periapsis * periapsis + softening * softening) - reach;
+    if (effectiveDist <= softening) return false;
+    double ratio = periapsis / effectiveDist;
+    double disturbance = std::abs(ratio * ratio - 1.0);
+
+    // Other sources, against the weakest the dominant one gets, at apoapsis
+    double weakest = sources.strength[k] / (apoapsis * apoapsis);
+    for (size_t other = 0; other < sources.count && disturbance <= tolerance; ++other) {
+        if (other == k) continue;
+        double dx = sources.x[other] - sources.x[k];
+        double dy = sources.y[other] - sources.y[k];
+        double gap = std::sqrt(dx * dx + dy * dy) - apoapsis - sources.radius[other] - radius;
+        if (gap <= softening) return false;
+        disturbance += sources.strength[other] / (gap * gap) / weakest;
+    }
+    return disturbance <= tolerance;
+}
+
+bool KeplerOrbits::is_current(const ParticleSystem& particles, const std::vector<GravitySource>& sources, float tolerance) const {
+    if (particles.edit_stamp() != classifiedStamp || tolerance != classifiedTolerance || sources.size() != sourceX.size())
+        return false;
+    for (size_t k = 0; k < sources.size(); ++k) {
+        if (sourceX[k] != sources[k].get_pos().x || sourceY[k] != sources[k].get_pos().y
+            || sourceStrength[k] != sources[k].get_strength() || sourceRadius[k] != sources[k].get_radius())
+            return false;
+    }
+    return true;
+}
+
+void KeplerOrbits::classify(const ParticleSystem& particles, const std::vector<GravitySource>& sources, float tolerance,
+    unsigned threadCount) {
+    const Scalar* px = particles.pos_x();
+    const Scalar* py = particles.pos_y();
+    const Scalar* vx = particles.vel_x();
+    const Scalar* vy = particles.vel_y();
+    const float* radius = particles.radii();
+    const double softening = SOFTENING;
+
+    size_t sourceCount = sources.size();
+    sourceX.resize(sourceCount);
+    sourceY.resize(sourceCount);
+    sourceStrength.resize(sourceCount);
+    sourceRadius.resize(sourceCount);
+    for (size_t k = 0; k < sourceCount; ++k) {
+        sourceX[k] = sources[k].get_pos().x;
+        sourceY[k] = sources[k].get_pos().y;
+        sourceStrength[k] = sources[k].get_strength();
+        sourceRadius[k] = sources[k].get_radius();
+    }
+    classifiedTolerance = tolerance;
+    classifiedStamp = particles.edit_stamp();
+
+    const PackedSources packed = { sourceX.data(), sourceY.data(), sourceStrength.data(), sourceRadius.data(), sourceCount };
+    const uint32_t integrate = static_cast<uint32_t>(sourceCount);
+    orbitSource.resize(particles.size());
+    simulationPool(threadCount).parallel_for(particles.size(), ORBIT_CHUNK, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            orbitSource[i] = integrate;
+
+            // The source pulling hardest here is the one to orbit
+            size_t dominant = sourceCount;
+            double strongest = 0.0;
+            for (size_t k = 0; k < sourceCount; ++k) {
+                double dx = sourceX[k] - px[i];
+                double dy = sourceY[k] - py[i];
+                double effectiveDist = std::sqrt(dx * dx + dy * dy + softening * softening) - sourceRadius[k] - radius[i];
+                if (effectiveDist < softening) effectiveDist = softening;
+                double pull = sourceStrength[k] / (effectiveDist * effectiveDist);
+                if (pull > strongest) {
+                    strongest = pull;
+                    dominant = k;
+                }
+            }
+            if (dominant == sourceCount) continue;
+
+            Ellipse orbit;
+            if (keplerian(packed, dominant, px[i] - sourceX[dominant], py[i] - sourceY[dominant], vx[i], vy[i],
+                    radius[i], tolerance, orbit))
+                orbitSource[i] = static_cast<uint32_t>(dominant);
+        }
+    });
+
+    sort_indices();
+}
+
+void KeplerOrbits::sort_indices() {
+    const uint32_t integrate = static_cast<uint32_t>(sourceX.size());
+    analyticIndex.clear();
+    numericIndex.clear();
+    for (size_t i = 0; i < orbitSource.size(); ++i) {
+        if (orbitSource[i] == integrate) numericIndex.push_back(i);
+        else analyticIndex.push_back(i);
+    }
+}
+
+bool KeplerOrbits::bind(const ParticleSystem& particles, unsigned threadCount) {
+    size_t count = analyticIndex.size();
+    centreX.resize(count);
+    centreY.resize(count);
+    relX.resize(count);
+    relY.resize(count);
+    relVX.resize(count);
+    relVY.resize(count);
+    semiMajor.resize(count);
+    meanMotion.resize(count);
+    ecosE.resize(count);
+    esinE.resize(count);
+    startAnomaly.resize(count);
+    eccentricity.resize(count);
+
+    const Scalar* px = particles.pos_x();
+    const Scalar* py = particles.pos_y();
+    const Scalar* vx = particles.vel_x();
+    const Scalar* vy = particles.vel_y();
+    const float* radius = particles.radii();
+    const PackedSources packed = { sourceX.data(), sourceY.data(), sourceStrength.data(), sourceRadius.data(), sourceX.size() };
+    simulationPool(threadCount).parallel_for(count, ORBIT_CHUNK, [&](size_t begin, size_t end) {
+        for (size_t j = begin; j < end; ++j) {
+            size_t i = analyticIndex[j];
+            size_t k = orbitSource[i];
+            double mu = G * sourceStrength[k];
+            centreX[j] = sourceX[k];
+            centreY[j] = sourceY[k];
+            relX[j] = px[i] - sourceX[k];
+            relY[j] = py[i] - sourceY[k];
+            relVX[j] = vx[i];
+            relVY[j] = vy[i];
+
+            Ellipse orbit;
+            if (!keplerian(packed, k, relX[j], relY[j], relVX[j], relVY[j], radius[i], classifiedTolerance, orbit)) {
+                eccentricity[j] = -1.0;
+                continue;
+            }
+            semiMajor[j] = orbit.a;
+            meanMotion[j] = std::sqrt(mu / (orbit.a * orbit.a * orbit.a));
+            ecosE[j] = orbit.c;
+            esinE[j] = orbit.s;
+            startAnomaly[j] = std::atan2(orbit.s, orbit.c);
+            eccentricity[j] = orbit.e;
+        }
+    });
+
+    // Those that no longer qualify go to the integrator; the rest are read
+    // again at their new positions in the lists, and all pass this time
+    bool kept = true;
+    for (size_t j = 0; j < count; ++j) {
+        if (eccentricity[j] < 0.0) {
+            orbitSource[analyticIndex[j]] = static_cast<uint32_t>(sourceX.size());
+            kept = false;
+        }
+    }
+    if (!kept) {
+        sort_indices();
+        bind(particles, threadCount);
+    }
+    return kept;
+}
+
+// Solves E - e sin E = M for particles [begin, end). The first pass takes
+// the same Newton steps for all, with no branches, so the compiler can
+// vectorize it across particles; advances of a step or a few have converged
+// after it. Long jumps at high eccentricity that have not iterate on one by one.
+void KeplerOrbits::solve(size_t begin, size_t end) {
+    const double* mean = meanAnomaly.data();
+    const double* advance = meanAdvance.data();
+    const double* ecc = eccentricity.data();
+    const double* start = startAnomaly.data();
+    const double* startCos = ecosE.data();
+    double* anomaly = eccentricAnomaly.data();
+    double* lastStep = newtonStep.data();
+
+    for (size_t j = begin; j < end; ++j) {
+        double m = mean[j];
+        double e = ecc[j];
+
+        // Short advances start from the current anomaly, to first order;
+        // longer ones from Danby's guess, 0.85 e past M towards apoapsis
+        double local = start[j] + advance[j] / (1.0 - startCos[j]);
+        double phase = m - TWO_PI * std::floor(m / TWO_PI);
+        double danby = m + (phase < 0.5 * TWO_PI ? 0.85 : -0.85) * e;
+        double E = advance[j] < SHORT_ADVANCE ? local : danby;
+
+        double step = 0.0;
+        for (int it = 0; it < FIXED_ITERATIONS; ++it) {
+            step = (E - e * std::sin(E) - m) / (1.0 - e * std::cos(E));
+            E -= step;
+        }
+        anomaly[j] = E;
+        lastStep[j] = step;
+    }
+
+    for (size_t j = begin; j < end; ++j) {
+        double e = ecc[j];
+        double E = anomaly[j];
+        double step = lastStep[j];
+        for (int it = FIXED_ITERATIONS; it < MAX_ITERATIONS && std::abs(step) > CONVERGED; ++it) {
+            step = (E - e * std::sin(E) - mean[j]) / (1.0 - e * std::cos(E));
+            E -= step;
+        }
+        anomaly[j] = E;
+    }
+}
+
+void KeplerOrbits::propagate(ParticleSystem& particles, double dt, unsigned threadCount) {
+    size_t count = analyticIndex.size();
+    meanAdvance.resize(count);
+    meanAnomaly.resize(count);
+    eccentricAnomaly.resize(count);
+    newtonStep.resize(count);
+
+    Scalar* px = particles.pos_x();
+    Scalar* py = particles.pos_y();
+    Scalar* vx = particles.vel_x();
+    Scalar* vy = particles.vel_y();
+    simulationPool(threadCount).parallel_for(count, ORBIT_CHUNK, [&](size_t begin, size_t end) {
+        // Whole orbits change nothing, so only the remainder of the mean anomaly
+        // is advanced; that keeps huge warps as precise as single steps
+        for (size_t j = begin; j < end; ++j) {
+            double advance = meanMotion[j] * dt;
+            meanAdvance[j] = advance - TWO_PI * std::floor(advance / TWO_PI);
+            meanAnomaly[j] = startAnomaly[j] - esinE[j] + meanAdvance[j];
+        }
+
+        solve(begin, end);
+
+        // Lagrange's f and g in the change of eccentric anomaly carry the state
+        // forward without the orientation of the ellipse, so circles are no
+        // special case
+        for (size_t j = begin; j < end; ++j) {
+            double a = semiMajor[j];
+            double n = meanMotion[j];
+            double x = eccentricAnomaly[j] - startAnomaly[j];
+            double cosX = std::cos(x);
+            double sinX = std::sin(x);
+
+            double r0 = std::sqrt(relX[j] * relX[j] + relY[j] * relY[j]);
+            double r = a * (1.0 - ecosE[j] * cosX + esinE[j] * sinX);
+            double f = 1.0 - a / r0 * (1.0 - cosX);
+            double g = (meanAdvance[j] - (x - sinX)) / n;
+            double fDot = -n * a * a * sinX / (r * r0);
+            double gDot = 1.0 - a / r * (1.0 - cosX);
+
+            size_t i = analyticIndex[j];
+            px[i] = static_cast<Scalar>(centreX[j] + f * relX[j] + g * relVX[j]);
+            py[i] = static_cast<Scalar>(centreY[j] + f * relY[j] + g * relVY[j]);
+            vx[i] = static_cast<Scalar>(fDot * relX[j] + gDot * relVX[j]);
+            vy[i] = static_cast<Scalar>(fDot * relY[j] + gDot * relVY[j]);
+        }
+    });
+}
@@ -0,0 +1,90 @@
+#ifndef SIMULATOR_KEPLERORBITS_H
+#define SIMULATOR_KEPLERORBITS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "GravitySource.h"
+#include "ParticleSystem.h"
+
+// Closed-form propagation for particles that, without mutual gravity, just
+// orbit one source. Such a particle moves along a Kepler ellipse, so any
+// span of time costs one solve of Kepler's equation instead of a step per dt.
+//
+// The pull subtracts both radii from the distance, which is Keplerian only
+// far from the surface: the pull at periapsis is off from a point mass's by
+// about 2 (R + r) / periapsis. The other sources are fixed, so the most they
+// add anywhere on the orbit is bounded by their pull at its closest approach.
+// classify() takes a particle in closed form only if both stay below the
+// tolerance as a fraction of the dominant source's pull over the whole
+// orbit; closer in, or too near another source, it is left to the integrator.
+// The sorting is kept until the sources or the particles are edited, but
+// the steps in between drift the orbits, so bind() tests each closed-form
+// particle again and hands the ones that no longer qualify to the integrator.
+class KeplerOrbits {
+public:
+    static constexpr double MAX_ECCENTRICITY = 0.95;
+
+private:
+    // Kepler's equation: Newton steps every particle takes, then at most
+    // MAX_ITERATIONS until a step is below CONVERGED, in radians. Advances
+    // under SHORT_ADVANCE of mean anomaly start from the current anomaly.
+    static constexpr int FIXED_ITERATIONS = 2;
+    static constexpr int MAX_ITERATIONS = 12;
+    static constexpr double CONVERGED = 1.0e-10;
+    static constexpr double SHORT_ADVANCE = 0.05;
+
+    // What the last classify() saw: sources packed in double, the tolerance
+    // and the particles' edit stamp
+    std::vector<double> sourceX, sourceY, sourceStrength, sourceRadius;
+    float classifiedTolerance = 0.0f;
+    uint64_t classifiedStamp = 0;
+
+    // Per particle, the source it orbits in closed form, or the source count
+    std::vector<uint32_t> orbitSource;
+
+    // Per closed-form particle, its state relative to the source in double
+    std::vector<size_t> analyticIndex;
+    std::vector<double> centreX, centreY;  // source position
+    std::vector<double> relX, relY, relVX, relVY;
+    std::vector<double> semiMajor;
+    std::vector<double> meanMotion;
+    std::vector<double> ecosE, esinE;  // eccentricity times cos and sin of the eccentric anomaly now
+    std::vector<double> startAnomaly;  // eccentric anomaly now
+    std::vector<double> eccentricity;  // negative once the orbit no longer qualifies
+
+    // Kepler's equation for the current propagate()
+    std::vector<double> meanAdvance;  // mean anomaly to advance by, under one orbit
+    std::vector<double> meanAnomaly;
+    std::vector<double> eccentricAnomaly;
+    std::vector<double> newtonStep;  // last step of the fixed pass
+
+    std::vector<size_t> numericIndex;
+
+    // Rebuilds analyticIndex and numericIndex from orbitSource
+    void sort_indices();
+    void solve(size_t begin, size_t end);
+
+public:
+    // True while the sources, the tolerance and the particles are the ones
+    // the last classify() sorted; steps in between keep it, edits do not
+    bool is_current(const ParticleSystem& particles, const std::vector<GravitySource>& sources, float tolerance) const;
+
+    // Sorts the particles into closed-form orbits and those to integrate
+    void classify(const ParticleSystem& particles, const std::vector<GravitySource>& sources, float tolerance,
+        unsigned threadCount);
+
+    // Reads the closed-form particles' orbits from where they are now, with
+    // the same tests as classify(). False if any no longer qualified and was
+    // moved to numeric(); O(sources) per closed-form particle.
+    bool bind(const ParticleSystem& particles, unsigned threadCount);
+
+    // Moves the particles the last bind() read dt along their orbits,
+    // positions and velocities; accelerations are left stale
+    void propagate(ParticleSystem& particles, double dt, unsigned threadCount);
+
+    const std::vector<size_t>& analytic() const { return analyticIndex; }
+    const std::vector<size_t>& numeric() const { return numericIndex; }
+};
+
+#endif
@@ -0,0 +1,14 @@
+#include "Particle.h"
+
+// Indexed by ParticleType
+static const ParticleTypeInfo particleTypeTable[] = {
+    { 0.0035f, 0.783f },   // Planetoid
+    { 0.01f,   2.8906f },  // Satellite
+    { 1.0f,    10.63f },   // Terrestrial
+    { 318.0f,  119.153f }, // GasGiant
+    { 17.0f,   41.66f }    // IceGiant
+};
+
+const ParticleTypeInfo& getParticleTypeInfo(ParticleType type) {
+    return particleTypeTable[static_cast<int>(type)];
+}
@@ -0,0 +1,23 @@
+#ifndef SIMULATOR_PARTICLE_H
+#define SIMULATOR_PARTICLE_H
+
+constexpr float G = 0.03f;
+constexpr float SOFTENING = 1.0f;
+
+enum class ParticleType {
+    Planetoid, 
+    Satellite,
+    Terrestrial, 
+    GasGiant,
+    IceGiant
+};
+
+// Per-type physical constants shared by every particle of that type
+struct ParticleTypeInfo {
+    float mass;
+    float radius;
+};
+
+const ParticleTypeInfo& getParticleTypeInfo(ParticleType type);
+
+#endif
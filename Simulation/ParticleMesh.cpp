@@ -0,0 +1,394 @@
+#include "ParticleMesh.h"
+#include "Gravity.h"
+#include "ParticleSystem.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+constexpr double PI = 3.141592653589793;
+constexpr double SQRT_PI = 1.7724538509055159;
+
+// Grid rows per work item, and columns gathered together so that
+// reading them walks each row's memory rather than striding it
+constexpr size_t ROW_CHUNK = 4;
+constexpr size_t COLUMN_BLOCK = 8;
+
+// Cell sizes step by 2^(1/8), so the kernels are rebuilt only when the
+// particles' extent changes by about 9%
+constexpr double CELL_SIZE_STEPS = 8.0;
+
+typedef std::complex<double> Complex;
+
+// Plain complex product; std::complex's handles infinities, which is slow
+static inline Complex multiply(Complex a, Complex b) {
+    return Complex(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+}
+
+// In-place radix-2 FFT of n points, unscaled in both directions
+static void fft(Complex* a, size_t n, const Complex* twiddles, const uint32_t* bitReverse, bool inverse) {
+    for (size_t i = 0; i < n; ++i) {
+        size_t j = bitReverse[i];
+        if (i < j) std::swap(a[i], a[j]);
+    }
+    for (size_t len = 2; len <= n; len <<= 1) {
+        size_t half = len / 2;
+        size_t step = n / len;
+        for (size_t i = 0; i < n; i += len) {
+            for (size_t k = 0; k < half; ++k) {
+                Complex w = twiddles[k * step];
+                if (inverse) w = std::conj(w);
+                Complex u = a[i + k];
+                Complex v = multiply(a[i + k + half], w);
+                a[i + k] = u + v;
+                a[i + k + half] = u - v;
+            }
+        }
+    }
+}
+
+// Pull at distance r of a unit mass smeared into a Gaussian of scale s:
+// the point-mass pull times erf(u) - 2u/sqrt(pi) exp(-u^2), u = r / 2s
+static double longRangePull(double r, double s) {
+    if (r <= 0.0) return 0.0;
+    double u = r / (2.0 * s);
+    return G * (std::erf(u) - 2.0 * u / SQRT_PI * std::exp(-u * u)) / (r * r);
+}
+
+static double longRangePotential(double r, double s) {
+    if (r <= 0.0) return -G / (s * SQRT_PI);
+    return -G * std::erf(r / (2.0 * s)) / r;
+}
+
+// The long-range shares of the pull and potential against r / s out to
+// the short-range cutoff, tabulated so the P3M pair loop skips erf and exp
+constexpr int SPLIT_TABLE_SIZE = 1024;
+
+struct SplitTable {
+    double scale;  // table steps per unit of r / s
+    double pull[SPLIT_TABLE_SIZE + 2];
+    double potential[SPLIT_TABLE_SIZE + 2];
+
+    explicit SplitTable(double range) : scale(SPLIT_TABLE_SIZE / range) {
+        for (int k = 0; k < SPLIT_TABLE_SIZE + 2; ++k) {
+            double u = 0.5 * k / scale;
+            pull[k] = std::erf(u) - 2.0 * u / SQRT_PI * std::exp(-u * u);
+            potential[k] = std::erf(u);
+        }
+    }
+};
+
+void ParticleMesh::set_size(int size) {
+    int rounded = MIN_SIZE;
+    while (rounded < size && rounded < MAX_SIZE) rounded *= 2;
+    if (rounded == this->size) return;
+    this->size = rounded;
+    twiddles.clear();
+    bitReverse.clear();
+    forceKernel.clear();
+    potentialKernel.clear();
+    kernelCellSize = 0.0;
+    potentialKernelReady = false;
+}
+
+void ParticleMesh::place(const ParticleSystem& particles) {
+    const Scalar* px = particles.pos_x();
+    const Scalar* py = particles.pos_y();
+    size_t n = particles.size();
+
+    double minX = px[0], maxX = px[0], minY = py[0], maxY = py[0];
+    for (size_t i = 1; i < n; ++i) {
+        minX = std::min(minX, double(px[i]));
+        maxX = std::max(maxX, double(px[i]));
+        minY = std::min(minY, double(py[i]));
+        maxY = std::max(maxY, double(py[i]));
+    }
+
+    // Three points of margin on each side keep every stencil on the grid
+    double extent = std::max(std::max(maxX - minX, maxY - minY), double(SOFTENING) * size);
+    double raw = extent * (1.0 + 2.0 * padding) / (size - 6);
+    cellSize = std::pow(2.0, std::ceil(std::log2(raw) * CELL_SIZE_STEPS) / CELL_SIZE_STEPS);
+    splitScale = SPLIT_CELLS * cellSize;
+
+    // Aligned to whole cells, so a scene that drifts keeps its kernels
+    originX = (std::floor(0.5 * (minX + maxX) / cellSize) - size / 2) * cellSize;
+    originY = (std::floor(0.5 * (minY + maxY) / cellSize) - size / 2) * cellSize;
+}
+
+int ParticleMesh::stencil(Scalar x, double origin, double weights[3]) const {
+    double g = (x - origin) / cellSize;
+    if (!(g >= 1.0)) g = 1.0;  // also catches NaN
+    if (g > size - 2.0) g = size - 2.0;
+
+    if (assignment == MeshAssignment::TriangularShapedCloud) {
+        double nearest = std::floor(g + 0.5);
+        double d = g - nearest;
+        weights[0] = 0.5 * (0.5 - d) * (0.5 - d);
+        weights[1] = 0.75 - d * d;
+        weights[2] = 0.5 * (0.5 + d) * (0.5 + d);
+        return static_cast<int>(nearest) - 1;
+    }
+
+    double first = std::floor(g);
+    weights[0] = 1.0 - (g - first);
+    weights[1] = g - first;
+    weights[2] = 0.0;
+    return static_cast<int>(first);
+}
+
+void ParticleMesh::transform(std::vector<Complex>& grid, bool inverse, int rows, ThreadPool& pool) const {
+    size_t n = padded();
+    Complex* data = grid.data();
+
+    auto transformRows = [&]() {
+        pool.parallel_for(rows, ROW_CHUNK, [&](size_t begin, size_t end) {
+            for (size_t row = begin; row < end; ++row)
+                fft(data + row * n, n, twiddles.data(), bitReverse.data(), inverse);
+        });
+    };
+
+    auto transformColumns = [&]() {
+        pool.parallel_for(n, COLUMN_BLOCK, [&](size_t begin, size_t end) {
+            size_t count = end - begin;
+            std::vector<Complex> columns(count * n);
+            for (size_t row = 0; row < n; ++row) {
+                for (size_t c = 0; c < count; ++c) columns[c * n + row] = data[row * n + begin + c];
+            }
+            for (size_t c = 0; c < count; ++c)
+                fft(columns.data() + c * n, n, twiddles.data(), bitReverse.data(), inverse);
+            for (size_t row = 0; row < n; ++row) {
+                for (size_t c = 0; c < count; ++c) data[row * n + begin + c] = columns[c * n + row];
+            }
+        });
+    };
+
+    // Rows past 'rows' are zero going in, or not needed coming out
+    if (inverse) {
+        transformColumns();
+        transformRows();
+    }
+    else {
+        transformRows();
+        transformColumns();
+    }
+}
+
+void ParticleMesh::fill_kernel(std::vector<Complex>& kernel, bool potential, ThreadPool& pool) {
+    int n = padded();
+    double scale = 1.0 / (double(n) * n);  // the inverse FFT's normalisation, applied once here
+    kernel.assign(size_t(n) * n, Complex(0.0, 0.0));
+
+    // Offsets past size wrap to negative ones; +-size itself is never needed
+    pool.parallel_for(n, ROW_CHUNK, [&](size_t begin, size_t end) {
+        for (size_t row = begin; row < end; ++row) {
+            int j = static_cast<int>(row);
+            if (j == size) continue;
+            double dy = (j < size ? j : j - n) * cellSize;
+            for (int i = 0; i < n; ++i) {
+                if (i == size) continue;
+                double dx = (i < size ? i : i - n) * cellSize;
+                double r = std::sqrt(dx * dx + dy * dy);
+                Complex& k = kernel[row * n + i];
+                if (potential) {
+                    k = Complex(longRangePotential(r, splitScale) * scale, 0.0);
+                }
+                else if (r > 0.0) {
+                    // Toward the mass, which sits at minus the offset
+                    double pull = longRangePull(r, splitScale) * scale / r;
+                    k = Complex(-pull * dx, -pull * dy);
+                }
+            }
+        }
+    });
+
+    transform(kernel, false, n, pool);
+}
+
+void ParticleMesh::build_kernels(ThreadPool& pool, bool withPotential) {
+    size_t n = padded();
+    if (twiddles.size() != n / 2) {
+        twiddles.resize(n / 2);
+        for (size_t k = 0; k < n / 2; ++k) twiddles[k] = std::polar(1.0, -2.0 * PI * double(k) / double(n));
+        bitReverse.resize(n);
+        int bits = 0;
+        while ((size_t(1) << bits) < n) ++bits;
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t reversed = 0;
+            for (int b = 0; b < bits; ++b) reversed |= ((i >> b) & 1u) << (bits - 1 - b);
+            bitReverse[i] = reversed;
+        }
+    }
+
+    if (cellSize != kernelCellSize) {
+        PROFILE_SCOPE("Mesh kernels");
+        fill_kernel(forceKernel, false, pool);
+        kernelCellSize = cellSize;
+        potentialKernelReady = false;
+        for (int a = 0; a < 3; ++a) {
+            for (int b = 0; b < 3; ++b) selfPotential[a][b] = longRangePotential(cellSize * std::sqrt(double(a * a + b * b)), splitScale);
+        }
+    }
+    if (withPotential && !potentialKernelReady) {
+        PROFILE_SCOPE("Mesh kernels");
+        fill_kernel(potentialKernel, true, pool);
+        potentialKernelReady = true;
+    }
+}
+
+void ParticleMesh::build(const ParticleSystem& particles, ThreadPool& pool, bool withPotential) {
+    PROFILE_SCOPE("Mesh solve");
+    masses = particles.masses();
+    radii = particles.radii();
+    hasPotential = false;
+    size_t count = particles.size();
+    if (count == 0) return;
+    if (size == 0) set_size(MIN_SIZE);
+
+    place(particles);
+    build_kernels(pool, withPotential);
+
+    const Scalar* px = particles.pos_x();
+    const Scalar* py = particles.pos_y();
+    size_t n = padded();
+    forceGrid.assign(n * n, Complex(0.0, 0.0));
+
+    // Serial so the sums, and so the forces, do not depend on the thread count
+    {
+        PROFILE_SCOPE("Mesh deposit");
+        for (size_t i = 0; i < count; ++i) {
+            if (masses[i] < passiveMass) continue;
+            double wx[3], wy[3];
+            int ix = stencil(px[i], originX, wx);
+            int iy = stencil(py[i], originY, wy);
+            for (int b = 0; b < 3; ++b) {
+                Complex* row = forceGrid.data() + (iy + b) * n + ix;
+                double mass = masses[i] * wy[b];
+                for (int a = 0; a < 3; ++a) row[a] += mass * wx[a];
+            }
+        }
+    }
+
+    transform(forceGrid, false, size, pool);
+    if (withPotential) potentialGrid = forceGrid;
+
+    pool.parallel_for(n, ROW_CHUNK, [&](size_t begin, size_t end) {
+        for (size_t k = begin * n; k < end * n; ++k) {
+            if (withPotential) potentialGrid[k] = multiply(potentialGrid[k], potentialKernel[k]);
+            forceGrid[k] = multiply(forceGrid[k], forceKernel[k]);
+        }
+    });
+
+    transform(forceGrid, true, size, pool);
+    if (withPotential) transform(potentialGrid, true, size, pool);
+    hasPotential = withPotential;
+
+    if (shortRange) {
+        PROFILE_SCOPE("Mesh neighbours");
+        pointX.clear();
+        pointY.clear();
+        pointBody.clear();
+        for (size_t i = 0; i < count; ++i) {
+            if (masses[i] < passiveMass) continue;
+            pointX.push_back(px[i]);
+            pointY.push_back(py[i]);
+            pointBody.push_back(static_cast<unsigned>(i));
+        }
+        pointRadius.assign(pointX.size(), 0.0f);
+        neighbours.build(pointX.data(), pointY.data(), pointRadius.data(), pointX.size(),
+            static_cast<float>(SHORT_RANGE_CELLS * cellSize));
+    }
+}
+
+template <bool WithPotential>
+Vector2s ParticleMesh::sample(Vector2s pos, float radius, size_t self, double& potential) const {
+    size_t n = padded();
+    double wx[3], wy[3];
+    int ix = stencil(pos.x, originX, wx);
+    int iy = stencil(pos.y, originY, wy);
+
+    double ax = 0.0, ay = 0.0, phi = 0.0;
+    for (int b = 0; b < 3; ++b) {
+        for (int a = 0; a < 3; ++a) {
+            double w = wx[a] * wy[b];
+            size_t k = (iy + b) * n + ix + a;
+            ax += w * forceGrid[k].real();
+            ay += w * forceGrid[k].imag();
+            if (WithPotential) phi += w * potentialGrid[k].real();
+        }
+    }
+
+    // An active particle's own mass is on the grid too. Its pull on itself
+    // cancels point by point, but its potential has to be taken out.
+    if (WithPotential && masses[self] >= passiveMass) {
+        double own = 0.0;
+        for (int b = 0; b < 3; ++b) {
+            for (int d = 0; d < 3; ++d) {
+                for (int a = 0; a < 3; ++a) {
+                    for (int c = 0; c < 3; ++c)
+                        own += wx[a] * wy[b] * wx[c] * wy[d] * selfPotential[std::abs(a - c)][std::abs(b - d)];
+                }
+            }
+        }
+        phi -= masses[self] * own;
+    }
+
+    if (shortRange) {
+        // What the mesh leaves out: the exact pull minus its long-range part
+        static const SplitTable split(SHORT_RANGE_CELLS / SPLIT_CELLS);
+        double cutoff = SHORT_RANGE_CELLS * cellSize;
+        double toTable = split.scale / splitScale;
+        int cx = neighbours.cell(pos.x);
+        int cy = neighbours.cell(pos.y);
+        for (int y = cy - 1; y <= cy + 1; ++y) {
+            for (int x = cx - 1; x <= cx + 1; ++x) {
+                size_t b = neighbours.bucket(x, y);
+                for (const SpatialHash::Entry* e = neighbours.bucket_begin(b); e != neighbours.bucket_end(b); ++e) {
+                    size_t body = pointBody[e->body];
+                    if (e->cx != x || e->cy != y || body == self) continue;
+                    Scalar dx = e->x - pos.x;
+                    Scalar dy = e->y - pos.y;
+                    double r = std::sqrt(double(dx) * dx + double(dy) * dy);
+                    if (r >= cutoff) continue;
+
+                    double t = r * toTable;
+                    int k = static_cast<int>(t);
+                    double f = t - k;
+
+                    Vector2s exact(0, 0);
+                    accumulatePull(exact, dx, dy, masses[body], radii[body] + radius);
+                    double gm = G * masses[body];
+                    double pull = r > 0.0 ? gm * (split.pull[k] + f * (split.pull[k + 1] - split.pull[k])) / (r * r * r) : 0.0;
+                    ax += exact.x - pull * dx;
+                    ay += exact.y - pull * dy;
+                    if (WithPotential) {
+                        double share = r > 0.0 ? (split.potential[k] + f * (split.potential[k + 1] - split.potential[k])) / r
+                            : 1.0 / (splitScale * SQRT_PI);
+                        phi += pullPotential(dx, dy, masses[body], radii[body] + radius) + gm * share;
+                    }
+                }
+            }
+        }
+    }
+
+    if (WithPotential) potential += phi;
+    return Vector2s(static_cast<Scalar>(ax), static_cast<Scalar>(ay));
+}
+
+Vector2s ParticleMesh::acceleration(Vector2s pos, float radius, size_t self) const {
+    double unused = 0.0;
+    return sample<false>(pos, radius, self, unused);
+}
+
+Vector2s ParticleMesh::acceleration(Vector2s pos, float radius, size_t self, double& potential) const {
+    if (!hasPotential) return acceleration(pos, radius, self);
+    return sample<true>(pos, radius, self, potential);
+}
+
+size_t ParticleMesh::memory_bytes() const {
+    size_t complexes = forceKernel.capacity() + potentialKernel.capacity() + forceGrid.capacity()
+        + potentialGrid.capacity() + twiddles.capacity();
+    return complexes * sizeof(Complex) + bitReverse.capacity() * sizeof(uint32_t)
+        + (pointX.capacity() + pointY.capacity()) * sizeof(Scalar) + pointRadius.capacity() * sizeof(float)
+        + pointBody.capacity() * sizeof(unsigned) + (shortRange ? neighbours.memory_bytes() : 0);
+}
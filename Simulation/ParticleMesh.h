@@ -0,0 +1,104 @@
+#ifndef SIMULATOR_PARTICLEMESH_H
+#define SIMULATOR_PARTICLEMESH_H
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "PhysicsSettings.h"
+#include "Scalar.h"
+#include "SpatialHash.h"
+
+class ParticleSystem;
+class ThreadPool;
+
+// Particle-mesh gravity. Particle masses are spread over a square grid
+// around the particles and convolved with the pull of a unit mass by FFT,
+// giving the acceleration at every grid point in O(G log G); particles
+// then read it back from the points around them. The grid is doubled and
+// zero-padded for the FFT, so distant particles are not pulled by copies
+// of the scene as a periodic solve would.
+//
+// The mesh carries only the long-range part of the pull, that of a mass
+// smeared into a Gaussian about one cell wide. Beyond a few cells this is
+// the exact pull; closer in it is softened. With short range on, the
+// remainder is added exactly from particles within SHORT_RANGE_CELLS (P3M).
+class ParticleMesh {
+private:
+    typedef std::complex<double> Complex;
+
+    static constexpr int MIN_SIZE = 16;
+    static constexpr int MAX_SIZE = 4096;
+    static constexpr double SPLIT_CELLS = 1.0;        // Gaussian scale of the long-range part
+    static constexpr double SHORT_RANGE_CELLS = 5.0;  // the rest is below 1% beyond this
+
+    int size = 0;  // grid points per side of the particle region; the FFT is twice this
+    float padding = 0.05f;
+    MeshAssignment assignment = MeshAssignment::CloudInCell;
+    bool shortRange = false;
+    float passiveMass = 0.0f;  // lighter particles are not deposited
+
+    // Grid placement for the current build
+    double cellSize = 0.0;
+    double originX = 0.0, originY = 0.0;  // world position of grid point (0, 0)
+    double splitScale = 0.0;              // Gaussian scale of the split, in world units
+
+    // FFT tables for the padded size
+    std::vector<Complex> twiddles;
+    std::vector<uint32_t> bitReverse;
+
+    // Transformed pull of a unit mass, acceleration as x + iy and potential.
+    // Rebuilt only when the padded size or the cell size changes.
+    std::vector<Complex> forceKernel;
+    std::vector<Complex> potentialKernel;
+    double kernelCellSize = 0.0;
+    bool potentialKernelReady = false;
+    double selfPotential[3][3];  // long-range potential of a unit mass at small grid offsets
+
+    std::vector<Complex> forceGrid;      // acceleration as x + iy per grid point
+    std::vector<Complex> potentialGrid;  // potential in the real part, when requested
+    bool hasPotential = false;
+
+    // Short-range neighbours, the particles that pull, held as points
+    SpatialHash neighbours;
+    std::vector<Scalar> pointX, pointY;
+    std::vector<float> pointRadius;
+    std::vector<unsigned> pointBody;  // particle index of each point
+    const float* masses = nullptr;  // of the particles last built from
+    const float* radii = nullptr;
+
+    int padded() const { return 2 * size; }
+    void place(const ParticleSystem& particles);
+    void build_kernels(ThreadPool& pool, bool withPotential);
+    void fill_kernel(std::vector<Complex>& kernel, bool potential, ThreadPool& pool);
+    template <bool WithPotential>
+    Vector2s sample(Vector2s pos, float radius, size_t self, double& potential) const;
+    void transform(std::vector<Complex>& grid, bool inverse, int rows, ThreadPool& pool) const;
+    int stencil(Scalar x, double origin, double weights[3]) const;
+
+public:
+    // Deposits every particle not lighter than the passive mass and solves
+    // for the long-range acceleration, and the potential too if asked. Reads
+    // the particles' masses again in acceleration(), so they must not change
+    // in between.
+    void build(const ParticleSystem& particles, ThreadPool& pool, bool withPotential);
+
+    // Acceleration felt at pos by a body of the given radius; 'self' is the
+    // querying particle, left out of the short-range sum
+    Vector2s acceleration(Vector2s pos, float radius, size_t self) const;
+
+    // Same, also adding the potential per unit mass at pos to 'potential'.
+    // 'self' must be at pos: its own share of the mesh potential is removed.
+    Vector2s acceleration(Vector2s pos, float radius, size_t self, double& potential) const;
+
+    size_t memory_bytes() const;
+
+    int get_size() const { return size; }
+    void set_size(int size);
+    void set_padding(float padding) { this->padding = padding; }
+    void set_assignment(MeshAssignment assignment) { this->assignment = assignment; }
+    void set_short_range(bool shortRange) { this->shortRange = shortRange; }
+    void set_passive_mass(float passiveMass) { this->passiveMass = passiveMass; }
+};
+
+#endif
@@ -0,0 +1,306 @@
+#include "ParticleSystem.h"
+#include <atomic>
+
+size_t ParticleSystem::add(Scalar pos_x, Scalar pos_y, Scalar vel_x, Scalar vel_y, ParticleType type) {
+    const ParticleTypeInfo& info = getParticleTypeInfo(type);
+
+    posX.push_back(pos_x);
+    posY.push_back(pos_y);
+    velX.push_back(vel_x);
+    velY.push_back(vel_y);
+    accX.push_back(0.0f);
+    accY.push_back(0.0f);
+    prevX.push_back(pos_x);
+    prevY.push_back(pos_y);
+    mass.push_back(info.mass);
+    radius.push_back(info.radius);
+    this->type.push_back(type);
+    stepLevel.push_back(0);
+    slotOf.push_back(acquire_slot(posX.size() - 1));
+    set_accelerations_valid(false);
+
+    return posX.size() - 1;
+}
+
+size_t ParticleSystem::append(size_t count, ParticleType type) {
+    const ParticleTypeInfo& info = getParticleTypeInfo(type);
+    size_t first = posX.size();
+    size_t total = first + count;
+
+    posX.resize(total, 0.0f);
+    posY.resize(total, 0.0f);
+    velX.resize(total, 0.0f);
+    velY.resize(total, 0.0f);
+    accX.resize(total, 0.0f);
+    accY.resize(total, 0.0f);
+    prevX.resize(total, 0.0f);
+    prevY.resize(total, 0.0f);
+    mass.resize(total, info.mass);
+    radius.resize(total, info.radius);
+    this->type.resize(total, type);
+    stepLevel.resize(total, 0);
+
+    // Free slots first, then fresh ones in one block
+    slotOf.reserve(total);
+    size_t i = first;
+    while (i < total && !freeSlots.empty()) slotOf.push_back(acquire_slot(i++));
+    uint32_t fresh = static_cast<uint32_t>(slotIndex.size());
+    slotIndex.resize(fresh + (total - i));
+    slotGeneration.resize(fresh + (total - i), 0);
+    for (uint32_t slot = fresh; i < total; ++i, ++slot) {
+        slotIndex[slot] = static_cast<uint32_t>(i);
+        slotOf.push_back(slot);
+    }
+    set_accelerations_valid(false);
+
+    return first;
+}
+
+void ParticleSystem::assign(size_t count, const Scalar* pos_x, const Scalar* pos_y, const Scalar* vel_x, const Scalar* vel_y,
+    const float* masses, const ParticleType* types, const float* radii) {
+    posX.assign(pos_x, pos_x + count);
+    posY.assign(pos_y, pos_y + count);
+    velX.assign(vel_x, vel_x + count);
+    velY.assign(vel_y, vel_y + count);
+    accX.assign(count, 0.0f);
+    accY.assign(count, 0.0f);
+    prevX = posX;
+    prevY = posY;
+    mass.assign(masses, masses + count);
+    type.assign(types, types + count);
+    stepLevel.assign(count, 0);
+
+    if (radii) {
+        radius.assign(radii, radii + count);
+    }
+    else {
+        radius.resize(count);
+        for (size_t i = 0; i < count; ++i) radius[i] = getParticleTypeInfo(types[i]).radius;
+    }
+
+    release_all_slots();
+    slotOf.resize(count);
+    for (size_t i = 0; i < count; ++i) slotOf[i] = acquire_slot(i);
+
+    set_accelerations_valid(false);
+}
+
+void ParticleSystem::reserve(size_t count) {
+    posX.reserve(count);
+    posY.reserve(count);
+    velX.reserve(count);
+    velY.reserve(count);
+    accX.reserve(count);
+    accY.reserve(count);
+    prevX.reserve(count);
+    prevY.reserve(count);
+    mass.reserve(count);
+    radius.reserve(count);
+    type.reserve(count);
+    stepLevel.reserve(count);
+    slotOf.reserve(count);
+    slotIndex.reserve(count);
+    slotGeneration.reserve(count);
+    freeSlots.reserve(count);
+}
+
+size_t ParticleSystem::capacity() const {
+    return posX.capacity();
+}
+
+void ParticleSystem::clear() {
+    posX.clear();
+    posY.clear();
+    velX.clear();
+    velY.clear();
+    accX.clear();
+    accY.clear();
+    prevX.clear();
+    prevY.clear();
+    mass.clear();
+    radius.clear();
+    type.clear();
+    stepLevel.clear();
+    release_all_slots();
+    set_accelerations_valid(false);
+}
+
+size_t ParticleSystem::size() const {
+    return posX.size();
+}
+
+bool ParticleSystem::empty() const {
+    return posX.empty();
+}
+
+size_t ParticleSystem::memory_bytes() const {
+    size_t scalars = posX.capacity() + posY.capacity() + velX.capacity() + velY.capacity()
+        + accX.capacity() + accY.capacity() + prevX.capacity() + prevY.capacity();
+    size_t floats = mass.capacity() + radius.capacity();
+    size_t slots = slotOf.capacity() + slotIndex.capacity() + slotGeneration.capacity() + freeSlots.capacity();
+    return scalars * sizeof(Scalar) + floats * sizeof(float) + type.capacity() * sizeof(ParticleType) + stepLevel.capacity()
+        + slots * sizeof(uint32_t) + integratorState.memory_bytes();
+}
+
+Vector2s ParticleSystem::get_pos(size_t i) const {
+    return Vector2s(posX[i], posY[i]);
+}
+
+Vector2s ParticleSystem::get_velocity(size_t i) const {
+    return Vector2s(velX[i], velY[i]);
+}
+
+float ParticleSystem::get_mass(size_t i) const {
+    return mass[i];
+}
+
+float ParticleSystem::get_radius(size_t i) const {
+    return radius[i];
+}
+
+ParticleType ParticleSystem::get_type(size_t i) const {
+    return type[i];
+}
+
+void ParticleSystem::set_pos(size_t i, Vector2s pos) {
+    posX[i] = pos.x;
+    posY[i] = pos.y;
+    prevX[i] = pos.x;
+    prevY[i] = pos.y;
+    set_accelerations_valid(false);
+}
+
+void ParticleSystem::save_positions() {
+    prevX = posX;
+    prevY = posY;
+}
+
+void ParticleSystem::set_velocity(size_t i, Vector2s velocity) {
+    velX[i] = velocity.x;
+    velY[i] = velocity.y;
+    editStamp = next_edit_stamp();
+}
+
+void ParticleSystem::set_mass(size_t i, float value) {
+    mass[i] = value;
+    set_accelerations_valid(false);
+}
+
+void ParticleSystem::set_radius(size_t i, float value) {
+    radius[i] = value;
+    set_accelerations_valid(false);
+}
+
+uint64_t ParticleSystem::next_edit_stamp() {
+    static std::atomic<uint64_t> lastStamp{ 0 };
+    return ++lastStamp;
+}
+
+uint32_t ParticleSystem::acquire_slot(size_t index) {
+    uint32_t slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else {
+        slot = static_cast<uint32_t>(slotIndex.size());
+        slotIndex.push_back(0);
+        slotGeneration.push_back(0);
+    }
+    slotIndex[slot] = static_cast<uint32_t>(index);
+    return slot;
+}
+
+void ParticleSystem::release_slot(uint32_t slot) {
+    ++slotGeneration[slot];
+    freeSlots.push_back(slot);
+}
+
+void ParticleSystem::release_all_slots() {
+    for (uint32_t slot : slotOf) release_slot(slot);
+    slotOf.clear();
+}
+
+ParticleHandle ParticleSystem::handle(size_t i) const {
+    ParticleHandle h;
+    h.slot = slotOf[i];
+    h.generation = slotGeneration[h.slot];
+    return h;
+}
+
+size_t ParticleSystem::index_of(ParticleHandle handle) const {
+    if (handle.slot >= slotGeneration.size() || slotGeneration[handle.slot] != handle.generation) return NO_BODY;
+    return slotIndex[handle.slot];
+}
+
+bool ParticleSystem::is_valid(ParticleHandle handle) const {
+    return index_of(handle) != NO_BODY;
+}
+
+template <typename T>
+static void swapRemove(std::vector<T>& values, size_t i) {
+    values[i] = values.back();
+    values.pop_back();
+}
+
+void ParticleSystem::remove(size_t i) {
+    release_slot(slotOf[i]);
+    slotIndex[slotOf.back()] = static_cast<uint32_t>(i);
+
+    swapRemove(posX, i);
+    swapRemove(posY, i);
+    swapRemove(velX, i);
+    swapRemove(velY, i);
+    swapRemove(accX, i);
+    swapRemove(accY, i);
+    swapRemove(prevX, i);
+    swapRemove(prevY, i);
+    swapRemove(mass, i);
+    swapRemove(radius, i);
+    swapRemove(type, i);
+    swapRemove(stepLevel, i);
+    swapRemove(slotOf, i);
+    set_accelerations_valid(false);
+}
+
+bool ParticleSystem::remove(ParticleHandle handle) {
+    size_t i = index_of(handle);
+    if (i == NO_BODY) return false;
+    remove(i);
+    return true;
+}
+
+// Shifts kept elements down over removed ones, order preserved
+template <typename T>
+static void compact(std::vector<T>& values, const std::vector<unsigned char>& removed) {
+    size_t kept = 0;
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (!removed[i]) values[kept++] = values[i];
+    }
+    values.resize(kept);
+}
+
+size_t ParticleSystem::remove_marked(const std::vector<unsigned char>& removed) {
+    size_t before = posX.size();
+    compact(posX, removed);
+    compact(posY, removed);
+    compact(velX, removed);
+    compact(velY, removed);
+    compact(accX, removed);
+    compact(accY, removed);
+    compact(prevX, removed);
+    compact(prevY, removed);
+    compact(mass, removed);
+    compact(radius, removed);
+    compact(type, removed);
+    compact(stepLevel, removed);
+
+    for (size_t i = 0; i < before; ++i) {
+        if (removed[i]) release_slot(slotOf[i]);
+    }
+    compact(slotOf, removed);
+    for (size_t i = 0; i < slotOf.size(); ++i) slotIndex[slotOf[i]] = static_cast<uint32_t>(i);
+
+    if (posX.size() != before) set_accelerations_valid(false);
+    return before - posX.size();
+}
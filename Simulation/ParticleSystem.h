@@ -0,0 +1,141 @@
+#ifndef SIMULATOR_PARTICLESYSTEM_H
+#define SIMULATOR_PARTICLESYSTEM_H
+
+#include <SFML/System/Vector2.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "IntegratorState.h"
+#include "Particle.h"
+#include "Scalar.h"
+
+// Index of no body: what index_of gives for a removed particle, and what
+// the nearest-particle and nearest-source queries give when none is in range
+constexpr size_t NO_BODY = SIZE_MAX;
+
+// Names one particle for as long as it exists. Indices move when other
+// particles are removed, a handle does not, and the handle of a removed
+// particle stays invalid after its slot is reused.
+struct ParticleHandle {
+    uint32_t slot = UINT32_MAX;
+    uint32_t generation = 0;
+};
+
+// Structure-of-arrays particle store. Each attribute lives in its own
+// contiguous array so the physics loops only stream the values they use;
+// colour and other render data come from the ParticleType table.
+// Kinematic state is Scalar, mass and radius always float.
+class ParticleSystem {
+private:
+    std::vector<Scalar> posX;
+    std::vector<Scalar> posY;
+    std::vector<Scalar> velX;
+    std::vector<Scalar> velY;
+    std::vector<Scalar> accX;   // acceleration from the last force pass
+    std::vector<Scalar> accY;
+    std::vector<Scalar> prevX;  // positions saved for render interpolation
+    std::vector<Scalar> prevY;
+    std::vector<float> mass;
+    std::vector<float> radius;
+    std::vector<ParticleType> type;
+    std::vector<unsigned char> stepLevel;  // block timestep bin, step = dt / 2^level
+    bool accelValid = false;   // false until a force pass has seen every particle
+    uint64_t editStamp = next_edit_stamp();
+    IntegratorState integratorState;
+
+    // Slot map behind the handles; the arrays above stay dense
+    std::vector<uint32_t> slotOf;          // per particle, its handle slot
+    std::vector<uint32_t> slotIndex;       // per slot, its particle's index
+    std::vector<uint32_t> slotGeneration;  // bumped when the slot's particle is removed
+    std::vector<uint32_t> freeSlots;
+
+    uint32_t acquire_slot(size_t index);
+    void release_slot(uint32_t slot);
+    void release_all_slots();
+    static uint64_t next_edit_stamp();
+
+public:
+    size_t add(Scalar pos_x, Scalar pos_y, Scalar vel_x, Scalar vel_y, ParticleType type);
+    // Grows by 'count' particles of one type at rest at (0, 0) for the
+    // caller to fill through the raw arrays, previous positions included.
+    // Returns the index of the first.
+    size_t append(size_t count, ParticleType type);
+    // Replaces the contents with 'count' particles copied from the given
+    // arrays. Without radii, radius comes from the type table.
+    void assign(size_t count, const Scalar* pos_x, const Scalar* pos_y, const Scalar* vel_x, const Scalar* vel_y,
+        const float* masses, const ParticleType* types, const float* radii = nullptr);
+    // Reserving up front keeps spawning from reallocating every array
+    void reserve(size_t count);
+    size_t capacity() const;
+    void clear();
+
+    size_t size() const;
+    bool empty() const;
+    size_t memory_bytes() const;  // heap held by the arrays, including spare capacity
+
+    Vector2s get_pos(size_t i) const;
+    Vector2s get_velocity(size_t i) const;
+    float get_mass(size_t i) const;
+    float get_radius(size_t i) const;
+    ParticleType get_type(size_t i) const;
+
+    void set_pos(size_t i, Vector2s pos);
+    void set_velocity(size_t i, Vector2s velocity);
+    void set_mass(size_t i, float mass);
+    void set_radius(size_t i, float radius);
+
+    ParticleHandle handle(size_t i) const;
+    // Current index of the particle, NO_BODY once it has been removed
+    size_t index_of(ParticleHandle handle) const;
+    bool is_valid(ParticleHandle handle) const;
+
+    // O(1): the last particle moves into the gap, so only its index changes
+    void remove(size_t i);
+    bool remove(ParticleHandle handle);
+    // Drops every particle with removed[i] != 0, keeping the others in
+    // order. Returns how many were removed.
+    size_t remove_marked(const std::vector<unsigned char>& removed);
+
+    // Remembers current positions as the "previous" render state
+    void save_positions();
+
+    // Cached accelerations are reused as the first kick of the next step
+    bool accelerations_valid() const { return accelValid; }
+    void set_accelerations_valid(bool valid) {
+        accelValid = valid;
+        if (!valid) editStamp = next_edit_stamp();
+    }
+
+    // Changes whenever particles are added, removed or edited rather than
+    // stepped, and differs between systems built separately, so caches built
+    // from the particles key on it. Code editing the raw arrays invalidates
+    // the accelerations, which counts as an edit.
+    uint64_t edit_stamp() const { return editStamp; }
+
+    IntegratorState& integrator_state() { return integratorState; }
+
+    // Raw arrays for the hot loops
+    Scalar* pos_x() { return posX.data(); }
+    Scalar* pos_y() { return posY.data(); }
+    Scalar* vel_x() { return velX.data(); }
+    Scalar* vel_y() { return velY.data(); }
+    Scalar* acc_x() { return accX.data(); }
+    Scalar* acc_y() { return accY.data(); }
+    const Scalar* pos_x() const { return posX.data(); }
+    const Scalar* pos_y() const { return posY.data(); }
+    const Scalar* vel_x() const { return velX.data(); }
+    const Scalar* vel_y() const { return velY.data(); }
+    const Scalar* acc_x() const { return accX.data(); }
+    const Scalar* acc_y() const { return accY.data(); }
+    Scalar* prev_x() { return prevX.data(); }
+    Scalar* prev_y() { return prevY.data(); }
+    const Scalar* prev_x() const { return prevX.data(); }
+    const Scalar* prev_y() const { return prevY.data(); }
+    const float* masses() const { return mass.data(); }
+    const float* radii() const { return radius.data(); }
+    const ParticleType* types() const { return type.data(); }
+    unsigned char* step_levels() { return stepLevel.data(); }
+    const unsigned char* step_levels() const { return stepLevel.data(); }
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef SIMULATOR_PHYSICSSETTINGS_H
+#define SIMULATOR_PHYSICSSETTINGS_H
+
+// Which force solver handles mutual gravity between particles
+enum class GravitySolver {
+    DirectSum,    // O(N^2), exact - accuracy reference
+    BarnesHut,    // O(N log N), quadtree approximation
+    ParticleMesh  // O(N + G log G), FFT on a grid of G cells; softened below a few cells
+};
+
+// How the particle-mesh solver spreads a particle over grid points
+enum class MeshAssignment {
+    CloudInCell,           // 2x2 points, linear weights
+    TriangularShapedCloud  // 3x3 points, quadratic weights; smoother forces, more work
+};
+
+// Instruction set used by the direct-sum kernels, lowest to highest
+enum class SimdLevel {
+    Scalar,
+    SSE,
+    AVX2
+};
+
+// Time integration scheme for updateParticles
+enum class Integrator {
+    Leapfrog,  // kick-drift-kick, 2nd order, one force pass per step
+    Yoshida4,  // Forest-Ruth / Yoshida triple jump, 4th order, three force passes per step
+    RK45       // Dormand-Prince 5(4) with adaptive substeps; not symplectic, accuracy reference
+};
+
+// What happens when two particles touch
+enum class CollisionResponse {
+    None,    // pass through each other
+    Merge,   // perfectly inelastic: one body with the summed mass and momentum
+    Bounce   // elastic bounce, scaled by restitution
+};
+
+// Runtime-tunable physics options passed to updateParticles
+struct PhysicsSettings {
+    float dt = 1.5f;  // simulated time per updateParticles call
+    GravitySolver solver = GravitySolver::DirectSum;
+    float theta = 0.5f;  // Barnes-Hut opening angle, 0 = exact, larger = faster but coarser
+    int meshSize = 512;  // particle mesh: grid points per side, rounded up to a power of two
+    float meshPadding = 0.05f;  // particle mesh: margin around the particles, as a fraction of their extent
+    MeshAssignment meshAssignment = MeshAssignment::CloudInCell;
+    // Particle mesh: adds the exact force from particles within a few cells (P3M),
+    // so close encounters are no longer softened; costs a neighbour search
+    bool meshShortRange = false;
+    // Mutual gravity: particles lighter than this are passive. They feel sources and the
+    // other particles but pull on nothing, so the pass costs O(N * active). 0 = all active.
+    // Momentum between active and passive particles is no longer conserved.
+    float passiveMass = 0.0f;
+    // Sources' pull read from a cached, interpolated field instead of summed per
+    // particle; exact again near surfaces. Pays off with many sources
+    bool sourceField = false;
+    // Without mutual gravity: particles on closed orbits that the radii and the other
+    // sources bend by less than keplerTolerance of the pull move in closed form, the
+    // rest are integrated. Enables warpParticles' single-jump time warp
+    bool keplerOrbits = false;
+    float keplerTolerance = 0.01f;
+    unsigned threadCount = 0;  // worker threads for the force pass, 0 = all hardware threads
+    SimdLevel simd = SimdLevel::AVX2;  // upper limit, capped by what the CPU supports
+    Integrator integrator = Integrator::Leapfrog;
+    float rk45Tolerance = 1.0e-4f;  // RK45 only: position error allowed per substep, in px
+    // Block timesteps (leapfrog only): particles in close encounters take dt / 2^k substeps.
+    // More accurate orbits near dense sources; momentum between particles on
+    // different levels is no longer conserved exactly, so they are off by default.
+    bool blockTimesteps = false;
+    int maxStepLevel = 6;        // finest block is dt / 2^maxStepLevel
+    float stepAccuracy = 0.05f;  // block step as a fraction of each particle's orbital timescale
+    CollisionResponse collisions = CollisionResponse::None;
+    float restitution = 1.0f;        // bounce only: 1 = elastic, 0 = stick
+    bool absorbIntoSources = false;  // particles touching a source are swallowed and add their mass to it
+};
+
+#endif
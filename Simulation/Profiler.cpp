@@ -0,0 +1,183 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+Profiler profiler;
+
+static double toMs(Profiler::Clock::duration d) {
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+static long long toUs(Profiler::Clock::duration d) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+// Rolling min/avg/p99 of the filled part of a ring
+static PhaseStats statsOf(const char* name, const std::vector<double>& ring) {
+    PhaseStats stats;
+    stats.name = name;
+    stats.frames = ring.size();
+    if (ring.empty()) return stats;
+
+    std::vector<double> sorted(ring);
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0.0;
+    for (double v : sorted) sum += v;
+    size_t p99 = (sorted.size() * 99 + 99) / 100 - 1;
+
+    stats.minMs = sorted.front();
+    stats.avgMs = sum / sorted.size();
+    stats.p99Ms = sorted[std::min(p99, sorted.size() - 1)];
+    return stats;
+}
+
+static void pushRing(std::vector<double>& ring, size_t& next, double value) {
+    if (ring.size() < static_cast<size_t>(Profiler::WINDOW_FRAMES)) {
+        ring.push_back(value);
+    }
+    else {
+        ring[next] = value;
+    }
+    next = (next + 1) % Profiler::WINDOW_FRAMES;
+}
+
+int Profiler::register_phase(const char* name) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Scopes in different places may share a phase
+    for (size_t i = 0; i < phases.size(); ++i) {
+        if (std::strcmp(phases[i].name, name) == 0) return static_cast<int>(i);
+    }
+
+    Phase phase;
+    phase.name = name;
+    phases.push_back(phase);
+    return static_cast<int>(phases.size() - 1);
+}
+
+void Profiler::record(int phase, Clock::time_point start, Clock::time_point end) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Phase& p = phases[phase];
+    p.frameMs += toMs(end - start);
+    p.ranThisFrame = true;
+
+    if (!tracing) return;
+    if (trace.size() >= MAX_TRACE_EVENTS) {
+        ++traceDropped;
+        return;
+    }
+
+    std::thread::id id = std::this_thread::get_id();
+    auto found = std::find(traceThreads.begin(), traceThreads.end(), id);
+    int thread = static_cast<int>(found - traceThreads.begin());
+    if (found == traceThreads.end()) traceThreads.push_back(id);
+
+    TraceEvent event = { phase, thread, toUs(start - traceStart), toUs(end - start) };
+    trace.push_back(event);
+}
+
+void Profiler::end_frame(size_t particleCount) {
+    if (!is_enabled()) return;
+
+    Clock::time_point now = Clock::now();
+    std::lock_guard<std::mutex> lock(mutex);
+    if (hasLastFrame) pushRing(frameHistory, frameNext, toMs(now - lastFrameEnd));
+    lastFrameEnd = now;
+    hasLastFrame = true;
+    this->particleCount = particleCount;
+
+    for (auto& p : phases) {
+        if (!p.ranThisFrame) continue;
+        pushRing(p.history, p.next, p.frameMs);
+        p.frameMs = 0.0;
+        p.ranThisFrame = false;
+    }
+}
+
+void Profiler::start_trace() {
+    std::lock_guard<std::mutex> lock(mutex);
+    trace.clear();
+    traceThreads.clear();
+    traceDropped = 0;
+    traceStart = Clock::now();
+    tracing = true;
+}
+
+bool Profiler::stop_trace(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    tracing = false;
+
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Failed to open " << path << "\n";
+        return false;
+    }
+
+    // Complete ("X") events; timestamps are microseconds from start_trace
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    for (size_t i = 0; i < traceThreads.size(); ++i) {
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i
+            << ",\"args\":{\"name\":\"thread " << i << "\"}},\n";
+    }
+    for (size_t i = 0; i < trace.size(); ++i) {
+        const TraceEvent& e = trace[i];
+        out << "{\"name\":\"" << phases[e.phase].name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.thread
+            << ",\"ts\":" << e.startUs << ",\"dur\":" << e.durationUs << "}" << (i + 1 < trace.size() ? "," : "") << "\n";
+    }
+    out << "]}\n";
+
+    if (traceDropped > 0)
+        std::cerr << path << ": trace buffer full, " << traceDropped << " events dropped\n";
+    trace.clear();
+    trace.shrink_to_fit();
+    return true;
+}
+
+bool Profiler::is_tracing() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return tracing;
+}
+
+std::vector<PhaseStats> Profiler::get_phase_stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<PhaseStats> stats;
+    for (const auto& p : phases) stats.push_back(statsOf(p.name, p.history));
+    return stats;
+}
+
+PhaseStats Profiler::get_frame_stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return statsOf("Frame", frameHistory);
+}
+
+void Profiler::get_frame_histogram(int counts[HISTOGRAM_BINS]) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::fill(counts, counts + HISTOGRAM_BINS, 0);
+    for (double ms : frameHistory) {
+        int bin = static_cast<int>(ms / HISTOGRAM_BIN_MS);
+        ++counts[std::min(std::max(bin, 0), HISTOGRAM_BINS - 1)];
+    }
+}
+
+size_t Profiler::get_particle_count() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return particleCount;
+}
+
+void Profiler::set_enabled(bool enabled) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->enabled.store(enabled, std::memory_order_relaxed);
+
+    // Start the next window clean rather than with the time spent disabled
+    hasLastFrame = false;
+    frameHistory.clear();
+    frameNext = 0;
+    for (auto& p : phases) {
+        p.history.clear();
+        p.next = 0;
+        p.frameMs = 0.0;
+        p.ranThisFrame = false;
+    }
+}
@@ -0,0 +1,126 @@
+#ifndef SIMULATOR_PROFILER_H
+#define SIMULATOR_PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Per-phase timers for the main loop and the force solver.
+// PROFILE_SCOPE("Name") times the rest of the enclosing block under that
+// phase; PROFILE_END_FRAME(particles) closes a frame. Without
+// SIMULATOR_PROFILING both compile to nothing. With it, a scope costs one
+// flag check while the profiler is off, and two clock reads and a short
+// locked update while it is on. Nested scopes each count their full time.
+
+// Rolling statistics of one phase, per frame it ran in
+struct PhaseStats {
+    const char* name = "";
+    double minMs = 0.0;
+    double avgMs = 0.0;
+    double p99Ms = 0.0;
+    size_t frames = 0;  // frames in the window that ran the phase
+};
+
+class Profiler {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    static constexpr int WINDOW_FRAMES = 240;
+    static constexpr int HISTOGRAM_BINS = 20;
+    static constexpr double HISTOGRAM_BIN_MS = 2.0;  // the last bin also takes anything slower
+    static constexpr size_t MAX_TRACE_EVENTS = 2000000;
+
+private:
+    struct Phase {
+        const char* name;
+        double frameMs = 0.0;  // summed over this frame's calls
+        bool ranThisFrame = false;
+        std::vector<double> history;  // ring of per-frame totals
+        size_t next = 0;
+    };
+
+    struct TraceEvent {
+        int phase;
+        int thread;
+        long long startUs;
+        long long durationUs;
+    };
+
+    mutable std::mutex mutex;
+    std::atomic<bool> enabled{ false };
+    std::vector<Phase> phases;
+
+    std::vector<double> frameHistory;  // ring of frame times
+    size_t frameNext = 0;
+    Clock::time_point lastFrameEnd;
+    bool hasLastFrame = false;
+    size_t particleCount = 0;
+
+    bool tracing = false;
+    Clock::time_point traceStart;
+    std::vector<TraceEvent> trace;
+    std::vector<std::thread::id> traceThreads;  // index is the trace's tid
+    size_t traceDropped = 0;
+
+public:
+    // Phase ids are handed out once per PROFILE_SCOPE site
+    int register_phase(const char* name);
+
+    void record(int phase, Clock::time_point start, Clock::time_point end);
+    void end_frame(size_t particleCount);
+
+    // Chrome trace (chrome://tracing, Perfetto) of every scope while
+    // recording; stop writes it and reports problems on std::cerr
+    void start_trace();
+    bool stop_trace(const std::string& path);
+    bool is_tracing() const;
+
+    std::vector<PhaseStats> get_phase_stats() const;
+    PhaseStats get_frame_stats() const;
+    void get_frame_histogram(int counts[HISTOGRAM_BINS]) const;
+    size_t get_particle_count() const;
+
+    bool is_enabled() const { return enabled.load(std::memory_order_relaxed); }
+    void set_enabled(bool enabled);
+};
+
+extern Profiler profiler;
+
+class ProfileScope {
+private:
+    int phase;
+    Profiler::Clock::time_point start;
+
+public:
+    explicit ProfileScope(int phase)
+        : phase(profiler.is_enabled() ? phase : -1)
+    {
+        if (this->phase >= 0) start = Profiler::Clock::now();
+    }
+
+    ~ProfileScope() {
+        if (phase >= 0) profiler.record(phase, start, Profiler::Clock::now());
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
+#define SIMULATOR_PROFILE_JOIN2(a, b) a##b
+#define SIMULATOR_PROFILE_JOIN(a, b) SIMULATOR_PROFILE_JOIN2(a, b)
+
+#ifdef SIMULATOR_PROFILING
+#define PROFILE_SCOPE(name) \
+    static const int SIMULATOR_PROFILE_JOIN(profilePhase, __LINE__) = profiler.register_phase(name); \
+    ProfileScope SIMULATOR_PROFILE_JOIN(profileScope, __LINE__)(SIMULATOR_PROFILE_JOIN(profilePhase, __LINE__))
+#define PROFILE_END_FRAME(particleCount) profiler.end_frame(particleCount)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_END_FRAME(particleCount) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,190 @@
+#include "QuadTree.h"
+#include "Gravity.h"
+#include "ParticleSystem.h"
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+QuadTree::QuadTree(float theta)
+    : theta(theta)
+{
+}
+
+void QuadTree::build(const ParticleSystem& particles, float passiveMass) {
+    nodes.clear();
+    bodies.clear();
+    if (particles.empty()) return;
+
+    const Scalar* px = particles.pos_x();
+    const Scalar* py = particles.pos_y();
+    const float* m = particles.masses();
+    const float* r = particles.radii();
+    size_t n = particles.size();
+
+    // Square root cell that encloses every particle that pulls
+    Vector2s minPos(std::numeric_limits<Scalar>::max(), std::numeric_limits<Scalar>::max());
+    Vector2s maxPos = -minPos;
+    bodies.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        if (m[i] < passiveMass) continue;
+        minPos.x = std::min(minPos.x, px[i]);
+        minPos.y = std::min(minPos.y, py[i]);
+        maxPos.x = std::max(maxPos.x, px[i]);
+        maxPos.y = std::max(maxPos.y, py[i]);
+        bodies.push_back({ Vector2s(px[i], py[i]), m[i], r[i], static_cast<int>(i), -1 });
+    }
+    if (bodies.empty()) return;
+
+    Scalar halfSize = Scalar(0.5) * std::max(maxPos.x - minPos.x, maxPos.y - minPos.y) + 1;
+    Vector2s center((minPos.x + maxPos.x) * Scalar(0.5), (minPos.y + maxPos.y) * Scalar(0.5));
+
+    nodes.reserve(bodies.size() * 2);
+    nodes.push_back({ center, halfSize, Vector2s(0, 0), 0.0f, 0.0f, 0.0f, std::numeric_limits<float>::max(), -1, -1 });
+
+    for (int i = 0; i < static_cast<int>(bodies.size()); ++i) {
+        insert(0, i, 0);
+    }
+
+    // Turn mass-weighted sums into centres of mass and mean radii
+    for (auto& node : nodes) {
+        if (node.mass > 0.0f) {
+            node.com /= Scalar(node.mass);
+            node.radius /= node.mass;
+        }
+    }
+}
+
+int QuadTree::childFor(const Node& node, Vector2s pos) const {
+    int quadrant = 0;
+    if (pos.x >= node.center.x) quadrant |= 1;
+    if (pos.y >= node.center.y) quadrant |= 2;
+    return node.firstChild + quadrant;
+}
+
+void QuadTree::subdivide(int node) {
+    int first = static_cast<int>(nodes.size());
+    Vector2s center = nodes[node].center;
+    Scalar quarter = nodes[node].halfSize * Scalar(0.5);
+
+    for (int quadrant = 0; quadrant < 4; ++quadrant) {
+        Vector2s childCenter(
+            center.x + ((quadrant & 1) ? quarter : -quarter),
+            center.y + ((quadrant & 2) ? quarter : -quarter)
+        );
+        nodes.push_back({ childCenter, quarter, Vector2s(0, 0), 0.0f, 0.0f, 0.0f, std::numeric_limits<float>::max(), -1, -1 });
+    }
+
+    // push_back may have reallocated, so index again
+    nodes[node].firstChild = first;
+}
+
+void QuadTree::insert(int node, int body, int depth) {
+    const Body& b = bodies[body];
+
+    // Every cell on the way down accumulates the body
+    nodes[node].mass += b.mass;
+    nodes[node].com += b.pos * Scalar(b.mass);
+    nodes[node].radius += b.radius * b.mass;
+    nodes[node].maxRadius = std::max(nodes[node].maxRadius, b.radius);
+    nodes[node].minRadius = std::min(nodes[node].minRadius, b.radius);
+
+    if (nodes[node].firstChild != -1) {
+        insert(childFor(nodes[node], b.pos), body, depth + 1);
+        return;
+    }
+
+    if (nodes[node].body == -1) {
+        nodes[node].body = body;
+        return;
+    }
+
+    // Coincident or nearly coincident bodies: stop splitting and chain them
+    if (depth >= MAX_DEPTH) {
+        bodies[body].next = nodes[node].body;
+        nodes[node].body = body;
+        return;
+    }
+
+    // Occupied leaf: split and push both bodies one level down
+    int existing = nodes[node].body;
+    nodes[node].body = -1;
+    subdivide(node);
+    insert(childFor(nodes[node], bodies[existing].pos), existing, depth + 1);
+    insert(childFor(nodes[node], b.pos), body, depth + 1);
+}
+
+// One walk for both queries; the potential terms compile away when unused
+template <bool WithPotential>
+Vector2s QuadTree::walk(Vector2s pos, float radius, int self, double& potential) const {
+    Vector2s accel(0, 0);
+    if (nodes.empty()) return accel;
+
+    int stack[4 * MAX_DEPTH + 4];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        if (node.mass <= 0.0f) continue;
+
+        if (node.firstChild == -1) {
+            // Leaf: exact pairwise pull, same as the direct-sum kernel
+            for (int i = node.body; i != -1; i = bodies[i].next) {
+                const Body& b = bodies[i];
+                if (b.particle == self) continue;
+                accumulatePull(accel, b.pos.x - pos.x, b.pos.y - pos.y, b.mass, b.radius + radius);
+                if (WithPotential) potential += pullPotential(b.pos.x - pos.x, b.pos.y - pos.y, b.mass, b.radius + radius);
+            }
+            continue;
+        }
+
+        Scalar dx = node.com.x - pos.x;
+        Scalar dy = node.com.y - pos.y;
+        Scalar dist = std::sqrt(dx * dx + dy * dy + Scalar(SOFTENING * SOFTENING));
+
+        // A cell that contains the query point is never far enough away
+        bool inside = std::abs(pos.x - node.center.x) <= node.halfSize
+            && std::abs(pos.y - node.center.y) <= node.halfSize;
+
+        // Distance between the surfaces, and how far any body's may be off it:
+        // its offset from the centre of mass, up to the cell's diagonal, plus
+        // the spread of the radii
+        Scalar surfaceDist = dist - node.maxRadius - radius;
+        Scalar spread = Scalar(2.8284271) * node.halfSize + (node.maxRadius - node.minRadius);
+
+        // Far enough that the cell's size and radii barely change the pull,
+        // and that no body of it is near the softening clamp, where it bends
+        if (!inside && spread < theta * surfaceDist && surfaceDist - spread > Scalar(SOFTENING)) {
+            // Far cell: treat as a single body at its centre of mass
+            accumulatePull(accel, dx, dy, node.mass, node.radius + radius);
+            if (WithPotential) potential += pullPotential(dx, dy, node.mass, node.radius + radius);
+        }
+        else {
+            for (int quadrant = 0; quadrant < 4; ++quadrant)
+                stack[top++] = node.firstChild + quadrant;
+        }
+    }
+
+    return accel;
+}
+
+Vector2s QuadTree::acceleration(Vector2s pos, float radius, int self) const {
+    double unused = 0.0;
+    return walk<false>(pos, radius, self, unused);
+}
+
+Vector2s QuadTree::acceleration(Vector2s pos, float radius, int self, double& potential) const {
+    return walk<true>(pos, radius, self, potential);
+}
+
+size_t QuadTree::memory_bytes() const {
+    return nodes.capacity() * sizeof(Node) + bodies.capacity() * sizeof(Body);
+}
+
+float QuadTree::get_theta() const {
+    return theta;
+}
+
+void QuadTree::set_theta(float theta) {
+    this->theta = theta;
+}
@@ -0,0 +1,72 @@
+#ifndef SIMULATOR_QUADTREE_H
+#define SIMULATOR_QUADTREE_H
+
+#include <cstddef>
+#include <vector>
+#include "Scalar.h"
+
+class ParticleSystem;
+
+// Barnes-Hut quadtree over particle positions and masses.
+// Rebuilt from scratch every step; distant cells are approximated
+// by a single body at their centre of mass, with the mass-weighted
+// radius of its bodies so the pull matches the pairwise one. The
+// opening test measures from the surfaces, since both radii shorten
+// the effective distance, and counts the spread of the radii as cell
+// size. Cells with a body that may be near the softening clamp, where
+// the pull stops following the distance, are always opened.
+class QuadTree {
+private:
+    struct Node {
+        Vector2s center;       // geometric centre of the cell
+        Scalar halfSize;
+        Vector2s com;          // centre of mass (mass-weighted sum while building)
+        float mass;
+        float radius;          // mass-weighted radius (sum while building)
+        float maxRadius;       // largest radius of its bodies
+        float minRadius;       // smallest
+        int firstChild;        // index of the first of four children, -1 for a leaf
+        int body;              // first body held by a leaf, -1 if empty
+    };
+
+    struct Body {
+        Vector2s pos;
+        float mass;
+        float radius;
+        int particle;          // index in the ParticleSystem
+        int next;              // next body in the same leaf (only at MAX_DEPTH)
+    };
+
+    static constexpr int MAX_DEPTH = 32;
+
+    std::vector<Node> nodes;
+    std::vector<Body> bodies;
+    float theta;
+
+    void insert(int node, int body, int depth);
+    void subdivide(int node);
+    int childFor(const Node& node, Vector2s pos) const;
+
+    template <bool WithPotential>
+    Vector2s walk(Vector2s pos, float radius, int self, double& potential) const;
+
+public:
+    explicit QuadTree(float theta = 0.5f);
+
+    // Particles lighter than passiveMass are left out: they pull on nothing
+    void build(const ParticleSystem& particles, float passiveMass = 0.0f);
+
+    // Acceleration felt at pos by a body of the given radius.
+    // 'self' is the index of the querying particle so it does not attract itself.
+    Vector2s acceleration(Vector2s pos, float radius, int self) const;
+
+    // Same, also adding the potential per unit mass at pos to 'potential'
+    Vector2s acceleration(Vector2s pos, float radius, int self, double& potential) const;
+
+    size_t memory_bytes() const;
+
+    float get_theta() const;
+    void set_theta(float theta);
+};
+
+#endif
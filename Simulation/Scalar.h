@@ -0,0 +1,24 @@
+#ifndef SIMULATOR_SCALAR_H
+#define SIMULATOR_SCALAR_H
+
+#include <SFML/System/Vector2.hpp>
+
+// Precision of the simulation state: positions, velocities and
+// accelerations of particles and sources. Masses, radii and rendering
+// stay float. Define SIMULATOR_DOUBLE_PRECISION in every project that
+// includes the simulation headers to switch the whole build to double;
+// float positions lose sub-pixel precision a few million pixels out.
+#ifdef SIMULATOR_DOUBLE_PRECISION
+typedef double Scalar;
+#else
+typedef float Scalar;
+#endif
+
+typedef sf::Vector2<Scalar> Vector2s;
+
+// Render-side conversion; a no-op in float builds
+inline sf::Vector2f toRender(Vector2s v) {
+    return sf::Vector2f(static_cast<float>(v.x), static_cast<float>(v.y));
+}
+
+#endif
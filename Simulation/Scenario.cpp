@@ -0,0 +1,153 @@
+#include "Scenario.h"
+#include "Generators.h"
+#include "Simulation.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static const char* particleTypeNames[] = { "Planetoid", "Satellite", "Terrestrial", "GasGiant", "IceGiant" };
+static const char* sourceTypeNames[] = { "RedDwarf", "WhiteDwarf", "YellowDwarf", "NeutronStar" };
+
+bool parseParticleType(const std::string& name, ParticleType& type) {
+    for (int i = 0; i < 5; ++i) {
+        if (name == particleTypeNames[i]) {
+            type = static_cast<ParticleType>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parseSourceType(const std::string& name, GravitySourceType& type) {
+    for (int i = 0; i < 4; ++i) {
+        if (name == sourceTypeNames[i]) {
+            type = static_cast<GravitySourceType>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* particleTypeName(ParticleType type) {
+    return particleTypeNames[static_cast<int>(type)];
+}
+
+const char* sourceTypeName(GravitySourceType type) {
+    return sourceTypeNames[static_cast<int>(type)];
+}
+
+bool loadScenario(const std::string& path, Scenario& scenario) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Failed to open scenario " << path << "\n";
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    uint64_t seed = 1;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) line.erase(comment);
+
+        std::istringstream in(line);
+        std::string keyword;
+        if (!(in >> keyword)) continue;
+        uint64_t lineSeed = seed * 1000003u + static_cast<uint64_t>(lineNumber);
+
+        std::string typeName;
+        Scalar x, y;
+
+        if (keyword == "source") {
+            GravitySourceType type;
+            if (!(in >> typeName >> x >> y) || !parseSourceType(typeName, type)) {
+                std::cerr << path << ":" << lineNumber << ": expected 'source <type> <x> <y>'\n";
+                return false;
+            }
+            scenario.sources.emplace_back(x, y, type);
+        }
+        else if (keyword == "particle") {
+            ParticleType type;
+            if (!(in >> typeName >> x >> y) || !parseParticleType(typeName, type)) {
+                std::cerr << path << ":" << lineNumber << ": expected 'particle <type> <x> <y> [<vx> <vy>]'\n";
+                return false;
+            }
+
+            Scalar vx, vy;
+            if (in >> vx >> vy) {
+                scenario.particles.add(x, y, vx, vy, type);
+            }
+            else {
+                size_t source = findNearestSource(Vector2s(x, y), scenario.sources);
+                if (source == NO_BODY) {
+                    std::cerr << path << ":" << lineNumber << ": particle without velocity needs a source before it\n";
+                    return false;
+                }
+                addParticlesAtPosition(scenario.particles, Vector2s(x, y), 1, 0, type, scenario.sources[source]);
+            }
+        }
+        else if (keyword == "disk" || keyword == "belt" || keyword == "binaries") {
+            if (scenario.sources.empty()) {
+                std::cerr << path << ":" << lineNumber << ": " << keyword << " needs a source before it\n";
+                return false;
+            }
+            const GravitySource& source = scenario.sources.back();
+
+            if (keyword == "disk") {
+                DiskSpec spec;
+                if (!(in >> typeName >> spec.count >> spec.innerRadius >> spec.outerRadius) || !parseParticleType(typeName, spec.type)) {
+                    std::cerr << path << ":" << lineNumber << ": expected 'disk <type> <count> <inner> <outer>'\n";
+                    return false;
+                }
+                spec.selfGravity = scenario.mutualGravity;
+                generateDisk(scenario.particles, source, spec, lineSeed);
+            }
+            else if (keyword == "belt") {
+                BeltSpec spec;
+                if (!(in >> typeName >> spec.count >> spec.radius >> spec.width >> spec.maxEccentricity) || !parseParticleType(typeName, spec.type)) {
+                    std::cerr << path << ":" << lineNumber << ": expected 'belt <type> <count> <radius> <width> <max eccentricity>'\n";
+                    return false;
+                }
+                generateBelt(scenario.particles, source, spec, lineSeed);
+            }
+            else {
+                BinarySpec spec;
+                std::string secondaryName;
+                if (!(in >> typeName >> secondaryName >> spec.pairs >> spec.innerRadius >> spec.outerRadius >> spec.separation)
+                    || !parseParticleType(typeName, spec.primary) || !parseParticleType(secondaryName, spec.secondary)) {
+                    std::cerr << path << ":" << lineNumber << ": expected 'binaries <primary> <secondary> <pairs> <inner> <outer> <separation>'\n";
+                    return false;
+                }
+                generateBinaries(scenario.particles, source, spec, lineSeed);
+            }
+        }
+        else if (keyword == "cluster") {
+            ClusterSpec spec;
+            if (!(in >> typeName >> spec.count >> spec.center.x >> spec.center.y >> spec.scaleRadius) || !parseParticleType(typeName, spec.type)) {
+                std::cerr << path << ":" << lineNumber << ": expected 'cluster <type> <count> <x> <y> <scale> [<vx> <vy>]'\n";
+                return false;
+            }
+            Scalar vx, vy;
+            if (in >> vx >> vy) spec.velocity = Vector2s(vx, vy);
+            generateCluster(scenario.particles, spec, lineSeed);
+        }
+        else if (keyword == "seed") {
+            if (!(in >> seed)) {
+                std::cerr << path << ":" << lineNumber << ": expected 'seed <n>'\n";
+                return false;
+            }
+        }
+        else if (keyword == "mutual") {
+            std::string value;
+            in >> value;
+            scenario.mutualGravity = (value == "on");
+        }
+        else {
+            std::cerr << path << ":" << lineNumber << ": unknown entry '" << keyword << "'\n";
+            return false;
+        }
+    }
+
+    return true;
+}
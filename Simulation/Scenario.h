@@ -0,0 +1,39 @@
+#ifndef SIMULATOR_SCENARIO_H
+#define SIMULATOR_SCENARIO_H
+
+#include <string>
+#include <vector>
+#include "Particle.h"
+#include "ParticleSystem.h"
+#include "GravitySource.h"
+
+// Plain-text scene description, one entry per line:
+//   source <RedDwarf|WhiteDwarf|YellowDwarf|NeutronStar> <x> <y>
+//   particle <Planetoid|Satellite|Terrestrial|GasGiant|IceGiant> <x> <y> [<vx> <vy>]
+//   mutual <on|off>
+// A particle without a velocity is put on a circular orbit around the
+// nearest source, the same way a mouse click places it. '#' starts a comment.
+// Whole populations come from the generators, around the last source:
+//   disk <type> <count> <inner radius> <outer radius>
+//   belt <type> <count> <radius> <width> <max eccentricity>
+//   binaries <primary> <secondary> <pairs> <inner radius> <outer radius> <separation>
+//   cluster <type> <count> <x> <y> <scale radius> [<vx> <vy>]
+//   seed <n>
+// Each generator line is seeded from the last 'seed' (default 1) and its
+// line number, so editing one leaves the others unchanged. Disks after
+// 'mutual on' also orbit their own enclosed mass.
+struct Scenario {
+    std::vector<GravitySource> sources;
+    ParticleSystem particles;
+    bool mutualGravity = false;
+};
+
+// Reports problems on std::cerr and returns false
+bool loadScenario(const std::string& path, Scenario& scenario);
+
+bool parseParticleType(const std::string& name, ParticleType& type);
+bool parseSourceType(const std::string& name, GravitySourceType& type);
+const char* particleTypeName(ParticleType type);
+const char* sourceTypeName(GravitySourceType type);
+
+#endif
@@ -0,0 +1,234 @@
+#include "Simulation.h"
+#include "Gravity.h"
+#include "Integrators.h"
+#include "KeplerOrbits.h"
+#include "Profiler.h"
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+void addParticlesAtPosition(
+    ParticleSystem& particles,
+    Vector2s pos,
+    int count,
+    int i,
+    ParticleType type,
+    const GravitySource& source
+) {
+    Scalar dx = pos.x - source.get_pos().x;
+    Scalar dy = pos.y - source.get_pos().y;
+    Scalar r_sq = dx * dx + dy * dy;
+
+    // Handle near-center case
+    if (r_sq < 1e-5f) {
+        particles.add(pos.x, pos.y, 0, 0, type);
+    }
+    else {
+        Scalar r = std::sqrt(r_sq);
+        Scalar v = std::sqrt(G * source.get_strength() / r);
+
+        // Normalized tangent vector
+        Scalar tx = -dy / r;
+        Scalar ty = dx / r;
+
+        // Base velocity + small random perturbation
+        Scalar perturbation = Scalar(0.05) * v * (std::rand() % 100 - 50) / 50;
+        Scalar vel_x = v * tx + perturbation * tx;
+        Scalar vel_y = v * ty + perturbation * ty;
+
+        particles.add(pos.x, pos.y, vel_x, vel_y, type);
+    }
+}
+
+// Without mutual gravity every particle moves on its own, so the ones the
+// integrator takes are copied out, stepped as a system of their own and
+// copied back. The copy and its accelerations are kept between jumps, so the
+// integrated particles only need a fresh force pass when the sorting changes,
+// and the closed-form ones get the sources' pull where they end up.
+size_t warpParticles(ParticleSystem& particles, const std::vector<GravitySource>& sources, const PhysicsSettings& settings,
+    int steps, WarpState& warp) {
+    if (steps <= 0) return 0;
+    if (steps == 1 || !settings.keplerOrbits) {
+        for (int step = 0; step < steps; ++step) integrateStep(particles, sources, false, settings);
+        return particles.size();
+    }
+
+    PROFILE_SCOPE("Time warp");
+    KeplerOrbits& keplerOrbits = warp.orbits;
+    ParticleSystem& integrated = warp.integrated;
+    bool current = keplerOrbits.is_current(particles, sources, settings.keplerTolerance);
+    if (!current) keplerOrbits.classify(particles, sources, settings.keplerTolerance, settings.threadCount);
+    // Orbits that bind() hands back to the integrator change the sorting too
+    bool sorted = keplerOrbits.bind(particles, settings.threadCount) && current;
+    const std::vector<size_t>& analytic = keplerOrbits.analytic();
+    const std::vector<size_t>& numeric = keplerOrbits.numeric();
+
+    if (analytic.empty()) {
+        for (int step = 0; step < steps; ++step) integrateStep(particles, sources, false, settings);
+        return numeric.size();
+    }
+
+    Scalar* px = particles.pos_x();
+    Scalar* py = particles.pos_y();
+    Scalar* vx = particles.vel_x();
+    Scalar* vy = particles.vel_y();
+    Scalar* ax = particles.acc_x();
+    Scalar* ay = particles.acc_y();
+
+    if (!numeric.empty()) {
+        if (!sorted) {
+            integrated.clear();
+            integrated.reserve(numeric.size());
+            for (size_t j = 0; j < numeric.size(); ++j) {
+                size_t i = numeric[j];
+                integrated.add(px[i], py[i], vx[i], vy[i], particles.get_type(i));
+                integrated.set_mass(j, particles.get_mass(i));
+                integrated.set_radius(j, particles.get_radius(i));
+            }
+        }
+
+        // The accelerations come along with the forces they were computed under
+        Scalar* ix = integrated.pos_x();
+        Scalar* iy = integrated.pos_y();
+        Scalar* ivx = integrated.vel_x();
+        Scalar* ivy = integrated.vel_y();
+        Scalar* iax = integrated.acc_x();
+        Scalar* iay = integrated.acc_y();
+        for (size_t j = 0; j < numeric.size(); ++j) {
+            size_t i = numeric[j];
+            ix[j] = px[i];
+            iy[j] = py[i];
+            ivx[j] = vx[i];
+            ivy[j] = vy[i];
+            iax[j] = ax[i];
+            iay[j] = ay[i];
+        }
+        integrated.integrator_state().forceKey = particles.integrator_state().forceKey;
+        integrated.set_accelerations_valid(particles.accelerations_valid());
+
+        for (int step = 0; step < steps; ++step) integrateStep(integrated, sources, false, settings);
+
+        for (size_t j = 0; j < numeric.size(); ++j) {
+            size_t i = numeric[j];
+            px[i] = ix[j];
+            py[i] = iy[j];
+            vx[i] = ivx[j];
+            vy[i] = ivy[j];
+            ax[i] = iax[j];
+            ay[i] = iay[j];
+        }
+    }
+
+    keplerOrbits.propagate(particles, static_cast<double>(settings.dt) * steps, settings.threadCount);
+    computeAccelerationsFor(particles, analytic, sources, false, settings);
+    markAccelerationsCurrent(particles, sources, false, settings);
+    return numeric.size();
+}
+
+CollisionStats updateParticles(ParticleSystem& particles, std::vector<GravitySource>& sources, bool mutualGravity, const PhysicsSettings& settings) {
+    integrateStep(particles, sources, mutualGravity, settings);
+
+    CollisionStats stats;
+    if (settings.collisions != CollisionResponse::None || settings.absorbIntoSources) {
+        stats = resolveCollisions(particles, sources, settings);
+
+        // Masses, positions or source strengths changed under the cached forces
+        if (stats.merged > 0 || stats.bounced > 0 || stats.separated > 0 || stats.absorbed > 0)
+            particles.set_accelerations_valid(false);
+    }
+    return stats;
+}
+
+size_t findNearestSource(Vector2s pos, const std::vector<GravitySource>& sources) {
+    size_t closest = NO_BODY;
+    Scalar minDist2 = std::numeric_limits<Scalar>::max();
+    for (size_t i = 0; i < sources.size(); ++i) {
+        Scalar dx = sources[i].get_pos().x - pos.x;
+        Scalar dy = sources[i].get_pos().y - pos.y;
+        Scalar dist2 = dx * dx + dy * dy;
+        if (dist2 < minDist2) {
+            minDist2 = dist2;
+            closest = i;
+        }
+    }
+    return closest;
+}
+
+size_t findNearestParticle(Vector2s pos, const ParticleSystem& particles, Scalar maxDistance) {
+    size_t closest = NO_BODY;
+    Scalar minDist2 = maxDistance * maxDistance;
+    const Scalar* px = particles.pos_x();
+    const Scalar* py = particles.pos_y();
+    for (size_t i = 0; i < particles.size(); ++i) {
+        Scalar dx = px[i] - pos.x;
+        Scalar dy = py[i] - pos.y;
+        Scalar dist2 = dx * dx + dy * dy;
+        if (dist2 <= minDist2) {
+            minDist2 = dist2;
+            closest = i;
+        }
+    }
+    return closest;
+}
+
+size_t findSource(const std::vector<GravitySource>& sources, SourceHandle handle) {
+    for (size_t i = 0; i < sources.size(); ++i) {
+        if (sources[i].handle().id == handle.id) return i;
+    }
+    return NO_BODY;
+}
+
+void removeSource(ParticleSystem& particles, std::vector<GravitySource>& sources, size_t i) {
+    sources[i] = sources.back();
+    sources.pop_back();
+    particles.set_accelerations_valid(false);
+}
+
+bool removeSource(ParticleSystem& particles, std::vector<GravitySource>& sources, SourceHandle handle) {
+    size_t i = findSource(sources, handle);
+    if (i == NO_BODY) return false;
+    removeSource(particles, sources, i);
+    return true;
+}
+
+void rebaseOrigin(ParticleSystem& particles, std::vector<GravitySource>& sources, Vector2s shift) {
+    Scalar* px = particles.pos_x();
+    Scalar* py = particles.pos_y();
+    Scalar* prevX = particles.prev_x();
+    Scalar* prevY = particles.prev_y();
+    for (size_t i = 0; i < particles.size(); ++i) {
+        px[i] -= shift.x;
+        py[i] -= shift.y;
+        prevX[i] -= shift.x;
+        prevY[i] -= shift.y;
+    }
+
+    for (auto& src : sources) {
+        src.set_pos(src.get_pos().x - shift.x, src.get_pos().y - shift.y);
+    }
+
+    // Forces depend only on separations, so the cached accelerations stay valid
+}
+
+Vector2s barycenter(const ParticleSystem& particles, const std::vector<GravitySource>& sources) {
+    // Summed in double so a million bodies do not drown the small terms
+    double sumX = 0.0, sumY = 0.0, total = 0.0;
+
+    const Scalar* px = particles.pos_x();
+    const Scalar* py = particles.pos_y();
+    const float* m = particles.masses();
+    for (size_t i = 0; i < particles.size(); ++i) {
+        sumX += static_cast<double>(px[i]) * m[i];
+        sumY += static_cast<double>(py[i]) * m[i];
+        total += m[i];
+    }
+
+    for (const auto& src : sources) {
+        sumX += static_cast<double>(src.get_pos().x) * src.get_strength();
+        sumY += static_cast<double>(src.get_pos().y) * src.get_strength();
+        total += src.get_strength();
+    }
+
+    if (total <= 0.0) return Vector2s(0, 0);
+    return Vector2s(static_cast<Scalar>(sumX / total), static_cast<Scalar>(sumY / total));
+}
@@ -0,0 +1,51 @@
+#ifndef SIMULATOR_SIMULATION_H
+#define SIMULATOR_SIMULATION_H
+
+#include <vector>
+#include "Collisions.h"
+#include "Particle.h"
+#include "ParticleSystem.h"
+#include "GravitySource.h"
+#include "KeplerOrbits.h"
+#include "PhysicsSettings.h"
+#include "Scalar.h"
+
+void addParticlesAtPosition(ParticleSystem& particles, Vector2s pos, int count, int i, ParticleType type, const GravitySource& source);
+// Advances one step of settings.dt, then resolves collisions if enabled.
+// Sources are non-const because absorption adds to their strength.
+CollisionStats updateParticles(ParticleSystem& particles, std::vector<GravitySource>& sources, bool mutualGravity, const PhysicsSettings& settings = PhysicsSettings());
+// What warpParticles keeps from one jump of a particle set to the next:
+// the closed-form orbits it sorted and the copy of the rest it integrates.
+// The caller owns one per simulation, next to its particles.
+struct WarpState {
+    KeplerOrbits orbits;
+    ParticleSystem integrated;
+};
+
+// Advances 'steps' steps of settings.dt at once without mutual gravity.
+// With settings.keplerOrbits and more than one step, closed-form orbits
+// cross the whole span in one jump, so only the particles left to the
+// integrator cost per step; single steps are ordinary ones. Collisions are
+// not resolved. Returns how many particles were integrated.
+size_t warpParticles(ParticleSystem& particles, const std::vector<GravitySource>& sources, const PhysicsSettings& settings,
+    int steps, WarpState& warp);
+
+// Indices rather than pointers, which adding a source would leave dangling.
+// Both return NO_BODY when nothing is in range.
+size_t findNearestSource(Vector2s pos, const std::vector<GravitySource>& sources);
+size_t findNearestParticle(Vector2s pos, const ParticleSystem& particles, Scalar maxDistance);
+// Current index of the source, NO_BODY once it has been removed
+size_t findSource(const std::vector<GravitySource>& sources, SourceHandle handle);
+// Like ParticleSystem::remove: the last source moves into the gap, so only
+// its index changes. The particles' cached forces included the removed one.
+void removeSource(ParticleSystem& particles, std::vector<GravitySource>& sources, size_t i);
+bool removeSource(ParticleSystem& particles, std::vector<GravitySource>& sources, SourceHandle handle);
+
+// Floating origin: moves every particle and source by -shift so the region
+// of interest sits near (0, 0), where coordinates are most precise. The
+// caller adds shift to its own running world offset.
+void rebaseOrigin(ParticleSystem& particles, std::vector<GravitySource>& sources, Vector2s shift);
+// Mass-weighted centre of particles and sources, source strength as mass
+Vector2s barycenter(const ParticleSystem& particles, const std::vector<GravitySource>& sources);
+
+#endif
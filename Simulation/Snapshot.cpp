@@ -0,0 +1,309 @@
+#include "Snapshot.h"
+#include "MappedFile.h"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static const char SNAPSHOT_MAGIC[8] = { 'O', 'G', 'S', 'N', 'A', 'P', '\r', '\n' };
+constexpr uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;
+
+constexpr uint32_t FLAG_MUTUAL_GRAVITY = 1u << 0;
+constexpr uint32_t FLAG_BLOCK_TIMESTEPS = 1u << 1;
+constexpr uint32_t FLAG_ABSORB_INTO_SOURCES = 1u << 2;
+constexpr uint32_t FLAG_MESH_SHORT_RANGE = 1u << 3;   // version 4 on
+constexpr uint32_t FLAG_SOURCE_FIELD = 1u << 4;       // version 4 on
+constexpr uint32_t FLAG_KEPLER_ORBITS = 1u << 5;      // version 4 on
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;     // reads back as SNAPSHOT_BYTE_ORDER on a matching machine
+    uint64_t particleCount;
+    uint32_t sourceCount;
+    uint32_t flags;
+    double time;
+    float dt;
+    float theta;
+    float stepAccuracy;
+    uint32_t solver;
+    int32_t maxStepLevel;
+    uint32_t collisions;    // CollisionResponse, version 2 on
+};
+static_assert(sizeof(SnapshotHeader) == 64, "snapshot header layout changed");
+
+// Version 3 on, right after the header
+struct SnapshotPrecision {
+    uint32_t scalarBytes;   // width of the position and velocity arrays
+    uint32_t integrator;    // Integrator; files written before it existed have 0, leapfrog
+    double originX;
+    double originY;
+};
+static_assert(sizeof(SnapshotPrecision) == 24, "snapshot precision layout changed");
+
+// Version 4 on, after SnapshotPrecision: the rest of PhysicsSettings
+struct SnapshotPhysics {
+    int32_t meshSize;
+    float meshPadding;
+    uint32_t meshAssignment;  // MeshAssignment
+    float passiveMass;
+    float keplerTolerance;
+    float rk45Tolerance;
+    float restitution;
+    uint32_t reserved;        // 0
+};
+static_assert(sizeof(SnapshotPhysics) == 32, "snapshot physics layout changed");
+
+struct SnapshotSource {
+    uint32_t type;
+    float strength;
+    double x;
+    double y;
+};
+static_assert(sizeof(SnapshotSource) == 24, "snapshot source layout changed");
+
+// Versions 1 and 2
+struct SnapshotSourceV2 {
+    uint32_t type;
+    float x;
+    float y;
+    float strength;
+};
+static_assert(sizeof(SnapshotSourceV2) == 16, "snapshot source layout changed");
+
+// Per particle: four kinematic arrays, mass, radius (not in version 1), one type byte
+constexpr size_t PARTICLE_SCALAR_ARRAYS = 4;
+
+template <typename T>
+static void writeArray(std::ofstream& out, const T* values, size_t count) {
+    out.write(reinterpret_cast<const char*>(values), static_cast<std::streamsize>(count * sizeof(T)));
+}
+
+// Kinematic array as Scalar: in place if the widths match, else converted into 'storage'
+template <typename Stored>
+static const Scalar* scalarColumn(const unsigned char* data, size_t count, std::vector<Scalar>& storage) {
+    const Stored* values = reinterpret_cast<const Stored*>(data);
+    if (sizeof(Stored) == sizeof(Scalar)) return reinterpret_cast<const Scalar*>(values);
+    storage.assign(values, values + count);
+    return storage.data();
+}
+
+bool saveSnapshot(
+    const std::string& path,
+    const std::vector<GravitySource>& sources,
+    const ParticleSystem& particles,
+    bool mutualGravity,
+    const PhysicsSettings& settings,
+    double time,
+    sf::Vector2<double> origin
+) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Failed to open snapshot " << path << " for writing\n";
+        return false;
+    }
+
+    SnapshotHeader header = {};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byteOrder = SNAPSHOT_BYTE_ORDER;
+    header.particleCount = particles.size();
+    header.sourceCount = static_cast<uint32_t>(sources.size());
+    header.flags = (mutualGravity ? FLAG_MUTUAL_GRAVITY : 0) | (settings.blockTimesteps ? FLAG_BLOCK_TIMESTEPS : 0)
+        | (settings.absorbIntoSources ? FLAG_ABSORB_INTO_SOURCES : 0)
+        | (settings.meshShortRange ? FLAG_MESH_SHORT_RANGE : 0) | (settings.sourceField ? FLAG_SOURCE_FIELD : 0)
+        | (settings.keplerOrbits ? FLAG_KEPLER_ORBITS : 0);
+    header.time = time;
+    header.dt = settings.dt;
+    header.theta = settings.theta;
+    header.stepAccuracy = settings.stepAccuracy;
+    header.solver = static_cast<uint32_t>(settings.solver);
+    header.maxStepLevel = settings.maxStepLevel;
+    header.collisions = static_cast<uint32_t>(settings.collisions);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    SnapshotPrecision precision = {
+        static_cast<uint32_t>(sizeof(Scalar)), static_cast<uint32_t>(settings.integrator), origin.x, origin.y
+    };
+    out.write(reinterpret_cast<const char*>(&precision), sizeof(precision));
+
+    SnapshotPhysics physics = {
+        settings.meshSize, settings.meshPadding, static_cast<uint32_t>(settings.meshAssignment), settings.passiveMass,
+        settings.keplerTolerance, settings.rk45Tolerance, settings.restitution, 0
+    };
+    out.write(reinterpret_cast<const char*>(&physics), sizeof(physics));
+
+    for (const auto& src : sources) {
+        SnapshotSource record = { static_cast<uint32_t>(src.get_type()), src.get_strength(), src.get_pos().x, src.get_pos().y };
+        out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+    }
+
+    size_t n = particles.size();
+    writeArray(out, particles.pos_x(), n);
+    writeArray(out, particles.pos_y(), n);
+    writeArray(out, particles.vel_x(), n);
+    writeArray(out, particles.vel_y(), n);
+    writeArray(out, particles.masses(), n);
+    writeArray(out, particles.radii(), n);
+
+    std::vector<uint8_t> types(n);
+    const ParticleType* particleTypes = particles.types();
+    for (size_t i = 0; i < n; ++i) types[i] = static_cast<uint8_t>(particleTypes[i]);
+    out.write(reinterpret_cast<const char*>(types.data()), static_cast<std::streamsize>(n));
+
+    if (!out) {
+        std::cerr << "Failed to write snapshot " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool loadSnapshot(const std::string& path, Snapshot& snapshot) {
+    MappedFile file;
+    if (!file.open(path)) {
+        std::cerr << "Failed to open snapshot " << path << "\n";
+        return false;
+    }
+
+    SnapshotHeader header;
+    if (file.size() < sizeof(header)) {
+        std::cerr << path << ": too short to be a snapshot\n";
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) {
+        std::cerr << path << ": not a snapshot file\n";
+        return false;
+    }
+    if (header.byteOrder != SNAPSHOT_BYTE_ORDER) {
+        std::cerr << path << ": saved on a machine with a different byte order\n";
+        return false;
+    }
+    if (header.version < 1 || header.version > SNAPSHOT_VERSION) {
+        std::cerr << path << ": unsupported snapshot version " << header.version << "\n";
+        return false;
+    }
+
+    SnapshotPrecision precision = { sizeof(float), 0, 0.0, 0.0 };
+    size_t precisionBytes = 0;
+    if (header.version >= 3) {
+        precisionBytes = sizeof(precision);
+        if (file.size() < sizeof(header) + precisionBytes) {
+            std::cerr << path << ": truncated snapshot\n";
+            return false;
+        }
+        std::memcpy(&precision, file.data() + sizeof(header), sizeof(precision));
+        if (precision.scalarBytes != sizeof(float) && precision.scalarBytes != sizeof(double)) {
+            std::cerr << path << ": bad scalar width " << precision.scalarBytes << "\n";
+            return false;
+        }
+    }
+
+    // Older files get the defaults
+    PhysicsSettings defaults;
+    SnapshotPhysics physics = {
+        defaults.meshSize, defaults.meshPadding, static_cast<uint32_t>(defaults.meshAssignment), defaults.passiveMass,
+        defaults.keplerTolerance, defaults.rk45Tolerance, defaults.restitution, 0
+    };
+    size_t physicsBytes = 0;
+    if (header.version >= 4) {
+        physicsBytes = sizeof(physics);
+        if (file.size() < sizeof(header) + precisionBytes + physicsBytes) {
+            std::cerr << path << ": truncated snapshot\n";
+            return false;
+        }
+        std::memcpy(&physics, file.data() + sizeof(header) + precisionBytes, sizeof(physics));
+    }
+
+    size_t n = static_cast<size_t>(header.particleCount);
+    size_t sourceBytes = header.version >= 3 ? sizeof(SnapshotSource) : sizeof(SnapshotSourceV2);
+    size_t floatArrays = header.version >= 2 ? 2 : 1;
+    size_t bytesPerParticle = PARTICLE_SCALAR_ARRAYS * precision.scalarBytes + floatArrays * sizeof(float) + 1;
+    size_t expected = sizeof(header) + precisionBytes + physicsBytes + header.sourceCount * sourceBytes + n * bytesPerParticle;
+    if (header.particleCount > file.size() / bytesPerParticle || file.size() < expected) {
+        std::cerr << path << ": truncated snapshot\n";
+        return false;
+    }
+
+    const unsigned char* cursor = file.data() + sizeof(header) + precisionBytes + physicsBytes;
+
+    snapshot.sources.clear();
+    for (uint32_t s = 0; s < header.sourceCount; ++s) {
+        SnapshotSource record;
+        if (header.version >= 3) {
+            std::memcpy(&record, cursor, sizeof(record));
+        }
+        else {
+            SnapshotSourceV2 old;
+            std::memcpy(&old, cursor, sizeof(old));
+            record = { old.type, old.strength, old.x, old.y };
+        }
+        cursor += sourceBytes;
+        if (record.type > static_cast<uint32_t>(GravitySourceType::NeutronStar)) {
+            std::cerr << path << ": bad source type " << record.type << "\n";
+            return false;
+        }
+        snapshot.sources.emplace_back(static_cast<Scalar>(record.x), static_cast<Scalar>(record.y),
+            static_cast<GravitySourceType>(record.type));
+        snapshot.sources.back().set_strength(record.strength);
+    }
+
+    // Arrays are used in place from the mapping unless the file was saved
+    // at the other precision; the types always need widening
+    std::vector<Scalar> converted[PARTICLE_SCALAR_ARRAYS];
+    const Scalar* kinematics[PARTICLE_SCALAR_ARRAYS];
+    for (size_t a = 0; a < PARTICLE_SCALAR_ARRAYS; ++a) {
+        kinematics[a] = precision.scalarBytes == sizeof(double)
+            ? scalarColumn<double>(cursor, n, converted[a])
+            : scalarColumn<float>(cursor, n, converted[a]);
+        cursor += n * precision.scalarBytes;
+    }
+    const float* masses = reinterpret_cast<const float*>(cursor);
+    cursor += n * sizeof(float);
+    const float* radii = nullptr;
+    if (header.version >= 2) {
+        radii = reinterpret_cast<const float*>(cursor);
+        cursor += n * sizeof(float);
+    }
+
+    std::vector<ParticleType> types(n);
+    for (size_t i = 0; i < n; ++i) {
+        if (cursor[i] > static_cast<uint8_t>(ParticleType::IceGiant)) {
+            std::cerr << path << ": bad particle type at index " << i << "\n";
+            return false;
+        }
+        types[i] = static_cast<ParticleType>(cursor[i]);
+    }
+
+    snapshot.particles.assign(n, kinematics[0], kinematics[1], kinematics[2], kinematics[3], masses, types.data(), radii);
+    snapshot.mutualGravity = (header.flags & FLAG_MUTUAL_GRAVITY) != 0;
+    snapshot.settings.blockTimesteps = (header.flags & FLAG_BLOCK_TIMESTEPS) != 0;
+    snapshot.settings.dt = header.dt;
+    snapshot.settings.theta = header.theta;
+    snapshot.settings.stepAccuracy = header.stepAccuracy;
+    snapshot.settings.solver = header.solver <= static_cast<uint32_t>(GravitySolver::ParticleMesh)
+        ? static_cast<GravitySolver>(header.solver) : GravitySolver::DirectSum;
+    snapshot.settings.maxStepLevel = header.maxStepLevel;
+    if (header.version >= 2) {
+        snapshot.settings.absorbIntoSources = (header.flags & FLAG_ABSORB_INTO_SOURCES) != 0;
+        snapshot.settings.collisions = header.collisions <= static_cast<uint32_t>(CollisionResponse::Bounce)
+            ? static_cast<CollisionResponse>(header.collisions) : CollisionResponse::None;
+    }
+    snapshot.settings.integrator = precision.integrator <= static_cast<uint32_t>(Integrator::RK45)
+        ? static_cast<Integrator>(precision.integrator) : Integrator::Leapfrog;
+    snapshot.settings.meshSize = physics.meshSize;
+    snapshot.settings.meshPadding = physics.meshPadding;
+    snapshot.settings.meshAssignment = physics.meshAssignment <= static_cast<uint32_t>(MeshAssignment::TriangularShapedCloud)
+        ? static_cast<MeshAssignment>(physics.meshAssignment) : MeshAssignment::CloudInCell;
+    snapshot.settings.meshShortRange = (header.flags & FLAG_MESH_SHORT_RANGE) != 0;
+    snapshot.settings.sourceField = (header.flags & FLAG_SOURCE_FIELD) != 0;
+    snapshot.settings.passiveMass = physics.passiveMass;
+    snapshot.settings.keplerOrbits = (header.flags & FLAG_KEPLER_ORBITS) != 0;
+    snapshot.settings.keplerTolerance = physics.keplerTolerance;
+    snapshot.settings.rk45Tolerance = physics.rk45Tolerance;
+    snapshot.settings.restitution = physics.restitution;
+    snapshot.time = header.time;
+    snapshot.origin = sf::Vector2<double>(precision.originX, precision.originY);
+    return true;
+}
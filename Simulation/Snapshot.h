@@ -0,0 +1,52 @@
+#ifndef SIMULATOR_SNAPSHOT_H
+#define SIMULATOR_SNAPSHOT_H
+
+#include <SFML/System/Vector2.hpp>
+#include <string>
+#include <vector>
+#include "GravitySource.h"
+#include "ParticleSystem.h"
+#include "PhysicsSettings.h"
+
+// Binary checkpoint of a running simulation. Layout, little-endian:
+//   SnapshotHeader (64 bytes)
+//   { u32 scalar bytes (4 or 8); u32 integrator; f64 origin x, y }
+//   { i32 mesh size; f32 mesh padding; u32 mesh assignment; f32 passive mass;
+//     f32 Kepler tolerance; f32 RK45 tolerance; f32 restitution; u32 0 }
+//   sourceCount x { u32 type; f32 strength; f64 x, y }
+//   particleCount x scalar for each of posX, posY, velX, velY
+//   particleCount x f32 for each of mass, radius
+//   particleCount x u8 type
+// The P3M, source field and Kepler switches are header flags. Version 3
+// files have no physics block and load with the defaults for it.
+// Version 2 files have no scalar/origin block, 16-byte sources
+// { u32 type; f32 x, y, strength } and f32 kinematics; version 1 also has
+// no radius array, radius then comes from the type.
+// Particle data is stored as the same arrays ParticleSystem keeps, so a
+// load is one bulk copy per attribute out of a memory-mapped file. Files
+// from a build of the other precision load through a conversion.
+// Thread count and SIMD level are machine-specific and not stored.
+constexpr unsigned SNAPSHOT_VERSION = 4;
+
+struct Snapshot {
+    std::vector<GravitySource> sources;
+    ParticleSystem particles;
+    bool mutualGravity = false;
+    PhysicsSettings settings;
+    double time = 0.0;  // simulated time when saved
+    sf::Vector2<double> origin;  // world position of (0, 0) after origin rebasing
+};
+
+// Both report problems on std::cerr and return false
+bool saveSnapshot(
+    const std::string& path,
+    const std::vector<GravitySource>& sources,
+    const ParticleSystem& particles,
+    bool mutualGravity,
+    const PhysicsSettings& settings,
+    double time,
+    sf::Vector2<double> origin = sf::Vector2<double>()
+);
+bool loadSnapshot(const std::string& path, Snapshot& snapshot);
+
+#endif
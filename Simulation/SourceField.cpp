@@ -0,0 +1,283 @@
+#include "SourceField.h"
+#include "GravityKernels.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+// Margin around the particles and sources the tree covers, as a multiple
+// of their extent, so an expanding scene does not rebuild every step
+constexpr double ROOT_MARGIN = 2.0;
+
+// Distance from a source's surface to the square [x0, x0 + size]^2;
+// negative if the surface reaches into it
+static double surfaceClearance(Scalar sx, Scalar sy, float radius, double x0, double y0, double size) {
+    double dx = std::max({ x0 - sx, 0.0, sx - (x0 + size) });
+    double dy = std::max({ y0 - sy, 0.0, sy - (y0 + size) });
+    return std::sqrt(dx * dx + dy * dy) - radius;
+}
+
+void SourceField::update(const Scalar* particleX, const Scalar* particleY, size_t count,
+    const Scalar* x, const Scalar* y, const float* strength, const float* radius, size_t sourceCount,
+    SimdLevel simd, ThreadPool& pool) {
+    if (sourceCount == 0) {
+        clear();
+        return;
+    }
+
+    double minX = x[0], maxX = x[0], minY = y[0], maxY = y[0];
+    for (size_t i = 0; i < count; ++i) {
+        minX = std::min(minX, double(particleX[i]));
+        maxX = std::max(maxX, double(particleX[i]));
+        minY = std::min(minY, double(particleY[i]));
+        maxY = std::max(maxY, double(particleY[i]));
+    }
+    for (size_t s = 0; s < sourceCount; ++s) {
+        minX = std::min(minX, double(x[s]));
+        maxX = std::max(maxX, double(x[s]));
+        minY = std::min(minY, double(y[s]));
+        maxY = std::max(maxY, double(y[s]));
+    }
+    bool covered = rootSize > 0.0 && minX >= rootX && minY >= rootY
+        && maxX < rootX + rootSize && maxY < rootY + rootSize;
+
+    // Sources already held must be where and as large as they were;
+    // only their strengths may change, and new ones may follow
+    size_t known = knownX.size();
+    bool extends = covered && sourceCount >= known && unusedSamples <= samples.size() / 2;
+    for (size_t s = 0; extends && s < known; ++s)
+        extends = x[s] == knownX[s] && y[s] == knownY[s] && radius[s] == knownRadius[s];
+
+    fullFills.clear();
+    deltaFills.clear();
+    deltaX.clear();
+    deltaY.clear();
+    deltaStrength.clear();
+    deltaRadius.clear();
+
+    if (extends) {
+        for (size_t s = 0; s < sourceCount; ++s) {
+            float change = s < known ? strength[s] - knownStrength[s] : strength[s];
+            if (change == 0.0f) continue;
+            deltaX.push_back(x[s]);
+            deltaY.push_back(y[s]);
+            deltaStrength.push_back(change);
+            deltaRadius.push_back(radius[s]);
+        }
+        if (deltaX.empty()) return;
+
+        // Kept tiles take only the difference; strengths add linearly
+        PROFILE_SCOPE("Source field update");
+        refine(0, rootX, rootY, rootSize, known, x, y, radius, sourceCount);
+    }
+    else {
+        PROFILE_SCOPE("Source field build");
+        double size = std::max({ maxX - minX, maxY - minY, double(MIN_TILE_SIZE) }) * ROOT_MARGIN;
+        rebuild(0.5 * (minX + maxX) - 0.5 * size, 0.5 * (minY + maxY) - 0.5 * size, size, x, y, radius, sourceCount);
+    }
+
+    lookup.assign(size_t(LOOKUP) * LOOKUP, LookupCell{ 0, 0 });
+    index_node(0, 0, 0, 0);
+
+    pool.parallel_for(fullFills.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t j = begin; j < end; ++j)
+            fill(fullFills[j], true, simd, x, y, strength, radius, sourceCount);
+    });
+    pool.parallel_for(deltaFills.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t j = begin; j < end; ++j)
+            fill(deltaFills[j], false, simd, deltaX.data(), deltaY.data(), deltaStrength.data(), deltaRadius.data(), deltaX.size());
+    });
+
+    knownX.assign(x, x + sourceCount);
+    knownY.assign(y, y + sourceCount);
+    knownStrength.assign(strength, strength + sourceCount);
+    knownRadius.assign(radius, radius + sourceCount);
+}
+
+void SourceField::rebuild(double x0, double y0, double size,
+    const Scalar* x, const Scalar* y, const float* radius, size_t sourceCount) {
+    rootX = x0;
+    rootY = y0;
+    rootSize = size;
+    toCoord = COORD_RANGE / size;
+    nodes.clear();
+    samples.clear();
+    unusedSamples = 0;
+    nodes.push_back(Node{ -1, -1, 0.0f });
+    build_node(0, x0, y0, size, x, y, radius, sourceCount);
+}
+
+void SourceField::build_node(int node, double x0, double y0, double size,
+    const Scalar* x, const Scalar* y, const float* radius, size_t sourceCount) {
+    double clearance = std::numeric_limits<double>::max();
+    for (size_t s = 0; s < sourceCount; ++s)
+        clearance = std::min(clearance, surfaceClearance(x[s], y[s], radius[s], x0, y0, size));
+
+    nodes[node].firstChild = -1;
+    nodes[node].samples = -1;
+    nodes[node].clearance = float(std::max(clearance, 0.0));
+
+    if (clearance > 0.0 && size <= clearance / LEAF_RATIO) {
+        nodes[node].samples = int(samples.size());
+        samples.resize(samples.size() + SAMPLES);
+        fullFills.push_back(FillJob{ node, x0, y0, size });
+        return;
+    }
+    if (size <= MIN_TILE_SIZE) return;  // exact
+
+    int first = int(nodes.size());
+    nodes[node].firstChild = first;
+    nodes.resize(nodes.size() + 4, Node{ -1, -1, 0.0f });
+    double half = 0.5 * size;
+    for (int c = 0; c < 4; ++c)
+        build_node(first + c, x0 + (c & 1) * half, y0 + (c >> 1) * half, half, x, y, radius, sourceCount);
+}
+
+void SourceField::refine(int node, double x0, double y0, double size, size_t firstNew,
+    const Scalar* x, const Scalar* y, const float* radius, size_t sourceCount) {
+    if (nodes[node].firstChild >= 0) {
+        int first = nodes[node].firstChild;
+        double half = 0.5 * size;
+        for (int c = 0; c < 4; ++c)
+            refine(first + c, x0 + (c & 1) * half, y0 + (c >> 1) * half, half, firstNew, x, y, radius, sourceCount);
+        return;
+    }
+
+    // New sources only bring surfaces closer: exact tiles stay exact
+    double clearance = nodes[node].clearance;
+    for (size_t s = firstNew; s < sourceCount; ++s)
+        clearance = std::min(clearance, surfaceClearance(x[s], y[s], radius[s], x0, y0, size));
+    if (nodes[node].samples < 0) {
+        nodes[node].clearance = float(std::max(clearance, 0.0));
+        return;
+    }
+
+    if (clearance > 0.0 && size <= clearance / LEAF_RATIO) {
+        nodes[node].clearance = float(clearance);
+        deltaFills.push_back(FillJob{ node, x0, y0, size });
+        return;
+    }
+
+    // Too coarse now: start this square over with every source
+    unusedSamples += SAMPLES;
+    build_node(node, x0, y0, size, x, y, radius, sourceCount);
+}
+
+void SourceField::index_node(int node, int depth, int cellX, int cellY) {
+    int span = LOOKUP >> depth;
+    if (nodes[node].firstChild < 0 || depth == LOOKUP_LEVEL) {
+        for (int y = cellY; y < cellY + span; ++y)
+            for (int x = cellX; x < cellX + span; ++x)
+                lookup[size_t(y) * LOOKUP + x] = LookupCell{ node, depth };
+        return;
+    }
+    int half = span / 2;
+    for (int c = 0; c < 4; ++c)
+        index_node(nodes[node].firstChild + c, depth + 1, cellX + (c & 1) * half, cellY + (c >> 1) * half);
+}
+
+void SourceField::fill(const FillJob& job, bool overwrite, SimdLevel simd, const Scalar* x, const Scalar* y,
+    const float* strength, const float* radius, size_t sourceCount) {
+    // The pull on bodies of three radii across the range the tile serves,
+    // from the same kernel as the exact path, fitted with a quadratic in r
+    Scalar px[SAMPLES], py[SAMPLES];
+    float pr[SAMPLES];
+    Scalar accX[3][SAMPLES] = {}, accY[3][SAMPLES] = {};
+    double h = job.size / TILE;
+    for (int j = 0; j <= TILE; ++j) {
+        for (int i = 0; i <= TILE; ++i) {
+            px[j * (TILE + 1) + i] = Scalar(job.x0 + i * h);
+            py[j * (TILE + 1) + i] = Scalar(job.y0 + j * h);
+        }
+    }
+    float step = 0.5f * RADIUS_RATIO * nodes[job.node].clearance;
+    for (int k = 0; k < 3; ++k) {
+        std::fill(pr, pr + SAMPLES, k * step);
+        accumulateAttraction(simd, px, py, pr, 0, SAMPLES, x, y, strength, radius, sourceCount, accX[k], accY[k]);
+    }
+
+    Sample* out = &samples[size_t(nodes[job.node].samples)];
+    for (int n = 0; n < SAMPLES; ++n) {
+        // a(r) = a0 + c1 r + c2 r^2 through r = 0, step, 2 step
+        float x2 = float(accX[2][n] - 2 * accX[1][n] + accX[0][n]) * 0.5f;
+        float y2 = float(accY[2][n] - 2 * accY[1][n] + accY[0][n]) * 0.5f;
+        float x1 = float(4 * accX[1][n] - 3 * accX[0][n] - accX[2][n]) * 0.5f;
+        float y1 = float(4 * accY[1][n] - 3 * accY[0][n] - accY[2][n]) * 0.5f;
+
+        Sample& sample = out[n];
+        if (overwrite) sample = Sample{ 0, 0, 0, 0, 0, 0 };
+        sample.ax += float(accX[0][n]);
+        sample.ay += float(accY[0][n]);
+        if (step > 0.0f) {
+            sample.ax1 += x1 / step;
+            sample.ay1 += y1 / step;
+            sample.ax2 += x2 / (step * step);
+            sample.ay2 += y2 / (step * step);
+        }
+    }
+}
+
+bool SourceField::sample(Scalar x, Scalar y, float radius, Scalar& ax, Scalar& ay) const {
+    // Position in fixed point across the root: a square's corner and the
+    // offset into it are the high and low bits of the depth it sits at
+    double lx = (double(x) - rootX) * toCoord;
+    double ly = (double(y) - rootY) * toCoord;
+    if (!(lx >= 0.0 && ly >= 0.0 && lx < COORD_RANGE && ly < COORD_RANGE)) return false;
+    uint32_t cx = uint32_t(lx), cy = uint32_t(ly);
+
+    const int lookupShift = COORD_BITS - LOOKUP_LEVEL;
+    const LookupCell& cell = lookup[size_t(cy >> lookupShift) * LOOKUP + (cx >> lookupShift)];
+    int k = cell.node;
+    int depth = cell.depth;
+    while (nodes[k].firstChild >= 0) {
+        ++depth;
+        int shift = COORD_BITS - depth;
+        k = nodes[k].firstChild + int((cx >> shift) & 1) + 2 * int((cy >> shift) & 1);
+    }
+    const Node& tile = nodes[k];
+    if (tile.samples < 0 || radius > RADIUS_RATIO * tile.clearance) return false;
+
+    uint32_t mask = (uint32_t(1) << (COORD_BITS - depth)) - 1;
+    float toCell = float(TILE) / float(mask + 1);
+    float u = float(cx & mask) * toCell;
+    float v = float(cy & mask) * toCell;
+    int i = std::min(int(u), TILE - 1);
+    int j = std::min(int(v), TILE - 1);
+    float fu = u - i, fv = v - j;
+
+    const Sample* s = &samples[size_t(tile.samples + j * (TILE + 1) + i)];
+    const Sample* corner[4] = { s, s + 1, s + TILE + 1, s + TILE + 2 };
+    float weight[4] = { (1 - fu) * (1 - fv), fu * (1 - fv), (1 - fu) * fv, fu * fv };
+
+    float r = radius;
+    float sx = 0.0f, sy = 0.0f;
+    for (int c = 0; c < 4; ++c) {
+        sx += weight[c] * (corner[c]->ax + r * (corner[c]->ax1 + r * corner[c]->ax2));
+        sy += weight[c] * (corner[c]->ay + r * (corner[c]->ay1 + r * corner[c]->ay2));
+    }
+    ax += sx;
+    ay += sy;
+    return true;
+}
+
+void SourceField::clear() {
+    rootX = rootY = rootSize = toCoord = 0.0;
+    unusedSamples = 0;
+
+    // Releases the memory too: a field switched off should not hold on to it
+    nodes = std::vector<Node>();
+    samples = std::vector<Sample>();
+    lookup = std::vector<LookupCell>();
+    knownX.clear();
+    knownY.clear();
+    knownStrength.clear();
+    knownRadius.clear();
+}
+
+size_t SourceField::memory_bytes() const {
+    return nodes.capacity() * sizeof(Node) + samples.capacity() * sizeof(Sample) + lookup.capacity() * sizeof(LookupCell)
+        + (knownX.capacity() + knownY.capacity()) * sizeof(Scalar)
+        + (knownStrength.capacity() + knownRadius.capacity()) * sizeof(float);
+}
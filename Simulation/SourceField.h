@@ -0,0 +1,109 @@
+#ifndef SIMULATOR_SOURCEFIELD_H
+#define SIMULATOR_SOURCEFIELD_H
+
+#include <cstddef>
+#include <vector>
+#include "PhysicsSettings.h"
+#include "Scalar.h"
+
+class ThreadPool;
+
+// The gravity sources' pull, precomputed on an adaptive quadtree of tiles
+// and interpolated bilinearly, so a force pass costs O(1) per particle
+// however many sources there are. A tile is at most 1 / LEAF_RATIO of its
+// distance to the nearest source surface across, which keeps the error
+// around 0.1% of the pull. Close to a surface, outside the tree and for
+// bodies large next to the distance to the nearest surface, sample()
+// declines and the caller evaluates the pull exactly.
+//
+// The pull depends on the body's radius through the effective distance,
+// so each point stores a quadratic in the radius, fitted over the radii
+// the tile serves.
+//
+// A lookup costs about as much as a few dozen source pairs in the vector
+// kernels, so this only pays off with many sources.
+//
+// Sources only ever change through update(): appended sources and changed
+// strengths are folded into the existing tiles, refining those that are
+// now too coarse; anything else rebuilds the tree.
+class SourceField {
+public:
+    static constexpr int TILE = 8;                  // cells per tile side
+    static constexpr float LEAF_RATIO = 2.0f;
+    static constexpr float RADIUS_RATIO = 0.05f;    // largest body radius / surface distance the fit covers
+    static constexpr float MIN_TILE_SIZE = 32.0f;   // finer than this, evaluate exactly
+
+private:
+    static constexpr int SAMPLES = (TILE + 1) * (TILE + 1);
+    static constexpr int LOOKUP_LEVEL = 8;  // depth of the grid that skips the top of the tree
+    static constexpr int LOOKUP = 1 << LOOKUP_LEVEL;
+    static constexpr int COORD_BITS = 30;  // fixed-point resolution of sample() positions
+    static constexpr double COORD_RANGE = double(1 << COORD_BITS);
+
+    struct Sample {
+        float ax, ay;    // pull on a point body
+        float ax1, ay1;  // linear term in the body's radius
+        float ax2, ay2;  // quadratic term
+    };
+
+    struct Node {
+        int firstChild;   // four children from here, -1 for a tile
+        int samples;      // first of the tile's SAMPLES, -1 if it is evaluated exactly
+        float clearance;  // distance from the tile to the nearest source surface
+    };
+
+    // Square the tree covers
+    double rootX = 0.0, rootY = 0.0, rootSize = 0.0;
+    double toCoord = 0.0;  // world units to fixed point
+    std::vector<Node> nodes;
+    std::vector<Sample> samples;
+    size_t unusedSamples = 0;  // left behind by tiles that were split
+
+    // Deepest node holding each LOOKUP x LOOKUP cell of the root, and its depth
+    struct LookupCell {
+        int node;
+        int depth;
+    };
+    std::vector<LookupCell> lookup;
+
+    // Sources the samples currently hold
+    std::vector<Scalar> knownX, knownY;
+    std::vector<float> knownStrength, knownRadius;
+
+    // A tile whose samples are waiting for sources to be added
+    struct FillJob {
+        int node;
+        double x0, y0, size;
+    };
+    std::vector<FillJob> fullFills;   // new tiles: every source
+    std::vector<FillJob> deltaFills;  // kept tiles: new sources and strength changes only
+    std::vector<Scalar> deltaX, deltaY;  // those sources, strength as the change
+    std::vector<float> deltaStrength, deltaRadius;
+
+    void rebuild(double x0, double y0, double size,
+        const Scalar* x, const Scalar* y, const float* radius, size_t sourceCount);
+    void build_node(int node, double x0, double y0, double size,
+        const Scalar* x, const Scalar* y, const float* radius, size_t sourceCount);
+    void refine(int node, double x0, double y0, double size, size_t firstNew,
+        const Scalar* x, const Scalar* y, const float* radius, size_t sourceCount);
+    void index_node(int node, int depth, int cellX, int cellY);
+    void fill(const FillJob& job, bool overwrite, SimdLevel simd, const Scalar* x, const Scalar* y,
+        const float* strength, const float* radius, size_t sourceCount);
+
+public:
+    // Brings the field up to date with the sources, and the tree up to the
+    // particles' extent; with no particles given the extent is kept unless
+    // the sources force a rebuild. Call before a force pass; sampling is read-only.
+    void update(const Scalar* particleX, const Scalar* particleY, size_t count,
+        const Scalar* x, const Scalar* y, const float* strength, const float* radius, size_t sourceCount,
+        SimdLevel simd, ThreadPool& pool);
+
+    // Adds the sources' pull on a body of the given radius at (x, y) to
+    // (ax, ay); returns false, adding nothing, if it has to be exact
+    bool sample(Scalar x, Scalar y, float radius, Scalar& ax, Scalar& ay) const;
+
+    void clear();
+    size_t memory_bytes() const;
+};
+
+#endif
@@ -0,0 +1,55 @@
+#include "SpatialHash.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+constexpr Scalar MAX_CELL = Scalar(1.0e9);
+
+size_t SpatialHash::bucket(int cx, int cy) const {
+    // Large odd multipliers spread neighbouring cells over the table
+    uint32_t h = static_cast<uint32_t>(cx) * 73856093u ^ static_cast<uint32_t>(cy) * 19349663u;
+    return h & mask;
+}
+
+int SpatialHash::cell(Scalar v) const {
+    Scalar c = std::floor(v * invCellSize);
+    return static_cast<int>(std::min(std::max(c, -MAX_CELL), MAX_CELL));
+}
+
+void SpatialHash::build(const Scalar* x, const Scalar* y, const float* radius, size_t count, float cellSize) {
+    invCellSize = Scalar(1) / cellSize;
+
+    // Power of two at least twice the body count keeps buckets short
+    size_t buckets = 16;
+    while (buckets < count * 2) buckets *= 2;
+    mask = buckets - 1;
+
+    // Count entries per bucket, prefix-sum into offsets, then scatter
+    bucketStart.assign(buckets + 1, 0);
+    for (size_t i = 0; i < count; ++i) {
+        int cx0 = cell(x[i] - radius[i]), cx1 = cell(x[i] + radius[i]);
+        int cy0 = cell(y[i] - radius[i]), cy1 = cell(y[i] + radius[i]);
+        for (int cy = cy0; cy <= cy1; ++cy) {
+            for (int cx = cx0; cx <= cx1; ++cx) ++bucketStart[bucket(cx, cy) + 1];
+        }
+    }
+    for (size_t b = 0; b < buckets; ++b) bucketStart[b + 1] += bucketStart[b];
+
+    entries.resize(bucketStart[buckets]);
+    std::vector<unsigned>& fill = bucketStart;  // advanced to each bucket's end, shifted back below
+    for (size_t i = 0; i < count; ++i) {
+        int cx0 = cell(x[i] - radius[i]), cx1 = cell(x[i] + radius[i]);
+        int cy0 = cell(y[i] - radius[i]), cy1 = cell(y[i] + radius[i]);
+        for (int cy = cy0; cy <= cy1; ++cy) {
+            for (int cx = cx0; cx <= cx1; ++cx) {
+                entries[fill[bucket(cx, cy)]++] = { x[i], y[i], radius[i], static_cast<unsigned>(i), cx, cy };
+            }
+        }
+    }
+    for (size_t b = buckets; b > 0; --b) bucketStart[b] = bucketStart[b - 1];
+    bucketStart[0] = 0;
+}
+
+size_t SpatialHash::memory_bytes() const {
+    return bucketStart.capacity() * sizeof(unsigned) + entries.capacity() * sizeof(Entry);
+}
@@ -0,0 +1,46 @@
+#ifndef SIMULATOR_SPATIALHASH_H
+#define SIMULATOR_SPATIALHASH_H
+
+#include <cstddef>
+#include <vector>
+#include "Scalar.h"
+
+// Uniform grid over the unbounded plane, hashed into a table sized to the
+// body count and rebuilt from scratch every step. Each body gets an entry
+// in every cell its bounding box touches, so bodies bigger than a cell
+// are still found from any cell they overlap. Entries are counting-sorted
+// by bucket, so a bucket is one contiguous run with positions inline and
+// scanning it touches memory sequentially. Different cells can share a
+// bucket; compare cx/cy to tell them apart.
+class SpatialHash {
+public:
+    struct Entry {
+        Scalar x, y;
+        float radius;
+        unsigned body;
+        int cx, cy;
+    };
+
+private:
+    Scalar invCellSize = 1;
+    size_t mask = 0;
+    std::vector<unsigned> bucketStart;  // entries of bucket b are [bucketStart[b], bucketStart[b + 1])
+    std::vector<Entry> entries;
+
+public:
+    void build(const Scalar* x, const Scalar* y, const float* radius, size_t count, float cellSize);
+
+    // Cell coordinate of a world coordinate, clamped far from the origin
+    int cell(Scalar v) const;
+
+    // Bucket holding the entries of cell (cx, cy), among others
+    size_t bucket(int cx, int cy) const;
+
+    size_t bucket_count() const { return mask + 1; }
+    const Entry* bucket_begin(size_t b) const { return entries.data() + bucketStart[b]; }
+    const Entry* bucket_end(size_t b) const { return entries.data() + bucketStart[b + 1]; }
+
+    size_t memory_bytes() const;
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threadCount) {
+    start(threadCount);
+}
+
+ThreadPool::~ThreadPool() {
+    stop();
+}
+
+void ThreadPool::start(unsigned threadCount) {
+    if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    stopping = false;
+    // The caller of parallel_for is one of the threads
+    for (unsigned i = 1; i < threadCount; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, generation);
+    }
+}
+
+void ThreadPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) worker.join();
+    workers.clear();
+}
+
+void ThreadPool::runChunks() {
+    for (;;) {
+        size_t begin = nextIndex.fetch_add(jobChunk);
+        if (begin >= jobCount) break;
+        size_t end = std::min(begin + jobChunk, jobCount);
+        (*job)(begin, end);
+    }
+}
+
+void ThreadPool::workerLoop(unsigned seenGeneration) {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seenGeneration; });
+            if (stopping) return;
+            seenGeneration = generation;
+        }
+
+        runChunks();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--busyWorkers == 0) done.notify_one();
+        }
+    }
+}
+
+void ThreadPool::parallel_for(size_t count, size_t chunkSize, const std::function<void(size_t, size_t)>& body) {
+    if (count == 0) return;
+    chunkSize = std::max<size_t>(chunkSize, 1);
+
+    // Not worth waking anyone for a single chunk
+    if (workers.empty() || count <= chunkSize) {
+        body(0, count);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &body;
+        jobCount = count;
+        jobChunk = chunkSize;
+        nextIndex.store(0);
+        busyWorkers = static_cast<unsigned>(workers.size());
+        ++generation;
+    }
+    wake.notify_all();
+
+    runChunks();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&] { return busyWorkers == 0; });
+    job = nullptr;
+}
+
+unsigned ThreadPool::get_thread_count() const {
+    return static_cast<unsigned>(workers.size()) + 1;
+}
+
+void ThreadPool::set_thread_count(unsigned threadCount) {
+    stop();
+    start(threadCount);
+}
+
+ThreadPool& simulationPool(unsigned threadCount) {
+    static ThreadPool pool(1);  // resized on first use
+    if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+    if (pool.get_thread_count() != threadCount) pool.set_thread_count(threadCount);
+    return pool;
+}
@@ -0,0 +1,57 @@
+#ifndef SIMULATOR_THREADPOOL_H
+#define SIMULATOR_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent worker threads for data-parallel loops. Work is handed out in
+// small chunks from a shared counter, so threads that finish early keep
+// pulling chunks and clustered (uneven) workloads still balance.
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    // Current job, valid while busyWorkers > 0
+    const std::function<void(size_t, size_t)>* job = nullptr;
+    size_t jobCount = 0;
+    size_t jobChunk = 1;
+    std::atomic<size_t> nextIndex{ 0 };
+    unsigned generation = 0;
+    unsigned busyWorkers = 0;
+    bool stopping = false;
+
+    void workerLoop(unsigned seenGeneration);
+    void runChunks();
+    void start(unsigned threadCount);
+    void stop();
+
+public:
+    // 0 uses every hardware thread
+    explicit ThreadPool(unsigned threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Calls body(begin, end) over [0, count) in chunks of chunkSize and
+    // returns once every chunk is done. The calling thread helps out.
+    void parallel_for(size_t count, size_t chunkSize, const std::function<void(size_t, size_t)>& body);
+
+    // Total threads used by parallel_for, including the caller
+    unsigned get_thread_count() const;
+    void set_thread_count(unsigned threadCount);
+};
+
+// The pool the simulation's parallel passes share (force pass, scene
+// generators), resized to threadCount first, 0 = every hardware thread.
+// Its workers live as long as the program; use it from one thread at a time.
+ThreadPool& simulationPool(unsigned threadCount);
+
+#endif
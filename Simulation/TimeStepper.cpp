@@ -0,0 +1,49 @@
+#include "TimeStepper.h"
+#include <algorithm>
+
+int TimeStepper::advance(float realSeconds) {
+    realSeconds = std::min(realSeconds, maxFrameTime);
+    accumulator += static_cast<double>(realSeconds) * BASE_SIM_RATE * timeScale;
+
+    float stepDt = get_step_dt();
+    int steps = static_cast<int>(accumulator / stepDt);
+    accumulator -= static_cast<double>(steps) * stepDt;
+    return steps;
+}
+
+float TimeStepper::interpolation() const {
+    return std::min(1.0f, static_cast<float>(accumulator / get_step_dt()));
+}
+
+void TimeStepper::reset() {
+    accumulator = 0.0;
+}
+
+float TimeStepper::get_step_dt() const {
+    // Step size is fixed by the substep count, never by speed or frame rate
+    return BASE_SIM_RATE / (60.0f * substeps);
+}
+
+float TimeStepper::get_time_scale() const {
+    return timeScale;
+}
+
+int TimeStepper::get_substeps() const {
+    return substeps;
+}
+
+float TimeStepper::get_max_frame_time() const {
+    return maxFrameTime;
+}
+
+void TimeStepper::set_time_scale(float timeScale) {
+    this->timeScale = std::max(0.0f, timeScale);
+}
+
+void TimeStepper::set_substeps(int substeps) {
+    this->substeps = std::max(1, substeps);
+}
+
+void TimeStepper::set_max_frame_time(float seconds) {
+    maxFrameTime = std::max(0.0f, seconds);
+}
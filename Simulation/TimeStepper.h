@@ -0,0 +1,38 @@
+#ifndef SIMULATOR_TIMESTEPPER_H
+#define SIMULATOR_TIMESTEPPER_H
+
+// Simulated time per real second at 1x speed (60 frames of the old dt = 1.5)
+constexpr float BASE_SIM_RATE = 90.0f;
+
+// Accumulator that turns elapsed real time into a whole number of fixed
+// physics steps. Simulated time keeps pace with real time at any frame
+// rate: a slow frame just runs more steps, so heavy scenes drop frames
+// instead of slowing down. Only a frame longer than maxFrameTime is
+// clamped, so a stall cannot queue up an endless backlog.
+class TimeStepper {
+private:
+    double accumulator = 0.0;  // simulated time not yet stepped
+    float timeScale = 1.0f;
+    int substeps = 3;          // physics steps per 1/60 s at 1x speed
+    float maxFrameTime = 0.25f;
+
+public:
+    // Number of steps of get_step_dt() to run for a frame that took realSeconds
+    int advance(float realSeconds);
+
+    // Fraction of a step left over, used to blend previous and current positions
+    float interpolation() const;
+
+    void reset();
+
+    float get_step_dt() const;
+    float get_time_scale() const;
+    int get_substeps() const;
+    float get_max_frame_time() const;
+
+    void set_time_scale(float timeScale);
+    void set_substeps(int substeps);
+    void set_max_frame_time(float seconds);
+};
+
+#endif
@@ -0,0 +1,465 @@
+#include "Trajectory.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+static const char TRAJECTORY_MAGIC[8] = { 'O', 'G', 'T', 'R', 'A', 'J', '\r', '\n' };
+static const char TRAJECTORY_INDEX_MAGIC[8] = { 'O', 'G', 'T', 'I', 'N', 'D', 'E', 'X' };
+constexpr uint32_t TRAJECTORY_BYTE_ORDER = 0x01020304;
+
+// Rounding steps: 1/256 px for positions, 1/4096 px per step for velocities
+constexpr float POSITION_QUANTUM = 1.0f / 256.0f;
+constexpr float VELOCITY_QUANTUM = 1.0f / 4096.0f;
+
+constexpr uint32_t FRAME_KEYFRAME = 1u << 0;
+
+struct TrajectoryHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    float positionQuantum;
+    float velocityQuantum;
+    uint32_t everySteps;
+    uint32_t reserved;
+};
+static_assert(sizeof(TrajectoryHeader) == 32, "trajectory header layout changed");
+
+struct TrajectoryFrameHeader {
+    int64_t step;
+    double time;
+    uint32_t particleCount;
+    uint32_t flags;
+    uint64_t payloadBytes;
+};
+static_assert(sizeof(TrajectoryFrameHeader) == 32, "trajectory frame header layout changed");
+
+struct TrajectoryChunkEntry {
+    uint64_t firstFrame;
+    uint64_t offset;
+    uint32_t frameCount;
+    uint32_t reserved;
+};
+static_assert(sizeof(TrajectoryChunkEntry) == 24, "trajectory chunk entry layout changed");
+
+struct TrajectoryFooter {
+    uint64_t indexOffset;
+    uint64_t chunkCount;
+    char magic[8];
+};
+static_assert(sizeof(TrajectoryFooter) == 24, "trajectory footer layout changed");
+
+// Zigzag varints: small deltas of either sign take one or two bytes
+
+static void putVarint(std::vector<uint8_t>& out, int32_t value) {
+    uint32_t zigzag = (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+    while (zigzag >= 0x80) {
+        out.push_back(static_cast<uint8_t>(zigzag | 0x80));
+        zigzag >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(zigzag));
+}
+
+static bool getVarint(const uint8_t*& cursor, const uint8_t* end, int32_t& value) {
+    uint32_t zigzag = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (cursor == end) return false;
+        uint8_t byte = *cursor++;
+        zigzag |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            value = static_cast<int32_t>(zigzag >> 1) ^ -static_cast<int32_t>(zigzag & 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void putFloat(std::vector<uint8_t>& out, float value) {
+    uint8_t bytes[sizeof(float)];
+    std::memcpy(bytes, &value, sizeof(float));
+    out.insert(out.end(), bytes, bytes + sizeof(float));
+}
+
+static bool getFloat(const uint8_t*& cursor, const uint8_t* end, float& value) {
+    if (end - cursor < static_cast<ptrdiff_t>(sizeof(float))) return false;
+    std::memcpy(&value, cursor, sizeof(float));
+    cursor += sizeof(float);
+    return true;
+}
+
+// Rounded to the quantum, saturating instead of wrapping far from the origin
+static int32_t quantise(Scalar value, float quantum) {
+    double scaled = std::round(static_cast<double>(value) / quantum);
+    scaled = std::min(std::max(scaled, -2147483520.0), 2147483520.0);
+    return static_cast<int32_t>(scaled);
+}
+
+// ---------------------------------------------------------------- recorder
+
+TrajectoryRecorder::~TrajectoryRecorder() {
+    close();
+}
+
+bool TrajectoryRecorder::open(const std::string& filePath, int interval) {
+    close();
+
+    out.open(filePath, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Failed to open trajectory " << filePath << " for writing\n";
+        return false;
+    }
+
+    path = filePath;
+    everySteps = std::max(interval, 1);
+    chunks.clear();
+    lastQuantised.clear();
+    lastMasses.clear();
+    lastRadii.clear();
+    lastTypes.clear();
+    lastHandles.clear();
+    queue.clear();
+    bufferBusy[0] = bufferBusy[1] = false;
+    framesWritten = 0;
+    framesDropped = 0;
+    writeFailed = false;
+    stopping = false;
+
+    TrajectoryHeader header = {};
+    std::memcpy(header.magic, TRAJECTORY_MAGIC, sizeof(header.magic));
+    header.version = TRAJECTORY_VERSION;
+    header.byteOrder = TRAJECTORY_BYTE_ORDER;
+    header.positionQuantum = POSITION_QUANTUM;
+    header.velocityQuantum = VELOCITY_QUANTUM;
+    header.everySteps = static_cast<uint32_t>(everySteps);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    writer = std::thread(&TrajectoryRecorder::writerLoop, this);
+    return true;
+}
+
+void TrajectoryRecorder::close() {
+    if (!out.is_open()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    writer.join();
+
+    uint64_t indexOffset = static_cast<uint64_t>(out.tellp());
+    for (const auto& chunk : chunks) {
+        TrajectoryChunkEntry entry = { chunk.firstFrame, chunk.offset, chunk.frameCount, 0 };
+        out.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+    }
+
+    TrajectoryFooter footer = {};
+    footer.indexOffset = indexOffset;
+    footer.chunkCount = chunks.size();
+    std::memcpy(footer.magic, TRAJECTORY_INDEX_MAGIC, sizeof(footer.magic));
+    out.write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+
+    if (!out || writeFailed) std::cerr << "Failed to write trajectory " << path << "\n";
+    out.close();
+}
+
+void TrajectoryRecorder::record(long step, double time, const ParticleSystem& particles, const std::vector<GravitySource>& sources) {
+    if (!out.is_open() || step % everySteps != 0) return;
+
+    int slot = -1;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!dropWhenBusy) freed.wait(lock, [&] { return !bufferBusy[0] || !bufferBusy[1]; });
+        if (!bufferBusy[0]) slot = 0;
+        else if (!bufferBusy[1]) slot = 1;
+
+        if (slot < 0) {
+            ++framesDropped;
+            return;
+        }
+        bufferBusy[slot] = true;
+    }
+
+    // Only this thread touches a busy buffer until it is queued
+    CapturedFrame& frame = buffers[slot];
+    size_t n = particles.size();
+    frame.step = step;
+    frame.time = time;
+    frame.posX.assign(particles.pos_x(), particles.pos_x() + n);
+    frame.posY.assign(particles.pos_y(), particles.pos_y() + n);
+    frame.velX.assign(particles.vel_x(), particles.vel_x() + n);
+    frame.velY.assign(particles.vel_y(), particles.vel_y() + n);
+    frame.masses.assign(particles.masses(), particles.masses() + n);
+    frame.radii.assign(particles.radii(), particles.radii() + n);
+    frame.types.resize(n);
+    frame.handles.resize(n);
+    const ParticleType* types = particles.types();
+    for (size_t i = 0; i < n; ++i) {
+        frame.types[i] = static_cast<uint8_t>(types[i]);
+        ParticleHandle handle = particles.handle(i);
+        frame.handles[i] = static_cast<uint64_t>(handle.slot) << 32 | handle.generation;
+    }
+    frame.sources = sources;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(slot);
+    }
+    wake.notify_one();
+}
+
+size_t TrajectoryRecorder::get_frames_written() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return static_cast<size_t>(framesWritten);
+}
+
+size_t TrajectoryRecorder::get_frames_dropped() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return framesDropped;
+}
+
+void TrajectoryRecorder::writerLoop() {
+    for (;;) {
+        int slot;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || !queue.empty(); });
+            if (queue.empty()) return;  // stopping and drained
+            slot = queue.front();
+            queue.erase(queue.begin());
+        }
+
+        writeFrame(buffers[slot]);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            bufferBusy[slot] = false;
+            ++framesWritten;
+        }
+        freed.notify_one();
+    }
+}
+
+// Whether every particle of the previous frame is still at its index, with
+// the same type, mass and radius, so this frame can be stored as deltas
+bool TrajectoryRecorder::continuesPrevious(const CapturedFrame& frame) const {
+    size_t previous = lastHandles.size();
+    if (frame.handles.size() < previous) return false;
+    for (size_t i = 0; i < previous; ++i) {
+        if (frame.handles[i] != lastHandles[i] || frame.types[i] != lastTypes[i]
+            || frame.masses[i] != lastMasses[i] || frame.radii[i] != lastRadii[i]) return false;
+    }
+    return true;
+}
+
+void TrajectoryRecorder::writeFrame(const CapturedFrame& frame) {
+    // Every chunk starts with a keyframe so it decodes on its own
+    bool chunkStart = framesWritten % TRAJECTORY_CHUNK_FRAMES == 0;
+    if (chunkStart) chunks.push_back({ framesWritten, static_cast<uint64_t>(out.tellp()), 0 });
+    ++chunks.back().frameCount;
+
+    bool keyframe = chunkStart || !continuesPrevious(frame);
+    if (keyframe) lastQuantised.clear();
+
+    payload.clear();
+    putVarint(payload, static_cast<int32_t>(frame.sources.size()));
+    for (const auto& src : frame.sources) {
+        payload.push_back(static_cast<uint8_t>(src.get_type()));
+        putFloat(payload, static_cast<float>(src.get_pos().x));
+        putFloat(payload, static_cast<float>(src.get_pos().y));
+        putFloat(payload, src.get_strength());
+    }
+
+    size_t n = frame.posX.size();
+    size_t previous = lastQuantised.size() / 4;
+    lastQuantised.resize(n * 4);
+
+    for (size_t i = 0; i < n; ++i) {
+        int32_t q[4] = {
+            quantise(frame.posX[i], POSITION_QUANTUM),
+            quantise(frame.posY[i], POSITION_QUANTUM),
+            quantise(frame.velX[i], VELOCITY_QUANTUM),
+            quantise(frame.velY[i], VELOCITY_QUANTUM)
+        };
+        int32_t* last = &lastQuantised[i * 4];
+
+        if (i < previous) {
+            for (int c = 0; c < 4; ++c) putVarint(payload, static_cast<int32_t>(static_cast<uint32_t>(q[c]) - static_cast<uint32_t>(last[c])));
+        }
+        else {
+            payload.push_back(frame.types[i]);
+            putFloat(payload, frame.masses[i]);
+            putFloat(payload, frame.radii[i]);
+            for (int c = 0; c < 4; ++c) putVarint(payload, q[c]);
+        }
+        for (int c = 0; c < 4; ++c) last[c] = q[c];
+    }
+    lastMasses = frame.masses;
+    lastRadii = frame.radii;
+    lastTypes = frame.types;
+    lastHandles = frame.handles;
+
+    TrajectoryFrameHeader header = {};
+    header.step = frame.step;
+    header.time = frame.time;
+    header.particleCount = static_cast<uint32_t>(n);
+    header.flags = keyframe ? FRAME_KEYFRAME : 0;
+    header.payloadBytes = payload.size();
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(payload.data()), static_cast<std::streamsize>(payload.size()));
+    if (!out) writeFailed = true;
+}
+
+// ---------------------------------------------------------------- reader
+
+bool TrajectoryReader::open(const std::string& path) {
+    chunks.clear();
+    frameCount = 0;
+    currentFrame = static_cast<size_t>(-1);
+
+    if (!file.open(path)) {
+        std::cerr << "Failed to open trajectory " << path << "\n";
+        return false;
+    }
+
+    TrajectoryHeader header;
+    TrajectoryFooter footer;
+    if (file.size() < sizeof(header) + sizeof(footer)) {
+        std::cerr << path << ": too short to be a trajectory\n";
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    std::memcpy(&footer, file.data() + file.size() - sizeof(footer), sizeof(footer));
+
+    if (std::memcmp(header.magic, TRAJECTORY_MAGIC, sizeof(header.magic)) != 0) {
+        std::cerr << path << ": not a trajectory file\n";
+        return false;
+    }
+    if (header.byteOrder != TRAJECTORY_BYTE_ORDER || header.version != TRAJECTORY_VERSION) {
+        std::cerr << path << ": unsupported trajectory version or byte order\n";
+        return false;
+    }
+    if (std::memcmp(footer.magic, TRAJECTORY_INDEX_MAGIC, sizeof(footer.magic)) != 0) {
+        std::cerr << path << ": no chunk index, the recording was not closed\n";
+        return false;
+    }
+    size_t indexEnd = file.size() - sizeof(footer);
+    if (footer.indexOffset > indexEnd || footer.chunkCount > (indexEnd - footer.indexOffset) / sizeof(TrajectoryChunkEntry)) {
+        std::cerr << path << ": corrupt chunk index\n";
+        return false;
+    }
+
+    positionQuantum = header.positionQuantum;
+    velocityQuantum = header.velocityQuantum;
+
+    for (uint64_t c = 0; c < footer.chunkCount; ++c) {
+        TrajectoryChunkEntry entry;
+        std::memcpy(&entry, file.data() + footer.indexOffset + c * sizeof(entry), sizeof(entry));
+        bool fullChunk = c + 1 == footer.chunkCount || entry.frameCount == TRAJECTORY_CHUNK_FRAMES;
+        if (entry.offset >= footer.indexOffset || entry.firstFrame != frameCount || !fullChunk) {
+            std::cerr << path << ": corrupt chunk index\n";
+            return false;
+        }
+        chunks.push_back({ entry.firstFrame, entry.offset, entry.frameCount });
+        frameCount += entry.frameCount;
+    }
+    return true;
+}
+
+bool TrajectoryReader::decodeNext(size_t offset, bool chunkStart, long& step, double& time,
+    std::vector<GravitySource>& sources) {
+    TrajectoryFrameHeader header;
+    if (offset + sizeof(header) > file.size()) return false;
+    std::memcpy(&header, file.data() + offset, sizeof(header));
+    bool keyframe = (header.flags & FRAME_KEYFRAME) != 0;
+    if (chunkStart && !keyframe) return false;
+
+    const uint8_t* cursor = file.data() + offset + sizeof(header);
+    if (header.payloadBytes > static_cast<uint64_t>(file.data() + file.size() - cursor)) return false;
+    const uint8_t* end = cursor + header.payloadBytes;
+
+    int32_t sourceCount;
+    if (!getVarint(cursor, end, sourceCount) || sourceCount < 0) return false;
+    sources.clear();
+    for (int32_t s = 0; s < sourceCount; ++s) {
+        if (cursor == end || *cursor > static_cast<uint8_t>(GravitySourceType::NeutronStar)) return false;
+        GravitySourceType type = static_cast<GravitySourceType>(*cursor++);
+        float x, y, strength;
+        if (!getFloat(cursor, end, x) || !getFloat(cursor, end, y) || !getFloat(cursor, end, strength)) return false;
+        sources.emplace_back(x, y, type);
+        sources.back().set_strength(strength);
+    }
+
+    size_t n = header.particleCount;
+    size_t previous = keyframe ? 0 : types.size();
+    quantised.resize(n * 4);
+    types.resize(n);
+    masses.resize(n);
+    radii.resize(n);
+
+    for (size_t i = 0; i < n; ++i) {
+        int32_t* q = &quantised[i * 4];
+        if (i < previous) {
+            for (int c = 0; c < 4; ++c) {
+                int32_t delta;
+                if (!getVarint(cursor, end, delta)) return false;
+                q[c] = static_cast<int32_t>(static_cast<uint32_t>(q[c]) + static_cast<uint32_t>(delta));
+            }
+        }
+        else {
+            if (cursor == end || *cursor > static_cast<uint8_t>(ParticleType::IceGiant)) return false;
+            types[i] = static_cast<ParticleType>(*cursor++);
+            if (!getFloat(cursor, end, masses[i]) || !getFloat(cursor, end, radii[i])) return false;
+            for (int c = 0; c < 4; ++c) {
+                if (!getVarint(cursor, end, q[c])) return false;
+            }
+        }
+    }
+
+    step = static_cast<long>(header.step);
+    time = header.time;
+    nextOffset = static_cast<size_t>(end - file.data());
+    return true;
+}
+
+bool TrajectoryReader::read_frame(size_t frame, ParticleSystem& particles, std::vector<GravitySource>& sources,
+    long* step, double* time) {
+    if (frame >= frameCount) return false;
+
+    // Continue from the decoded state, or restart at the frame's keyframe
+    size_t chunk = frame / TRAJECTORY_CHUNK_FRAMES;
+    bool sameChunk = currentFrame != static_cast<size_t>(-1) && currentFrame < frame &&
+        currentFrame / TRAJECTORY_CHUNK_FRAMES == chunk;
+    size_t at = sameChunk ? currentFrame + 1 : chunks[chunk].firstFrame;
+    size_t offset = sameChunk ? nextOffset : static_cast<size_t>(chunks[chunk].offset);
+
+    long frameStep = 0;
+    double frameTime = 0.0;
+    for (; at <= frame; ++at) {
+        if (!decodeNext(offset, at == chunks[chunk].firstFrame, frameStep, frameTime, sources)) {
+            std::cerr << "Corrupt trajectory frame " << at << "\n";
+            currentFrame = static_cast<size_t>(-1);
+            return false;
+        }
+        offset = nextOffset;
+        currentFrame = at;
+    }
+
+    size_t n = types.size();
+    decodedX.resize(n);
+    decodedY.resize(n);
+    decodedVX.resize(n);
+    decodedVY.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        decodedX[i] = quantised[i * 4] * static_cast<Scalar>(positionQuantum);
+        decodedY[i] = quantised[i * 4 + 1] * static_cast<Scalar>(positionQuantum);
+        decodedVX[i] = quantised[i * 4 + 2] * static_cast<Scalar>(velocityQuantum);
+        decodedVY[i] = quantised[i * 4 + 3] * static_cast<Scalar>(velocityQuantum);
+    }
+    particles.assign(n, decodedX.data(), decodedY.data(), decodedVX.data(), decodedVY.data(),
+        masses.data(), types.data(), radii.data());
+
+    if (step) *step = frameStep;
+    if (time) *time = frameTime;
+    return true;
+}
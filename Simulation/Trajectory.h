@@ -0,0 +1,141 @@
+#ifndef SIMULATOR_TRAJECTORY_H
+#define SIMULATOR_TRAJECTORY_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "GravitySource.h"
+#include "MappedFile.h"
+#include "ParticleSystem.h"
+
+// Trajectory file (.ogt), little-endian:
+//   TrajectoryHeader
+//   chunks of up to TRAJECTORY_CHUNK_FRAMES frames, each frame being a
+//   TrajectoryFrameHeader and a varint payload:
+//     source count, then per source: type byte, x, y, strength (f32)
+//     per particle: quantised x, y, vx, vy as zigzag varints, delta
+//     against the same particle in the previous frame of the chunk;
+//     particles new to this frame (and every particle in a keyframe)
+//     are stored absolute after a type byte, mass and radius (f32)
+//   chunk index: one TrajectoryChunkEntry per chunk
+//   TrajectoryFooter pointing at the index
+// A chunk's first frame is a keyframe, and so is any frame where a
+// particle was removed or changed mass or radius since the previous one:
+// removals move particles between indices, and deltas only pair indices.
+// Positions and velocities are rounded to the quanta in the header.
+// Deltas are taken between rounded values, so error never accumulates.
+// Coordinates are as the simulation holds them, i.e. relative to the
+// current origin; a rebase shows up as one large delta. Double builds
+// record at the same fixed-point resolution.
+constexpr unsigned TRAJECTORY_VERSION = 2;
+constexpr unsigned TRAJECTORY_CHUNK_FRAMES = 32;
+
+// Streams particle state to disk every K steps. record() only copies the
+// arrays into one of two capture buffers; encoding and writing happen on
+// a background thread. If both buffers are still queued the frame is
+// dropped and counted instead of stalling the caller, unless dropping is
+// turned off (batch runs that need every frame).
+class TrajectoryRecorder {
+private:
+    struct CapturedFrame {
+        long step = 0;
+        double time = 0.0;
+        std::vector<Scalar> posX, posY, velX, velY;
+        std::vector<float> masses, radii;
+        std::vector<uint8_t> types;
+        std::vector<uint64_t> handles;  // slot and generation, to tell a particle apart from its index
+        std::vector<GravitySource> sources;
+    };
+
+    std::ofstream out;
+    std::string path;
+    int everySteps = 10;
+
+    CapturedFrame buffers[2];
+    bool bufferBusy[2] = { false, false };  // being filled or waiting to be written
+    std::vector<int> queue;                  // filled buffers, oldest first
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable freed;  // a buffer was written and can be reused
+    std::thread writer;
+    bool stopping = false;
+    bool dropWhenBusy = true;
+
+    // Writer-thread state
+    std::vector<int32_t> lastQuantised;  // x, y, vx, vy per particle of the previous frame
+    std::vector<float> lastMasses, lastRadii;
+    std::vector<uint8_t> lastTypes;
+    std::vector<uint64_t> lastHandles;
+    std::vector<uint8_t> payload;
+    struct ChunkEntry { uint64_t firstFrame; uint64_t offset; uint32_t frameCount; };
+    std::vector<ChunkEntry> chunks;
+    uint64_t framesWritten = 0;
+    size_t framesDropped = 0;
+    bool writeFailed = false;
+
+    void writerLoop();
+    void writeFrame(const CapturedFrame& frame);
+    bool continuesPrevious(const CapturedFrame& frame) const;
+
+public:
+    TrajectoryRecorder() = default;
+    ~TrajectoryRecorder();
+    TrajectoryRecorder(const TrajectoryRecorder&) = delete;
+    TrajectoryRecorder& operator=(const TrajectoryRecorder&) = delete;
+
+    // Reports problems on std::cerr and returns false
+    bool open(const std::string& path, int everySteps);
+    // Writes out queued frames and the chunk index
+    void close();
+    bool is_open() const { return out.is_open(); }
+
+    // Captures a frame if 'step' is a multiple of the recording interval
+    void record(long step, double time, const ParticleSystem& particles, const std::vector<GravitySource>& sources);
+
+    size_t get_frames_written();
+    size_t get_frames_dropped();
+
+    // false makes record() wait for a free buffer instead of dropping
+    void set_drop_when_busy(bool drop) { dropWhenBusy = drop; }
+};
+
+// Random access to the frames of a recording, for replay without
+// re-simulating. Reading the frame after the last one read continues
+// from the decoded state; any other frame decodes from the start of its
+// chunk, at most TRAJECTORY_CHUNK_FRAMES frames.
+class TrajectoryReader {
+private:
+    MappedFile file;
+    float positionQuantum = 0.0f;
+    float velocityQuantum = 0.0f;
+    struct ChunkEntry { uint64_t firstFrame; uint64_t offset; uint32_t frameCount; };
+    std::vector<ChunkEntry> chunks;
+    size_t frameCount = 0;
+
+    // Decoder state after the last frame read
+    size_t currentFrame = static_cast<size_t>(-1);
+    size_t nextOffset = 0;
+    std::vector<int32_t> quantised;
+    std::vector<ParticleType> types;
+    std::vector<float> masses, radii;
+    std::vector<Scalar> decodedX, decodedY, decodedVX, decodedVY;
+
+    bool decodeNext(size_t offset, bool chunkStart, long& step, double& time,
+        std::vector<GravitySource>& sources);
+
+public:
+    // Reports problems on std::cerr and returns false
+    bool open(const std::string& path);
+    size_t frame_count() const { return frameCount; }
+
+    // Replaces particles and sources with the recorded frame
+    bool read_frame(size_t frame, ParticleSystem& particles, std::vector<GravitySource>& sources,
+        long* step = nullptr, double* time = nullptr);
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef SIMULATOR_TRIPLEBUFFER_H
+#define SIMULATOR_TRIPLEBUFFER_H
+
+#include <atomic>
+
+// Lock-free hand-off of whole states from one writer thread to one reader
+// thread. The writer fills write_buffer() and publishes it; the reader
+// picks up the newest published state with update() and reads it until
+// the next update. Neither side ever waits: the third buffer sits between
+// them, and states the reader was too slow to take are overwritten.
+template <typename T>
+class TripleBuffer {
+private:
+    static constexpr unsigned INDEX_MASK = 3;
+    static constexpr unsigned FRESH = 4;  // middle holds a state not yet taken
+
+    T buffers[3];
+    std::atomic<unsigned> middle{ 1 };
+    unsigned back = 0;   // writer only
+    unsigned front = 2;  // reader only
+
+public:
+    // Writer side; holds an older state, so fill it completely
+    T& write_buffer() { return buffers[back]; }
+
+    void publish() {
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // Reader side; returns true if a newer state was taken
+    bool update() {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH)) return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    const T& read_buffer() const { return buffers[front]; }
+};
+
+#endif